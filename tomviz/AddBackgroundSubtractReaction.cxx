@@ -0,0 +1,136 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "AddBackgroundSubtractReaction.h"
+
+#include "ActiveObjects.h"
+#include "BackgroundSubtractOperator.h"
+#include "DataSource.h"
+#include "pqCoreUtilities.h"
+
+#include <vtkImageData.h>
+#include <vtkSMSourceProxy.h>
+#include <vtkTrivialProducer.h>
+
+#include <QComboBox>
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QGridLayout>
+#include <QLabel>
+#include <QSpinBox>
+#include <QVBoxLayout>
+
+#include <algorithm>
+
+namespace tomviz
+{
+//-----------------------------------------------------------------------------
+AddBackgroundSubtractReaction::AddBackgroundSubtractReaction(
+  QAction* parentObject)
+  : Superclass(parentObject)
+{
+  connect(&ActiveObjects::instance(), SIGNAL(dataSourceChanged(DataSource*)),
+          SLOT(updateEnableState()));
+  updateEnableState();
+}
+
+//-----------------------------------------------------------------------------
+AddBackgroundSubtractReaction::~AddBackgroundSubtractReaction()
+{
+}
+
+//-----------------------------------------------------------------------------
+void AddBackgroundSubtractReaction::updateEnableState()
+{
+  parentAction()->setEnabled(
+        ActiveObjects::instance().activeDataSource() != NULL);
+}
+
+//-----------------------------------------------------------------------------
+void AddBackgroundSubtractReaction::addBackgroundSubtract(DataSource* source)
+{
+  source = source ? source : ActiveObjects::instance().activeDataSource();
+  if (!source)
+    {
+    return;
+    }
+
+  vtkTrivialProducer *t = vtkTrivialProducer::SafeDownCast(
+    source->producer()->GetClientSideObject());
+  vtkImageData *data = vtkImageData::SafeDownCast(t->GetOutputDataObject(0));
+  int dims[3];
+  data->GetDimensions(dims);
+  const int largest = std::max(dims[0], std::max(dims[1], dims[2]));
+
+  QDialog dialog(pqCoreUtilities::mainWidget());
+  dialog.setWindowTitle("Background Subtraction");
+  QGridLayout *grid = new QGridLayout;
+  grid->addWidget(new QLabel("Background:"), 0, 0);
+  QComboBox *methodCombo = new QComboBox;
+  methodCombo->addItem("Window Mean", BackgroundSubtractOperator::Mean);
+  methodCombo->addItem("Window Median", BackgroundSubtractOperator::Median);
+  methodCombo->addItem("Plane Fit", BackgroundSubtractOperator::Plane);
+  grid->addWidget(methodCombo, 0, 1, 1, 2);
+
+  grid->addWidget(new QLabel("Tilt axis:"), 1, 0);
+  QComboBox *axisCombo = new QComboBox;
+  axisCombo->addItem("Automatic (smallest)", -1);
+  axisCombo->addItem("X", 0);
+  axisCombo->addItem("Y", 1);
+  axisCombo->addItem("Z", 2);
+  grid->addWidget(axisCombo, 1, 1, 1, 2);
+
+  // The window is given in the coordinates of the tilt images, the spin boxes
+  // are bounded by the largest dimension and the operator clamps the window.
+  QSpinBox *spins[4];
+  for (int i = 0; i < 4; ++i)
+    {
+    spins[i] = new QSpinBox;
+    spins[i]->setRange(0, largest);
+    }
+  spins[2]->setValue(std::max(1, largest / 10));
+  spins[3]->setValue(std::max(1, largest / 10));
+  grid->addWidget(new QLabel("Window start (u, v):"), 2, 0);
+  grid->addWidget(spins[0], 2, 1);
+  grid->addWidget(spins[1], 2, 2);
+  grid->addWidget(new QLabel("Window end (u, v):"), 3, 0);
+  grid->addWidget(spins[2], 3, 1);
+  grid->addWidget(spins[3], 3, 2);
+
+  QVBoxLayout *v = new QVBoxLayout;
+  QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok
+                                                   | QDialogButtonBox::Cancel);
+  connect(buttons, SIGNAL(accepted()), &dialog, SLOT(accept()));
+  connect(buttons, SIGNAL(rejected()), &dialog, SLOT(reject()));
+  v->addLayout(grid);
+  v->addWidget(buttons);
+  dialog.setLayout(v);
+
+  if (dialog.exec() == QDialog::Accepted)
+    {
+    BackgroundSubtractOperator *subtract = new BackgroundSubtractOperator();
+    QSharedPointer<Operator> op(subtract);
+    subtract->setMethod(static_cast<BackgroundSubtractOperator::Method>(
+      methodCombo->itemData(methodCombo->currentIndex()).toInt()));
+    subtract->setTiltAxis(
+      axisCombo->itemData(axisCombo->currentIndex()).toInt());
+    const int start[2] = { spins[0]->value(), spins[1]->value() };
+    const int end[2] = { spins[2]->value(), spins[3]->value() };
+    subtract->setWindow(start, end);
+    source->addOperator(op);
+    }
+}
+
+}
@@ -17,15 +17,44 @@
 
 #include "ActiveObjects.h"
 #include "DataSource.h"
+#include "ExpressionOperator.h"
+#include "ModuleManager.h"
 #include "OperatorPython.h"
 #include "pqCoreUtilities.h"
 #include "EditPythonOperatorDialog.h"
 
+#include <vtkImageData.h>
+#include <vtkSMSourceProxy.h>
+#include <vtkTrivialProducer.h>
+
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QLabel>
+#include <QLineEdit>
+#include <QMessageBox>
+#include <QPushButton>
+#include <QVBoxLayout>
+
+namespace
+{
+
+vtkImageData* imageData(tomviz::DataSource* source)
+{
+  vtkTrivialProducer* t = vtkTrivialProducer::SafeDownCast(
+    source->producer()->GetClientSideObject());
+  return vtkImageData::SafeDownCast(t->GetOutputDataObject(0));
+}
+
+}
+
 namespace tomviz
 {
 //-----------------------------------------------------------------------------
-AddExpressionReaction::AddExpressionReaction(QAction* parentObject)
-  : Superclass(parentObject)
+AddExpressionReaction::AddExpressionReaction(QAction* parentObject,
+                                             const QString& presetLabel,
+                                             const QString& presetExpression)
+  : Superclass(parentObject), PresetLabel(presetLabel),
+    PresetExpression(presetExpression)
 {
   this->connect(&ActiveObjects::instance(),
                 SIGNAL(dataSourceChanged(DataSource*)),
@@ -46,14 +75,99 @@ void AddExpressionReaction::updateEnableState()
 }
 
 //-----------------------------------------------------------------------------
-OperatorPython* AddExpressionReaction::addExpression(DataSource* source)
+void AddExpressionReaction::addExpression(DataSource* source)
 {
   source = source ? source : ActiveObjects::instance().activeDataSource();
   if (!source)
     {
-    return NULL;
+    return;
     }
 
+  if (!this->PresetExpression.isEmpty())
+    {
+    ExpressionOperator *expression = new ExpressionOperator();
+    QSharedPointer<Operator> op(expression);
+    expression->setLabel(this->PresetLabel);
+    expression->setExpression(this->PresetExpression);
+    source->addOperator(op);
+    return;
+    }
+
+  // Other data sources of the same extent can be used as variables d1, d2...
+  int dims[3];
+  imageData(source)->GetDimensions(dims);
+  QStringList names;
+  QList<DataSource*> sources;
+  QString help = "Voxelwise expression of the data \"x\", e.g. sqrt(x) or "
+                 "log(1 + abs(x)).";
+  foreach (DataSource* other, ModuleManager::instance().dataSources())
+    {
+    int otherDims[3];
+    imageData(other)->GetDimensions(otherDims);
+    if (other == source || otherDims[0] != dims[0] ||
+        otherDims[1] != dims[1] || otherDims[2] != dims[2])
+      {
+      continue;
+      }
+    names.append(QString("d%1").arg(names.size() + 1));
+    sources.append(other);
+    help += QString("\n%1: %2").arg(names.last())
+      .arg(other->producer()->GetAnnotation("tomviz.Label"));
+    }
+
+  QDialog dialog(pqCoreUtilities::mainWidget());
+  dialog.setWindowTitle("Custom Transform");
+  QVBoxLayout *v = new QVBoxLayout;
+  v->addWidget(new QLabel(help));
+  QLineEdit *expressionEdit = new QLineEdit("x");
+  v->addWidget(expressionEdit);
+  QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok
+                                                   | QDialogButtonBox::Cancel);
+  // The Python button closes the dialog as accepted, marking itself checked.
+  QPushButton *pythonButton =
+    buttons->addButton("Python Script...", QDialogButtonBox::ActionRole);
+  pythonButton->setCheckable(true);
+  connect(pythonButton, SIGNAL(clicked()), &dialog, SLOT(accept()));
+  connect(buttons, SIGNAL(accepted()), &dialog, SLOT(accept()));
+  connect(buttons, SIGNAL(rejected()), &dialog, SLOT(reject()));
+  v->addWidget(buttons);
+  dialog.setLayout(v);
+
+  while (dialog.exec() == QDialog::Accepted)
+    {
+    if (pythonButton->isChecked())
+      {
+      this->addPythonOperator();
+      return;
+      }
+    const QString text = expressionEdit->text().trimmed();
+    QStringList used;
+    const QString error = ExpressionOperator::validate(text, names, &used);
+    if (!error.isEmpty())
+      {
+      QMessageBox::warning(&dialog, "Invalid Expression", error);
+      continue;
+      }
+    ExpressionOperator *expression = new ExpressionOperator();
+    QSharedPointer<Operator> op(expression);
+    expression->setExpression(text);
+    // Bind only the sources the compiled expression references, not every
+    // name that happens to be a substring of it.
+    for (int i = 0; i < names.size(); ++i)
+      {
+      if (used.contains(names[i]))
+        {
+        expression->setVariable(names[i], sources[i]);
+        }
+      }
+    source->addOperator(op);
+    return;
+    }
+}
+
+//-----------------------------------------------------------------------------
+void AddExpressionReaction::addPythonOperator()
+{
   OperatorPython *opPython = new OperatorPython();
   QSharedPointer<Operator> op(opPython);
   opPython->setLabel("Transform Data");
@@ -64,7 +178,6 @@ OperatorPython* AddExpressionReaction::addExpression(DataSource* source)
   dialog->setAttribute(Qt::WA_DeleteOnClose, true);
   connect(dialog, SIGNAL(accepted()), SLOT(addOperator()));
   dialog->show();
-  return NULL;
 }
 
 void AddExpressionReaction::addOperator()
@@ -21,18 +21,23 @@
 namespace tomviz
 {
 class DataSource;
-class OperatorPython;
 
+/// Reaction to add a voxelwise expression operator to the active data source.
+/// With a preset expression the operator is added directly, otherwise a
+/// dialog asks for the expression, offering a Python script as an
+/// alternative for transforms that are not simple voxelwise math.
 class AddExpressionReaction : public pqReaction
 {
   Q_OBJECT
   typedef pqReaction Superclass;
 
 public:
-  AddExpressionReaction(QAction* parent);
+  AddExpressionReaction(QAction* parent,
+                        const QString& presetLabel = QString(),
+                        const QString& presetExpression = QString());
   virtual ~AddExpressionReaction();
 
-  OperatorPython* addExpression(DataSource* source = NULL);
+  void addExpression(DataSource* source = NULL);
 
 protected:
   void updateEnableState();
@@ -43,6 +48,11 @@ private slots:
 
 private:
   Q_DISABLE_COPY(AddExpressionReaction)
+
+  void addPythonOperator();
+
+  QString PresetLabel;
+  QString PresetExpression;
 };
 }
 
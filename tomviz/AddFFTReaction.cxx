@@ -0,0 +1,119 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "AddFFTReaction.h"
+
+#include "ActiveObjects.h"
+#include "DataSource.h"
+#include "FFTOperator.h"
+#include "pqCoreUtilities.h"
+
+#include <vtkImageData.h>
+#include <vtkSMSourceProxy.h>
+#include <vtkTrivialProducer.h>
+
+#include <QCheckBox>
+#include <QComboBox>
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QSpinBox>
+#include <QVBoxLayout>
+
+#include <algorithm>
+
+namespace tomviz
+{
+//-----------------------------------------------------------------------------
+AddFFTReaction::AddFFTReaction(QAction* parentObject)
+  : Superclass(parentObject)
+{
+  connect(&ActiveObjects::instance(), SIGNAL(dataSourceChanged(DataSource*)),
+          SLOT(updateEnableState()));
+  updateEnableState();
+}
+
+//-----------------------------------------------------------------------------
+AddFFTReaction::~AddFFTReaction()
+{
+}
+
+//-----------------------------------------------------------------------------
+void AddFFTReaction::updateEnableState()
+{
+  parentAction()->setEnabled(
+        ActiveObjects::instance().activeDataSource() != NULL);
+}
+
+//-----------------------------------------------------------------------------
+void AddFFTReaction::addFFT(DataSource* source)
+{
+  source = source ? source : ActiveObjects::instance().activeDataSource();
+  if (!source)
+    {
+    return;
+    }
+
+  vtkTrivialProducer *t = vtkTrivialProducer::SafeDownCast(
+    source->producer()->GetClientSideObject());
+  vtkImageData *data = vtkImageData::SafeDownCast(t->GetOutputDataObject(0));
+  int dims[3];
+  data->GetDimensions(dims);
+  const int largest = std::max(dims[0], std::max(dims[1], dims[2]));
+
+  QDialog dialog(pqCoreUtilities::mainWidget());
+  dialog.setWindowTitle("FFT");
+  QHBoxLayout *modeLayout = new QHBoxLayout;
+  modeLayout->addWidget(new QLabel("Output:"));
+  QComboBox *modeCombo = new QComboBox;
+  modeCombo->addItem("Log Magnitude", FFTOperator::LogMagnitude);
+  modeCombo->addItem("Magnitude", FFTOperator::Magnitude);
+  modeCombo->addItem("Power Spectrum", FFTOperator::PowerSpectrum);
+  modeLayout->addWidget(modeCombo);
+
+  QHBoxLayout *previewLayout = new QHBoxLayout;
+  QCheckBox *previewCheck = new QCheckBox("Preview central subvolume:");
+  QSpinBox *previewSize = new QSpinBox;
+  previewSize->setRange(1, largest);
+  previewSize->setValue(std::min(largest, 128));
+  previewSize->setEnabled(false);
+  connect(previewCheck, SIGNAL(toggled(bool)),
+          previewSize, SLOT(setEnabled(bool)));
+  previewLayout->addWidget(previewCheck);
+  previewLayout->addWidget(previewSize);
+
+  QVBoxLayout *v = new QVBoxLayout;
+  QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok
+                                                   | QDialogButtonBox::Cancel);
+  connect(buttons, SIGNAL(accepted()), &dialog, SLOT(accept()));
+  connect(buttons, SIGNAL(rejected()), &dialog, SLOT(reject()));
+  v->addLayout(modeLayout);
+  v->addLayout(previewLayout);
+  v->addWidget(buttons);
+  dialog.setLayout(v);
+
+  if (dialog.exec() == QDialog::Accepted)
+    {
+    FFTOperator *fft = new FFTOperator();
+    QSharedPointer<Operator> op(fft);
+    fft->setMode(static_cast<FFTOperator::Mode>(
+      modeCombo->itemData(modeCombo->currentIndex()).toInt()));
+    fft->setPreviewSize(previewCheck->isChecked() ? previewSize->value() : 0);
+    source->addOperator(op);
+    }
+}
+
+}
@@ -0,0 +1,47 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizAddFFTReaction_h
+#define tomvizAddFFTReaction_h
+
+#include "pqReaction.h"
+
+namespace tomviz
+{
+class DataSource;
+
+/// Reaction that asks for the FFT options and adds an FFTOperator to the
+/// active data source.
+class AddFFTReaction : public pqReaction
+{
+  Q_OBJECT
+  typedef pqReaction Superclass;
+
+public:
+  AddFFTReaction(QAction* parent);
+  ~AddFFTReaction();
+
+  void addFFT(DataSource* source = NULL);
+
+protected:
+  void updateEnableState();
+  void onTriggered() { this->addFFT(); }
+
+private:
+  Q_DISABLE_COPY(AddFFTReaction)
+};
+}
+
+#endif
@@ -18,6 +18,7 @@
 
 #include "DataSource.h"
 #include "LoadDataReaction.h"
+#include "TranslateAlignOperator.h"
 
 #include <QVTKWidget.h>
 #include <vtkCamera.h>
@@ -46,6 +47,7 @@
 #include <QSpinBox>
 #include <QKeyEvent>
 #include <QButtonGroup>
+#include <QCheckBox>
 
 namespace tomviz
 {
@@ -194,9 +196,16 @@ AlignWidget::AlignWidget(DataSource* data, QWidget* p, Qt::WindowFlags f)
   grid->addLayout(buttonLayout, gridrow, 0, 1, 2, Qt::AlignCenter);
 
   gridrow++;
-  QPushButton *button = new QPushButton("Create Aligned Data");
-  connect(button, SIGNAL(clicked()), SLOT(doDataAlign()));
-  grid->addWidget(button, gridrow, 0, 1, 2, Qt::AlignCenter);
+  alignInPlace = new QCheckBox("Align in place");
+  alignInPlace->setToolTip("Record the offsets as an operator on the current "
+                           "data instead of creating a new data source.");
+  grid->addWidget(alignInPlace, gridrow, 0, 1, 2, Qt::AlignCenter);
+
+  gridrow++;
+  alignButton = new QPushButton("Create Aligned Data");
+  connect(alignButton, SIGNAL(clicked()), SLOT(doDataAlign()));
+  connect(alignInPlace, SIGNAL(toggled(bool)), SLOT(setAlignInPlace(bool)));
+  grid->addWidget(alignButton, gridrow, 0, 1, 2, Qt::AlignCenter);
 
   offsets.fill(vtkVector2i(0, 0), mapper->GetSliceNumberMaxValue() + 1);
 
@@ -390,6 +399,11 @@ void AlignWidget::applySliceOffset(int sliceNumber)
   imageSlice->SetPosition(offset[0], offset[1], 0);
 }
 
+void AlignWidget::setAlignInPlace(bool inPlace)
+{
+  alignButton->setText(inPlace ? "Apply Alignment" : "Create Aligned Data");
+}
+
 void AlignWidget::startAlign()
 {
   if (!timer->isActive())
@@ -408,86 +422,28 @@ void AlignWidget::stopAlign()
   stopButton->setEnabled(false);
 }
 
-namespace
-{
-vtkImageData* imageData(DataSource *source)
-{
-  vtkTrivialProducer *t = vtkTrivialProducer::SafeDownCast(
-    source->producer()->GetClientSideObject());
-  return vtkImageData::SafeDownCast(t->GetOutputDataObject(0));
-}
-
-// We are assuming an image that begins at 0, 0, 0.
-vtkIdType imageIndex(const vtkVector3i &incs, const vtkVector3i &pos)
-{
-  return pos[0] * incs[0] + pos[1] * incs[1] + pos[2] * incs[2];
-}
-
-template<typename T>
-void applyImageOffsets(T* in, T* out, vtkImageData *image,
-                       const QVector<vtkVector2i> &offsets)
+void AlignWidget::doDataAlign()
 {
-  // We know that the input and output images are the same size, with the
-  // supplied offsets applied to each slice. Copy the pixels, applying offsets.
-  int *extents = image->GetExtent();
-  vtkVector3i extent(extents[1] - extents[0] + 1,
-                     extents[3] - extents[2] + 1,
-                     extents[5] - extents[4] + 1);
-  vtkVector3i incs(1,
-                   1 * extent[0],
-                   1 * extent[0] * extent[1]);
-
-  // Zero out our output array, we should do this more intelligently in future.
-  T *ptr = out;
-  for (int i = 0; i < extent[0] * extent[1] * extent[2]; ++i)
+  if (alignInPlace->isChecked())
     {
-    *ptr++ = 0;
+    // Record the offsets as an operator on the data being aligned, they are
+    // applied in-place. The displayed data is now aligned, so reset offsets.
+    TranslateAlignOperator *op = new TranslateAlignOperator;
+    op->setOffsets(offsets);
+    QSharedPointer<Operator> sharedOp(op);
+    unalignedData->addOperator(sharedOp);
+    offsets.fill(vtkVector2i(0, 0));
+    setSlice(currentSlice->value());
+    return;
     }
 
-  // We need to go slice by slice, applying the pixel offsets to the new image.
-  for (int i = 0; i < extent[2]; ++i)
+  if (alignedData && alignOperator)
     {
-    vtkVector2i offset = offsets[i];
-    int idx = imageIndex(incs, vtkVector3i(0, 0, i));
-    T *inPtr = in + idx;
-    T* outPtr = out + idx;
-    for (int y = 0; y < extent[1]; ++y)
-      {
-      if (y + offset[1] >= extent[1])
-        {
-        break;
-        }
-      else if (y + offset[1] < 0)
-        {
-        inPtr += incs[1];
-        outPtr += incs[1];
-        continue;
-        }
-      for (int x = 0; x < extent[0]; ++x)
-        {
-        if (x + offset[0] >= extent[0])
-          {
-          inPtr += offset[0];
-          outPtr += offset[0];
-          break;
-          }
-        else if (x + offset[0] < 0)
-          {
-          ++inPtr;
-          ++outPtr;
-          continue;
-          }
-        *(outPtr + offset[0] + incs[1] * offset[1]) = *inPtr;
-        ++inPtr;
-        ++outPtr;
-        }
-      }
+    // Updating the offsets re-executes the aligned data pipeline.
+    alignOperator->setOffsets(offsets);
+    return;
     }
-}
-}
 
-void AlignWidget::doDataAlign()
-{
   bool firstAdded = false;
   if (!alignedData)
     {
@@ -497,17 +453,12 @@ void AlignWidget::doDataAlign()
     alignedData->producer()->SetAnnotation("tomviz.Label", name.toAscii().data());
     firstAdded = true;
     }
-  vtkImageData *in = imageData(unalignedData);
-  vtkImageData *out = imageData(alignedData);
 
-  switch (in->GetScalarType())
-    {
-    vtkTemplateMacro(
-      applyImageOffsets(reinterpret_cast<VTK_TT*>(in->GetScalarPointer()),
-                        reinterpret_cast<VTK_TT*>(out->GetScalarPointer()),
-                        in, offsets));
-    }
-  alignedData->dataModified();
+  // The operator shifts the cloned data in-place, no zero-filled copy needed.
+  alignOperator = new TranslateAlignOperator;
+  alignOperator->setOffsets(offsets);
+  QSharedPointer<Operator> sharedOp(alignOperator.data());
+  alignedData->addOperator(sharedOp);
 
   if (firstAdded)
     {
@@ -21,6 +21,7 @@
 #include <vtkNew.h>
 #include <vtkVector.h>
 
+#include <QPointer>
 #include <QVector>
 
 class QLabel;
@@ -28,6 +29,7 @@ class QSpinBox;
 class QTimer;
 class QKeyEvent;
 class QButtonGroup;
+class QCheckBox;
 class QPushButton;
 class QRadioButton;
 
@@ -39,6 +41,7 @@ namespace tomviz
 {
 
 class DataSource;
+class TranslateAlignOperator;
 
 class AlignWidget : public QWidget
 {
@@ -66,6 +69,7 @@ protected slots:
   void applySliceOffset(int sliceNumber = -1);
   void startAlign();
   void stopAlign();
+  void setAlignInPlace(bool inPlace);
 
   void doDataAlign();
 
@@ -84,6 +88,8 @@ protected:
   QSpinBox *statRefNum;
   QPushButton *startButton;
   QPushButton *stopButton;
+  QCheckBox *alignInPlace;
+  QPushButton *alignButton;
 
   int frameRate;
   int referenceSlice;
@@ -91,6 +97,7 @@ protected:
   QVector<vtkVector2i> offsets;
   DataSource *unalignedData;
   DataSource *alignedData;
+  QPointer<TranslateAlignOperator> alignOperator;
 };
 
 }
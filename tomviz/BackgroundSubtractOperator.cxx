@@ -0,0 +1,568 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "BackgroundSubtractOperator.h"
+
+#include <vtkDataArray.h>
+#include <vtkDataObject.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+#include <vtkType.h>
+#include <vtkTypeTraits.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace
+{
+
+// Per-tilt background model: background(u, v) = A + B * u + C * v. Stored as
+// separate arrays so the subtraction along a tilt axis of 0 can read them
+// contiguously.
+struct BackgroundModel
+{
+  std::vector<double> A;
+  std::vector<double> B;
+  std::vector<double> C;
+};
+
+// Volume layout seen as a stack of tilt images.
+struct TiltGeometry
+{
+  vtkIdType Dims[3];
+  vtkIdType Strides[3];
+  int Axis;
+  int UAxis;
+  int VAxis;
+  vtkIdType Window[4]; // u0, u1, v0, v1 with exclusive ends.
+};
+
+// Estimates the background of each tilt image from its window. Only the
+// window is read.
+template<typename T>
+class ComputeBackgroundFunctor
+{
+public:
+  ComputeBackgroundFunctor(const T* in, const TiltGeometry& geometry,
+                           tomviz::BackgroundSubtractOperator::Method method,
+                           BackgroundModel& model)
+    : In(in), Geometry(geometry), Method(method), Model(model)
+  {
+  }
+
+  void operator()(vtkIdType begin, vtkIdType end)
+  {
+    for (vtkIdType t = begin; t < end; ++t)
+      {
+      const T* image = this->In + t * this->Geometry.Strides[this->Geometry.Axis];
+      this->Model.B[t] = 0.0;
+      this->Model.C[t] = 0.0;
+      switch (this->Method)
+        {
+        case tomviz::BackgroundSubtractOperator::Median:
+          this->Model.A[t] = this->median(image);
+          break;
+        case tomviz::BackgroundSubtractOperator::Plane:
+          this->fitPlane(image, t);
+          break;
+        case tomviz::BackgroundSubtractOperator::Mean:
+        default:
+          this->Model.A[t] = this->mean(image);
+          break;
+        }
+      }
+  }
+
+private:
+  double mean(const T* image) const
+  {
+    const TiltGeometry& g = this->Geometry;
+    const vtkIdType su = g.Strides[g.UAxis];
+    const vtkIdType sv = g.Strides[g.VAxis];
+    double sum = 0.0;
+    for (vtkIdType v = g.Window[2]; v < g.Window[3]; ++v)
+      {
+      const T* row = image + v * sv;
+      for (vtkIdType u = g.Window[0]; u < g.Window[1]; ++u)
+        {
+        sum += static_cast<double>(row[u * su]);
+        }
+      }
+    return sum / ((g.Window[1] - g.Window[0]) * (g.Window[3] - g.Window[2]));
+  }
+
+  double median(const T* image)
+  {
+    const TiltGeometry& g = this->Geometry;
+    const vtkIdType su = g.Strides[g.UAxis];
+    const vtkIdType sv = g.Strides[g.VAxis];
+    std::vector<T>& values = this->Values.Local();
+    values.clear();
+    for (vtkIdType v = g.Window[2]; v < g.Window[3]; ++v)
+      {
+      const T* row = image + v * sv;
+      for (vtkIdType u = g.Window[0]; u < g.Window[1]; ++u)
+        {
+        values.push_back(row[u * su]);
+        }
+      }
+    const size_t half = values.size() / 2;
+    std::nth_element(values.begin(), values.begin() + half, values.end());
+    double result = static_cast<double>(values[half]);
+    if (values.size() % 2 == 0)
+      {
+      // The lower middle value is the largest of the lower half.
+      result = 0.5 * (result + static_cast<double>(
+        *std::max_element(values.begin(), values.begin() + half)));
+      }
+    return result;
+  }
+
+  // Least squares fit of A + B * u + C * v over the window, using coordinates
+  // centered on the window for a well conditioned system.
+  void fitPlane(const T* image, vtkIdType t)
+  {
+    const TiltGeometry& g = this->Geometry;
+    const vtkIdType su = g.Strides[g.UAxis];
+    const vtkIdType sv = g.Strides[g.VAxis];
+    const double uc = 0.5 * (g.Window[0] + g.Window[1] - 1);
+    const double vc = 0.5 * (g.Window[2] + g.Window[3] - 1);
+    double n = 0.0, suu = 0.0, svv = 0.0, suv = 0.0;
+    double sf = 0.0, suf = 0.0, svf = 0.0;
+    for (vtkIdType v = g.Window[2]; v < g.Window[3]; ++v)
+      {
+      const T* row = image + v * sv;
+      const double dv = v - vc;
+      for (vtkIdType u = g.Window[0]; u < g.Window[1]; ++u)
+        {
+        const double du = u - uc;
+        const double f = static_cast<double>(row[u * su]);
+        n += 1.0;
+        suu += du * du;
+        svv += dv * dv;
+        suv += du * dv;
+        sf += f;
+        suf += du * f;
+        svf += dv * f;
+        }
+      }
+    // With centered coordinates the constant term decouples from the slopes.
+    const double mean = sf / n;
+    double b = 0.0, c = 0.0;
+    const double det = suu * svv - suv * suv;
+    if (det > 0.0)
+      {
+      b = (suf * svv - svf * suv) / det;
+      c = (svf * suu - suf * suv) / det;
+      }
+    else if (suu > 0.0)
+      {
+      b = suf / suu;
+      }
+    else if (svv > 0.0)
+      {
+      c = svf / svv;
+      }
+    this->Model.A[t] = mean - b * uc - c * vc;
+    this->Model.B[t] = b;
+    this->Model.C[t] = c;
+  }
+
+  const T* In;
+  const TiltGeometry& Geometry;
+  tomviz::BackgroundSubtractOperator::Method Method;
+  BackgroundModel& Model;
+  vtkSMPThreadLocal<std::vector<T> > Values;
+};
+
+// Conversion of the subtracted value to the output type: integers are rounded
+// and saturated, written without branches so the loops vectorize.
+template<typename T, bool isInteger = std::numeric_limits<T>::is_integer>
+struct OutputConverter
+{
+  static T convert(double value)
+  {
+    return static_cast<T>(value);
+  }
+};
+
+template<typename T>
+struct OutputConverter<T, true>
+{
+  static T convert(double value)
+  {
+    const double lo = static_cast<double>(std::numeric_limits<T>::min());
+    const double hi = static_cast<double>(std::numeric_limits<T>::max());
+    value = std::min(std::max(value, lo), hi);
+    return static_cast<T>(value < 0.0 ? value - 0.5 : value + 0.5);
+  }
+};
+
+// out[i] = in[i] - (base + slope * i)
+template<typename TIn, typename TOut>
+void subtractLinear(const TIn* in, TOut* out, vtkIdType n, double base,
+                    double slope)
+{
+  for (vtkIdType i = 0; i < n; ++i)
+    {
+    out[i] = OutputConverter<TOut>::convert(
+      static_cast<double>(in[i]) - (base + slope * i));
+    }
+}
+
+// out[i] = in[i] - background[i]
+template<typename TIn, typename TOut>
+void subtractRow(const TIn* in, TOut* out, vtkIdType n,
+                 const double* background)
+{
+  for (vtkIdType i = 0; i < n; ++i)
+    {
+    out[i] = OutputConverter<TOut>::convert(
+      static_cast<double>(in[i]) - background[i]);
+    }
+}
+
+// Subtracts the background models in one pass over the volume, one
+// contiguous x row at a time. The output may be the input.
+template<typename TIn, typename TOut>
+class SubtractFunctor
+{
+public:
+  SubtractFunctor(const TIn* in, TOut* out, const TiltGeometry& geometry,
+                  const BackgroundModel& model)
+    : In(in), Out(out), Geometry(geometry), Model(model)
+  {
+  }
+
+  void operator()(vtkIdType begin, vtkIdType end)
+  {
+    const vtkIdType nx = this->Geometry.Dims[0];
+    const vtkIdType ny = this->Geometry.Dims[1];
+    const BackgroundModel& m = this->Model;
+    for (vtkIdType r = begin; r < end; ++r)
+      {
+      const vtkIdType y = r % ny;
+      const vtkIdType z = r / ny;
+      const TIn* in = this->In + r * nx;
+      TOut* out = this->Out + r * nx;
+      switch (this->Geometry.Axis)
+        {
+        case 2: // u = x, v = y
+          subtractLinear(in, out, nx, m.A[z] + m.C[z] * y, m.B[z]);
+          break;
+        case 1: // u = x, v = z
+          subtractLinear(in, out, nx, m.A[y] + m.C[y] * z, m.B[y]);
+          break;
+        case 0: // u = y, v = z, one tilt per x
+          {
+          std::vector<double>& background = this->Row.Local();
+          background.resize(nx);
+          for (vtkIdType x = 0; x < nx; ++x)
+            {
+            background[x] = m.A[x] + m.B[x] * y + m.C[x] * z;
+            }
+          subtractRow(in, out, nx, &background[0]);
+          }
+          break;
+        }
+      }
+  }
+
+private:
+  const TIn* In;
+  TOut* Out;
+  const TiltGeometry& Geometry;
+  const BackgroundModel& Model;
+  vtkSMPThreadLocal<std::vector<double> > Row;
+};
+
+template<typename TIn, typename TOut>
+void subtract(vtkDataArray* inArray, vtkDataArray* outArray,
+              const TiltGeometry& geometry,
+              tomviz::BackgroundSubtractOperator::Method method)
+{
+  const TIn* in = static_cast<const TIn*>(inArray->GetVoidPointer(0));
+  TOut* out = static_cast<TOut*>(outArray->GetVoidPointer(0));
+  const vtkIdType numberOfTilts = geometry.Dims[geometry.Axis];
+
+  BackgroundModel model;
+  model.A.resize(numberOfTilts);
+  model.B.resize(numberOfTilts);
+  model.C.resize(numberOfTilts);
+  ComputeBackgroundFunctor<TIn> compute(in, geometry, method, model);
+  vtkSMPTools::For(0, numberOfTilts, compute);
+
+  SubtractFunctor<TIn, TOut> functor(in, out, geometry, model);
+  vtkSMPTools::For(0, geometry.Dims[1] * geometry.Dims[2], functor);
+}
+
+// Signed integer and floating point types are kept, unsigned integers are
+// promoted to a signed type that holds all of their values.
+template<typename T>
+struct SubtractOutput
+{
+  typedef T Type;
+};
+
+template<>
+struct SubtractOutput<unsigned char>
+{
+  typedef short Type;
+};
+
+template<>
+struct SubtractOutput<unsigned short>
+{
+  typedef int Type;
+};
+
+template<>
+struct SubtractOutput<unsigned int>
+{
+  typedef vtkTypeInt64 Type;
+};
+
+template<>
+struct SubtractOutput<unsigned long>
+{
+  typedef double Type;
+};
+
+#if defined(VTK_TYPE_USE_LONG_LONG)
+template<>
+struct SubtractOutput<unsigned long long>
+{
+  typedef double Type;
+};
+#endif
+
+template<typename TIn>
+bool subtractBackground(vtkDataArray* scalars, vtkImageData* image,
+                        const TiltGeometry& geometry,
+                        tomviz::BackgroundSubtractOperator::Method method,
+                        TIn*)
+{
+  typedef typename SubtractOutput<TIn>::Type TOut;
+  vtkSmartPointer<vtkDataArray> output = scalars;
+  if (vtkTypeTraits<TOut>::VTKTypeID() != scalars->GetDataType())
+    {
+    output.TakeReference(vtkDataArray::CreateDataArray(
+      vtkTypeTraits<TOut>::VTKTypeID()));
+    output->SetName(scalars->GetName());
+    output->SetNumberOfTuples(scalars->GetNumberOfTuples());
+    }
+  subtract<TIn, TOut>(scalars, output, geometry, method);
+  if (output != scalars)
+    {
+    image->GetPointData()->SetScalars(output);
+    }
+  else
+    {
+    scalars->Modified();
+    }
+  return true;
+}
+
+const char* methodName(tomviz::BackgroundSubtractOperator::Method method)
+{
+  switch (method)
+    {
+    case tomviz::BackgroundSubtractOperator::Median:
+      return "Median";
+    case tomviz::BackgroundSubtractOperator::Plane:
+      return "Plane";
+    case tomviz::BackgroundSubtractOperator::Mean:
+    default:
+      return "Mean";
+    }
+}
+
+}
+
+namespace tomviz
+{
+
+//-----------------------------------------------------------------------------
+BackgroundSubtractOperator::BackgroundSubtractOperator(QObject* parentObject)
+  : Superclass(parentObject), BackgroundMethod(Mean), TiltAxis(-1)
+{
+  this->WindowStart[0] = this->WindowStart[1] = 0;
+  this->WindowEnd[0] = this->WindowEnd[1] = 1;
+}
+
+//-----------------------------------------------------------------------------
+BackgroundSubtractOperator::~BackgroundSubtractOperator()
+{
+}
+
+//-----------------------------------------------------------------------------
+QIcon BackgroundSubtractOperator::icon() const
+{
+  return QIcon(":/pqWidgets/Icons/pqCalculator24.png");
+}
+
+//-----------------------------------------------------------------------------
+void BackgroundSubtractOperator::setMethod(Method newMethod)
+{
+  this->BackgroundMethod = newMethod;
+  emit this->transformModified();
+}
+
+//-----------------------------------------------------------------------------
+void BackgroundSubtractOperator::setTiltAxis(int axis)
+{
+  this->TiltAxis = (axis >= 0 && axis < 3) ? axis : -1;
+  emit this->transformModified();
+}
+
+//-----------------------------------------------------------------------------
+void BackgroundSubtractOperator::setWindow(const int start[2],
+                                          const int end[2])
+{
+  this->WindowStart[0] = start[0];
+  this->WindowStart[1] = start[1];
+  this->WindowEnd[0] = end[0];
+  this->WindowEnd[1] = end[1];
+  emit this->transformModified();
+}
+
+//-----------------------------------------------------------------------------
+bool BackgroundSubtractOperator::transform(vtkDataObject* data)
+{
+  return BackgroundSubtractOperator::subtractBackground(
+    vtkImageData::SafeDownCast(data), this->BackgroundMethod, this->TiltAxis,
+    this->WindowStart, this->WindowEnd);
+}
+
+//-----------------------------------------------------------------------------
+bool BackgroundSubtractOperator::subtractBackground(vtkImageData* image,
+                                                    Method method,
+                                                    int tiltAxis,
+                                                    const int windowStart[2],
+                                                    const int windowEnd[2])
+{
+  vtkDataArray* scalars = image ? image->GetPointData()->GetScalars() : NULL;
+  if (!scalars || scalars->GetNumberOfComponents() != 1)
+    {
+    return false;
+    }
+
+  // We are assuming an image that begins at 0, 0, 0 in memory, the extent is
+  // only used for the dimensions.
+  int dims[3];
+  image->GetDimensions(dims);
+  TiltGeometry geometry;
+  geometry.Axis = tiltAxis;
+  if (geometry.Axis < 0 || geometry.Axis > 2)
+    {
+    // Assume the tilt axis is the one with the fewest samples.
+    geometry.Axis = static_cast<int>(std::min_element(dims, dims + 3) - dims);
+    }
+  geometry.UAxis = geometry.Axis == 0 ? 1 : 0;
+  geometry.VAxis = geometry.Axis == 2 ? 1 : 2;
+  for (int i = 0; i < 3; ++i)
+    {
+    geometry.Dims[i] = dims[i];
+    }
+  geometry.Strides[0] = 1;
+  geometry.Strides[1] = geometry.Dims[0];
+  geometry.Strides[2] = geometry.Dims[0] * geometry.Dims[1];
+
+  // Clamp the window to the image, it must not be empty.
+  const vtkIdType size[2] = { geometry.Dims[geometry.UAxis],
+                              geometry.Dims[geometry.VAxis] };
+  for (int i = 0; i < 2; ++i)
+    {
+    geometry.Window[2 * i] =
+      std::max<vtkIdType>(0, std::min<vtkIdType>(windowStart[i], size[i]));
+    geometry.Window[2 * i + 1] =
+      std::max<vtkIdType>(0, std::min<vtkIdType>(windowEnd[i], size[i]));
+    if (geometry.Window[2 * i + 1] <= geometry.Window[2 * i])
+      {
+      return false;
+      }
+    }
+
+  switch (scalars->GetDataType())
+    {
+    vtkTemplateMacro(
+      return ::subtractBackground(scalars, image, geometry, method,
+                                  static_cast<VTK_TT*>(NULL)));
+    default:
+      return false;
+    }
+}
+
+//-----------------------------------------------------------------------------
+Operator* BackgroundSubtractOperator::clone() const
+{
+  BackgroundSubtractOperator* newClone = new BackgroundSubtractOperator();
+  newClone->setMethod(this->BackgroundMethod);
+  newClone->setTiltAxis(this->TiltAxis);
+  newClone->setWindow(this->WindowStart, this->WindowEnd);
+  return newClone;
+}
+
+//-----------------------------------------------------------------------------
+bool BackgroundSubtractOperator::serialize(pugi::xml_node& ns) const
+{
+  ns.append_attribute("method").set_value(methodName(this->BackgroundMethod));
+  ns.append_attribute("tilt_axis").set_value(this->TiltAxis);
+  pugi::xml_node node = ns.append_child("Window");
+  node.append_attribute("start_u").set_value(this->WindowStart[0]);
+  node.append_attribute("start_v").set_value(this->WindowStart[1]);
+  node.append_attribute("end_u").set_value(this->WindowEnd[0]);
+  node.append_attribute("end_v").set_value(this->WindowEnd[1]);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool BackgroundSubtractOperator::deserialize(const pugi::xml_node& ns)
+{
+  QString name = ns.attribute("method").as_string("Mean");
+  Method newMethod = Mean;
+  if (name == methodName(Median))
+    {
+    newMethod = Median;
+    }
+  else if (name == methodName(Plane))
+    {
+    newMethod = Plane;
+    }
+  else if (name != methodName(Mean))
+    {
+    return false;
+    }
+  pugi::xml_node node = ns.child("Window");
+  if (!node)
+    {
+    return false;
+    }
+  const int start[2] = { node.attribute("start_u").as_int(0),
+                         node.attribute("start_v").as_int(0) };
+  const int end[2] = { node.attribute("end_u").as_int(1),
+                       node.attribute("end_v").as_int(1) };
+  this->BackgroundMethod = newMethod;
+  this->TiltAxis = ns.attribute("tilt_axis").as_int(-1);
+  this->setWindow(start, end);
+  return true;
+}
+
+}
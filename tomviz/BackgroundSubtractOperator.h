@@ -0,0 +1,97 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizBackgroundSubtractOperator_h
+#define tomvizBackgroundSubtractOperator_h
+
+#include "Operator.h"
+
+class vtkImageData;
+
+namespace tomviz
+{
+
+/// Operator that subtracts a per-image background from a tilt series. The
+/// background of each tilt image is estimated from a window of the image,
+/// either as the window mean, the window median or a least squares plane fit
+/// to the window. Backgrounds are computed for all tilts in parallel, and then
+/// subtracted in a single pass over the volume.
+///
+/// Signed integer and floating point data keep their type, integer results
+/// being rounded and saturated. Unsigned data is promoted to a wider signed
+/// type so that values below the background are not clipped.
+class BackgroundSubtractOperator : public Operator
+{
+  Q_OBJECT
+  typedef Operator Superclass;
+
+public:
+  enum Method
+    {
+    Mean,
+    Median,
+    Plane
+    };
+
+  BackgroundSubtractOperator(QObject* parent=NULL);
+  virtual ~BackgroundSubtractOperator();
+
+  virtual QString label() const { return "Background Subtraction"; }
+
+  /// Returns an icon to use for this operator.
+  virtual QIcon icon() const;
+
+  /// Method to transform a dataset in-place.
+  virtual bool transform(vtkDataObject* data);
+
+  /// return a new clone.
+  virtual Operator* clone() const;
+
+  virtual bool serialize(pugi::xml_node& in) const;
+  virtual bool deserialize(const pugi::xml_node& ns);
+
+  /// How the background of each image is estimated, the mean by default.
+  void setMethod(Method method);
+  Method method() const { return this->BackgroundMethod; }
+
+  /// The tilt axis (0, 1 or 2), or -1 (the default) to use the axis with the
+  /// fewest samples.
+  void setTiltAxis(int axis);
+  int tiltAxis() const { return this->TiltAxis; }
+
+  /// The background window, in the (u, v) coordinates of the tilt images
+  /// where u and v are the two non-tilt axes in increasing order. The start
+  /// is inclusive and the end exclusive.
+  void setWindow(const int start[2], const int end[2]);
+  const int* windowStart() const { return this->WindowStart; }
+  const int* windowEnd() const { return this->WindowEnd; }
+
+  /// Subtract the background from the scalars of image, replacing them.
+  static bool subtractBackground(vtkImageData* image, Method method,
+                                 int tiltAxis, const int windowStart[2],
+                                 const int windowEnd[2]);
+
+private:
+  Q_DISABLE_COPY(BackgroundSubtractOperator)
+
+  Method BackgroundMethod;
+  int TiltAxis;
+  int WindowStart[2];
+  int WindowEnd[2];
+};
+
+}
+
+#endif
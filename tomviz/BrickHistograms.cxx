@@ -0,0 +1,403 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "BrickHistograms.h"
+
+#include "ComputeHistogram.h"
+
+#include <vtkDataArray.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+
+// Brick coordinate of index i, rounding down for negative indices.
+int brickOf(int i)
+{
+  const int size = tomviz::BrickHistograms::BrickSize;
+  return i >= 0 ? i / size : -((size - 1 - i) / size);
+}
+
+vtkIdType numberOfPoints(const int extent[6])
+{
+  vtkIdType n = 1;
+  for (int a = 0; a < 3; ++a)
+    {
+    n *= std::max(0, extent[2 * a + 1] - extent[2 * a] + 1);
+    }
+  return n;
+}
+
+bool intersects(const int a[6], const int b[6])
+{
+  for (int i = 0; i < 3; ++i)
+    {
+    if (a[2 * i] > a[2 * i + 1] || b[2 * i] > b[2 * i + 1] ||
+        a[2 * i] > b[2 * i + 1] || b[2 * i] > a[2 * i + 1])
+      {
+      return false;
+      }
+    }
+  return true;
+}
+
+}
+
+namespace tomviz
+{
+
+// Counts one brick per iteration. Each brick has its own populations, so no
+// per-thread copies are needed, only of the direct index tables.
+template<typename T>
+class BrickHistograms::CountBricks
+{
+public:
+  CountBricks(BrickHistograms* self, const T* values, vtkIdType first)
+    : Self(self), Values(values), First(first)
+  {
+  }
+
+  void operator()(vtkIdType begin, vtkIdType end)
+  {
+    for (vtkIdType d = begin; d < end; ++d)
+      {
+      this->Self->countBrick(this->Values,
+                             this->Self->DirtyBricks[this->First + d],
+                             this->Tables.Local());
+      }
+  }
+
+  BrickHistograms* Self;
+  const T* Values;
+  vtkIdType First;
+  vtkSMPThreadLocal<std::vector<vtkIdType> > Tables;
+};
+
+//-----------------------------------------------------------------------------
+BrickHistograms::BrickHistograms(const int extent[6],
+                                 const double binsRange[2], int numberOfBins)
+  : NumberOfBins(numberOfBins), CountedVoxels(0)
+{
+  vtkIdType numberOfBricks = 1;
+  for (int a = 0; a < 3; ++a)
+    {
+    this->Extent[2 * a] = extent[2 * a];
+    this->Extent[2 * a + 1] = extent[2 * a + 1];
+    this->FirstBrick[a] = brickOf(extent[2 * a]);
+    this->BrickDimensions[a] = extent[2 * a + 1] < extent[2 * a] ? 0 :
+      brickOf(extent[2 * a + 1]) - this->FirstBrick[a] + 1;
+    numberOfBricks *= this->BrickDimensions[a];
+    }
+  this->BinsRange[0] = binsRange[0];
+  this->BinsRange[1] = binsRange[1];
+
+  this->Populations.assign(numberOfBricks * numberOfBins, 0);
+  this->Ranges.resize(2 * numberOfBricks);
+  for (vtkIdType b = 0; b < numberOfBricks; ++b)
+    {
+    this->Ranges[2 * b] = std::numeric_limits<double>::max();
+    this->Ranges[2 * b + 1] = -std::numeric_limits<double>::max();
+    }
+  this->Moments.assign(3 * numberOfBricks, 0.0);
+  this->Counted.assign(numberOfBricks, 0);
+  this->DirtyBricks.resize(numberOfBricks);
+  for (vtkIdType b = 0; b < numberOfBricks; ++b)
+    {
+    this->DirtyBricks[b] = b;
+    }
+  this->Totals.assign(numberOfBins, 0);
+}
+
+//-----------------------------------------------------------------------------
+void BrickHistograms::brickExtent(vtkIdType b, const int extent[6],
+                                  int result[6]) const
+{
+  const vtkIdType coordinates[3] = {
+    b % this->BrickDimensions[0],
+    (b / this->BrickDimensions[0]) % this->BrickDimensions[1],
+    b / (static_cast<vtkIdType>(this->BrickDimensions[0]) *
+         this->BrickDimensions[1]) };
+  for (int a = 0; a < 3; ++a)
+    {
+    const int start =
+      (this->FirstBrick[a] + static_cast<int>(coordinates[a])) * BrickSize;
+    result[2 * a] = std::max(start, extent[2 * a]);
+    result[2 * a + 1] = std::min(start + BrickSize - 1, extent[2 * a + 1]);
+    }
+}
+
+//-----------------------------------------------------------------------------
+BrickHistograms* BrickHistograms::updated(const int extent[6],
+                                          const int modifiedExtent[6]) const
+{
+  BrickHistograms* result =
+    new BrickHistograms(extent, this->BinsRange, this->NumberOfBins);
+  result->DirtyBricks.clear();
+
+  const int bins = this->NumberOfBins;
+  std::vector<char> reused(this->Counted.size(), 0);
+  vtkIdType numberOfReused = 0;
+  for (vtkIdType b = 0; b < result->numberOfBricks(); ++b)
+    {
+    int box[6];
+    result->brickExtent(b, extent, box);
+
+    // The same brick in this volume, if it has the same voxels.
+    vtkIdType old = 0;
+    bool reuse = !intersects(box, modifiedExtent);
+    for (int a = 2; a >= 0 && reuse; --a)
+      {
+      const int c = brickOf(box[2 * a]) - this->FirstBrick[a];
+      reuse = c >= 0 && c < this->BrickDimensions[a];
+      old = old * this->BrickDimensions[a] + c;
+      }
+    if (reuse)
+      {
+      int oldBox[6];
+      this->brickExtent(old, this->Extent, oldBox);
+      reuse = this->Counted[old] && std::equal(box, box + 6, oldBox);
+      }
+    if (!reuse)
+      {
+      result->DirtyBricks.push_back(b);
+      continue;
+      }
+
+    std::copy(this->Populations.begin() + old * bins,
+              this->Populations.begin() + (old + 1) * bins,
+              result->Populations.begin() + b * bins);
+    std::copy(this->Ranges.begin() + 2 * old,
+              this->Ranges.begin() + 2 * (old + 1),
+              result->Ranges.begin() + 2 * b);
+    std::copy(this->Moments.begin() + 3 * old,
+              this->Moments.begin() + 3 * (old + 1),
+              result->Moments.begin() + 3 * b);
+    result->Counted[b] = 1;
+    result->CountedVoxels += numberOfPoints(box);
+    reused[old] = 1;
+    ++numberOfReused;
+    }
+
+  // Sum whichever is fewer: the bricks kept, or the bricks dropped from the
+  // totals of this volume.
+  vtkIdType numberOfCounted = 0;
+  for (size_t b = 0; b < this->Counted.size(); ++b)
+    {
+    numberOfCounted += this->Counted[b];
+    }
+  std::vector<vtkIdType>& totals = result->Totals;
+  const bool subtract = 2 * numberOfReused > numberOfCounted;
+  if (subtract)
+    {
+    totals = this->Totals;
+    }
+  for (vtkIdType b = 0; b < static_cast<vtkIdType>(reused.size()); ++b)
+    {
+    if (this->Counted[b] && (reused[b] != 0) != subtract)
+      {
+      const unsigned int* pops = &this->Populations[b * bins];
+      for (int i = 0; i < bins; ++i)
+        {
+        totals[i] += subtract ? -static_cast<vtkIdType>(pops[i]) : pops[i];
+        }
+      }
+    }
+  return result;
+}
+
+//-----------------------------------------------------------------------------
+vtkIdType BrickHistograms::numberOfVoxels(vtkIdType first,
+                                          vtkIdType last) const
+{
+  vtkIdType n = 0;
+  for (vtkIdType d = first; d < last; ++d)
+    {
+    int box[6];
+    this->brickExtent(this->DirtyBricks[d], this->Extent, box);
+    n += numberOfPoints(box);
+    }
+  return n;
+}
+
+//-----------------------------------------------------------------------------
+template<typename T>
+void BrickHistograms::countBrick(const T* values, vtkIdType b,
+                                 std::vector<vtkIdType>& table)
+{
+  int box[6];
+  this->brickExtent(b, this->Extent, box);
+  const vtkIdType nx = this->Extent[1] - this->Extent[0] + 1;
+  const vtkIdType ny = this->Extent[3] - this->Extent[2] + 1;
+  const int length = box[1] - box[0] + 1;
+
+  unsigned int* pops = &this->Populations[b * this->NumberOfBins];
+  std::fill(pops, pops + this->NumberOfBins, 0);
+  const double min = this->BinsRange[0];
+  const double inverseInc =
+    this->NumberOfBins / (this->BinsRange[1] - this->BinsRange[0]);
+  const int maxBin = this->NumberOfBins - 1;
+
+  // The rows of the brick are counted with the kernels of
+  // CalculateHistogram(), 8 and 16 bit values by direct indexing when the
+  // brick has many more voxels than the table has entries. NaNs are left out
+  // of the populations, the moments and the range.
+  const bool enabled = detail::DirectIndexTraits<T>::Enabled;
+  const int size = enabled ? detail::directTableSize<T>() : 0;
+  const int offset = enabled ? detail::directTableOffset<T>() : 0;
+  const bool direct =
+    enabled && numberOfPoints(box) >= 4 * static_cast<vtkIdType>(size);
+  if (direct)
+    {
+    table.assign(size, 0);
+    }
+  double moments[3] = { 0.0, 0.0, 0.0 };
+  double low = std::numeric_limits<double>::max();
+  double high = -std::numeric_limits<double>::max();
+  for (int z = box[4]; z <= box[5]; ++z)
+    {
+    for (int y = box[2]; y <= box[3]; ++y)
+      {
+      const T* row = values + (box[0] - this->Extent[0]) +
+        (y - this->Extent[2]) * nx + (z - this->Extent[4]) * nx * ny;
+      if (direct)
+        {
+        for (int x = 0; x < length; ++x)
+          {
+          ++table[static_cast<int>(row[x]) - offset];
+          }
+        continue;
+        }
+      detail::binValues(row, length, min, inverseInc, maxBin, pops, moments);
+      for (int x = 0; x < length; ++x)
+        {
+        const double value = static_cast<double>(row[x]);
+        low = value < low ? value : low;
+        high = value > high ? value : high;
+        }
+      }
+    }
+  if (direct)
+    {
+    detail::binTable(&table[0], size, offset, min, inverseInc, maxBin, pops,
+                     moments);
+    int first = 0;
+    while (first < size && !table[first])
+      {
+      ++first;
+      }
+    int last = size - 1;
+    while (last > first && !table[last])
+      {
+      --last;
+      }
+    if (first < size)
+      {
+      low = first + offset;
+      high = last + offset;
+      }
+    }
+  this->Ranges[2 * b] = low;
+  this->Ranges[2 * b + 1] = high;
+  std::copy(moments, moments + 3, this->Moments.begin() + 3 * b);
+}
+
+//-----------------------------------------------------------------------------
+bool BrickHistograms::count(vtkDataArray* scalars, vtkIdType first,
+                            vtkIdType last)
+{
+  if (!scalars || scalars->GetNumberOfComponents() != 1 ||
+      scalars->GetNumberOfTuples() != numberOfPoints(this->Extent))
+    {
+    return false;
+    }
+  switch (scalars->GetDataType())
+    {
+    vtkTemplateMacro(
+      CountBricks<VTK_TT> functor(
+        this, static_cast<VTK_TT*>(scalars->GetVoidPointer(0)), first);
+      vtkSMPTools::For(0, last - first, 1, functor));
+    default:
+      return false;
+    }
+
+  const int bins = this->NumberOfBins;
+  for (vtkIdType d = first; d < last; ++d)
+    {
+    const vtkIdType b = this->DirtyBricks[d];
+    const unsigned int* pops = &this->Populations[b * bins];
+    for (int i = 0; i < bins; ++i)
+      {
+      this->Totals[i] += pops[i];
+      }
+    int box[6];
+    this->brickExtent(b, this->Extent, box);
+    this->CountedVoxels += numberOfPoints(box);
+    this->Counted[b] = 1;
+    }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool BrickHistograms::isInRange() const
+{
+  for (size_t b = 0; b < this->Counted.size(); ++b)
+    {
+    if (this->Counted[b] &&
+        this->Ranges[2 * b] <= this->Ranges[2 * b + 1] &&
+        (this->Ranges[2 * b] < this->BinsRange[0] ||
+         this->Ranges[2 * b + 1] > this->BinsRange[1]))
+      {
+      return false;
+      }
+    }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+size_t BrickHistograms::memorySize() const
+{
+  return this->Populations.capacity() * sizeof(unsigned int) +
+    (this->Ranges.capacity() + this->Moments.capacity()) * sizeof(double) +
+    this->Counted.capacity() +
+    (this->DirtyBricks.capacity() + this->Totals.capacity()) *
+    sizeof(vtkIdType);
+}
+
+//-----------------------------------------------------------------------------
+bool BrickHistograms::totals(double range[2], double moments[3]) const
+{
+  range[0] = std::numeric_limits<double>::max();
+  range[1] = -std::numeric_limits<double>::max();
+  moments[0] = moments[1] = moments[2] = 0.0;
+  for (size_t b = 0; b < this->Counted.size(); ++b)
+    {
+    if (this->Counted[b])
+      {
+      range[0] = std::min(range[0], this->Ranges[2 * b]);
+      range[1] = std::max(range[1], this->Ranges[2 * b + 1]);
+      for (int i = 0; i < 3; ++i)
+        {
+        moments[i] += this->Moments[3 * b + i];
+        }
+      }
+    }
+  return range[0] <= range[1];
+}
+
+}
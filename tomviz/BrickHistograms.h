@@ -0,0 +1,122 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizBrickHistograms_h
+#define tomvizBrickHistograms_h
+
+#include <vtkType.h>
+
+#include <cstddef>
+#include <vector>
+
+class vtkDataArray;
+
+namespace tomviz
+{
+
+/// BrickHistograms keeps the histogram, range and moments of each brick of
+/// BrickSize^3 voxels of a volume, all with the same bins, together with
+/// their totals over the volume. Bricks are aligned to multiples of BrickSize
+/// in index space, so when a volume is cropped, or only part of it is
+/// modified, updated() gives the histograms of the new data in which only
+/// the bricks touched need to be counted again, and the totals follow by
+/// adding and removing the counts of those bricks.
+class BrickHistograms
+{
+public:
+  enum { BrickSize = 64 };
+
+  /// All bricks of a volume with the given structured extent start dirty,
+  /// i.e. not yet counted.
+  BrickHistograms(const int extent[6], const double binsRange[2],
+                  int numberOfBins);
+
+  /// Returns a new copy for the data after a change, which has the given
+  /// extent and in which only the voxels in modifiedExtent changed (an empty
+  /// extent when none did, e.g. after a crop). Bricks whose voxels are the
+  /// same keep their counts, the others are dirty. The caller owns the copy.
+  BrickHistograms* updated(const int extent[6],
+                           const int modifiedExtent[6]) const;
+
+  const int* extent() const { return this->Extent; }
+  const double* binsRange() const { return this->BinsRange; }
+  int numberOfBins() const { return this->NumberOfBins; }
+  vtkIdType numberOfBricks() const
+    { return static_cast<vtkIdType>(this->Counted.size()); }
+
+  /// The bricks still to be counted, in the order they are stored.
+  vtkIdType numberOfDirtyBricks() const
+    { return static_cast<vtkIdType>(this->DirtyBricks.size()); }
+
+  /// The number of voxels in the dirty bricks [first, last).
+  vtkIdType numberOfVoxels(vtkIdType first, vtkIdType last) const;
+
+  /// Count the dirty bricks [first, last) of the scalars, which must span
+  /// extent(), in parallel, and add them to the totals. Returns false for
+  /// unsupported arrays.
+  bool count(vtkDataArray* scalars, vtkIdType first, vtkIdType last);
+
+  /// Mark all bricks as counted, once count() has been called for each.
+  void clearDirty() { this->DirtyBricks.clear(); }
+
+  /// False if a counted value was outside binsRange(), in which case it was
+  /// put in the first or last bin and the volume needs new bins.
+  bool isInRange() const;
+
+  /// The total populations of the counted bricks.
+  const std::vector<vtkIdType>& populations() const { return this->Totals; }
+
+  /// The number of voxels counted so far.
+  vtkIdType numberOfCountedVoxels() const { return this->CountedVoxels; }
+
+  /// The memory held by the per-brick counts, in bytes.
+  size_t memorySize() const;
+
+  /// Get the range of the counted values and their moments relative to
+  /// binsRange()[0], as CalculateHistogram() accumulates them. Returns false
+  /// if there are no values other than NaNs.
+  bool totals(double range[2], double moments[3]) const;
+
+private:
+  template<typename T> class CountBricks;
+  template<typename T> void countBrick(const T* values, vtkIdType b,
+                                      std::vector<vtkIdType>& table);
+
+  // The extent of brick b, clipped to extent.
+  void brickExtent(vtkIdType b, const int extent[6], int result[6]) const;
+
+  int Extent[6];
+  // Brick coordinates of the first brick, and number of bricks per axis.
+  int FirstBrick[3];
+  int BrickDimensions[3];
+  double BinsRange[2];
+  int NumberOfBins;
+
+  // Per brick: populations (NumberOfBins each, a brick has fewer than 2^32
+  // voxels), min and max (min > max if none), moments (3 each), and whether
+  // it has been counted.
+  std::vector<unsigned int> Populations;
+  std::vector<double> Ranges;
+  std::vector<double> Moments;
+  std::vector<char> Counted;
+  std::vector<vtkIdType> DirtyBricks;
+
+  std::vector<vtkIdType> Totals;
+  vtkIdType CountedVoxels;
+};
+
+}
+
+#endif
@@ -18,18 +18,21 @@
 
 #include <pqView.h>
 #include <vtkAxis.h>
+#include <vtkChartHistogram2D.h>
 #include <vtkChartXY.h>
+#include <vtkColorTransferFunction.h>
 #include <vtkContextMouseEvent.h>
 #include <vtkContextScene.h>
 #include <vtkContextView.h>
 #include <vtkEventQtSlotConnect.h>
 #include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
 #include <vtkImageData.h>
-#include <vtkIntArray.h>
 #include <vtkMathUtilities.h>
 #include <vtkObjectFactory.h>
 #include <vtkPlotBar.h>
 #include <vtkPointData.h>
+#include <vtkPVDataInformation.h>
 #include <vtkSMSourceProxy.h>
 #include <vtkSMViewProxy.h>
 #include <vtkTable.h>
@@ -40,13 +43,16 @@
 #include <vtkScalarsToColors.h>
 
 #include <QtDebug>
-#include <QThread>
+
+#include <algorithm>
+#include <cmath>
 
 #include "ActiveObjects.h"
-#include "ComputeHistogram.h"
 #include "DataSource.h"
+#include "HistogramScheduler.h"
 #include "ModuleContour.h"
 #include "ModuleManager.h"
+#include "ModuleThreshold.h"
 #include "Utilities.h"
 
 #ifdef DAX_DEVICE_ADAPTER
@@ -56,108 +62,19 @@
 namespace tomviz
 {
 
-//-----------------------------------------------------------------------------
-// This is just here for now - quick and dirty historgram calculations...
-void PopulateHistogram(vtkImageData *input, vtkTable *output)
-{
-  // The output table will have the twice the number of columns, they will be
-  // the x and y for input column. This is the bin centers, and the population.
-  double minmax[2] = { 0.0, 0.0 };
-  const int numberOfBins = 256;
-
-  // The bin values are the centers, extending +/- half an inc either side
-  switch (input->GetScalarType())
-    {
-    vtkTemplateMacro(
-          tomviz::GetScalarRange(reinterpret_cast<VTK_TT *>(input->GetPointData()->GetScalars()->GetVoidPointer(0)),
-                         input->GetPointData()->GetScalars()->GetNumberOfTuples(),
-                         minmax));
-    default:
-      break;
-    }
-  if (minmax[0] == minmax[1])
-    {
-    minmax[1] = minmax[0] + 1.0;
-    }
-
-  double inc = (minmax[1] - minmax[0]) / numberOfBins;
-  double halfInc = inc / 2.0;
-  vtkSmartPointer<vtkFloatArray> extents =
-      vtkFloatArray::SafeDownCast(
-        output->GetColumnByName(vtkStdString("image_extents").c_str()));
-  if (!extents)
-    {
-    extents = vtkSmartPointer<vtkFloatArray>::New();
-    extents->SetName(vtkStdString("image_extents").c_str());
-    }
-  extents->SetNumberOfTuples(numberOfBins);
-  double min = minmax[0] + halfInc;
-  for (int j = 0; j < numberOfBins; ++j)
-    {
-    extents->SetValue(j, min + j * inc);
-    }
-  vtkSmartPointer<vtkIntArray> populations =
-      vtkIntArray::SafeDownCast(
-        output->GetColumnByName(vtkStdString("image_pops").c_str()));
-  if (!populations)
-    {
-    populations = vtkSmartPointer<vtkIntArray>::New();
-    populations->SetName(vtkStdString("image_pops").c_str());
-    }
-  populations->SetNumberOfTuples(numberOfBins);
-  int *pops = static_cast<int *>(populations->GetVoidPointer(0));
-  for (int k = 0; k < numberOfBins; ++k)
-    {
-    pops[k] = 0;
-    }
-
-  switch (input->GetScalarType())
-    {
-    vtkTemplateMacro(
-          tomviz::CalculateHistogram(reinterpret_cast<VTK_TT *>(input->GetPointData()->GetScalars()->GetVoidPointer(0)),
-                             input->GetPointData()->GetScalars()->GetNumberOfTuples(),
-                             minmax[0], pops, inc, numberOfBins));
-    default:
-      cout << "UpdateFromFile: Unknown data type" << endl;
-    }
-
-#ifndef NDEBUG
-  vtkIdType total = 0;
-  for (int i = 0; i < numberOfBins; ++i)
-    total += pops[i];
-  assert(total == input->GetPointData()->GetScalars()->GetNumberOfTuples());
+#ifdef DAX_DEVICE_ADAPTER
+typedef ModuleStreamingContour ModuleContourType;
+#else
+typedef ModuleContour ModuleContourType;
 #endif
 
-  output->AddColumn(extents.GetPointer());
-  output->AddColumn(populations.GetPointer());
-}
-
-// Quick background thread for the histogram calculation.
-class HistogramWorker : public QThread
-{
-  Q_OBJECT
-
-  void run();
-
-public:
-  HistogramWorker(QObject *p = 0) : QThread(p) {}
-
-  vtkSmartPointer<vtkImageData> input;
-  vtkSmartPointer<vtkTable> output;
-};
-
-void HistogramWorker::run()
-{
-  if (input && output)
-    {
-    PopulateHistogram(input.Get(), output.Get());
-    }
-}
-
 class CentralWidget::CWInternals
 {
 public:
   Ui::CentralWidget Ui;
+  // The data sources listed in the joint histogram's combo box, after the
+  // "None" item.
+  QList<QPointer<DataSource> > JointDataSources;
 };
 
 class vtkHistogramMarker : public vtkPlot
@@ -224,11 +141,61 @@ bool vtkChartHistogram::MouseDoubleClickEvent(const vtkContextMouseEvent &m)
   return true;
 }
 
+// A 2D histogram chart on which a rectangle is dragged with the selection
+// button to select a range of values along each axis.
+class vtkChartJointHistogram : public vtkChartHistogram2D
+{
+public:
+  static vtkChartJointHistogram * New();
+
+  enum { RangeSelectedEvent = vtkCommand::UserEvent + 1 };
+
+  bool MouseButtonReleaseEvent(const vtkContextMouseEvent &mouse);
+
+  vtkNew<vtkTransform2D> Transform;
+  // The selected ranges along x and along y.
+  double Selection[4];
+};
+
+vtkStandardNewMacro(vtkChartJointHistogram)
+
+bool vtkChartJointHistogram::MouseButtonReleaseEvent(
+  const vtkContextMouseEvent &m)
+{
+  // Convert the dragged box to data coordinates, before the superclass
+  // resets it.
+  bool selected = false;
+  if (m.GetButton() == this->Actions.Select() &&
+      this->MouseBox.GetWidth() != 0 && this->MouseBox.GetHeight() != 0 &&
+      this->GetNumberOfPlots() > 0)
+    {
+    vtkPlot *plot = this->GetPlot(0);
+    this->CalculateUnscaledPlotTransform(plot->GetXAxis(), plot->GetYAxis(),
+                                         this->Transform.Get());
+    float corners[4] = {
+      this->MouseBox.GetX(), this->MouseBox.GetY(),
+      this->MouseBox.GetX() + this->MouseBox.GetWidth(),
+      this->MouseBox.GetY() + this->MouseBox.GetHeight() };
+    float points[4];
+    this->Transform->InverseTransformPoints(corners, points, 2);
+    this->Selection[0] = std::min(points[0], points[2]);
+    this->Selection[1] = std::max(points[0], points[2]);
+    this->Selection[2] = std::min(points[1], points[3]);
+    this->Selection[3] = std::max(points[1], points[3]);
+    selected = true;
+    }
+  bool result = this->Superclass::MouseButtonReleaseEvent(m);
+  if (selected)
+    {
+    this->InvokeEvent(RangeSelectedEvent);
+    }
+  return result;
+}
+
 //-----------------------------------------------------------------------------
 CentralWidget::CentralWidget(QWidget* parentObject, Qt::WindowFlags wflags)
   : Superclass(parentObject, wflags),
-    Internals(new CentralWidget::CWInternals()),
-    Worker(NULL)
+    Internals(new CentralWidget::CWInternals())
 {
   this->Internals->Ui.setupUi(this);
 
@@ -257,6 +224,41 @@ CentralWidget::CentralWidget(QWidget* parentObject, Qt::WindowFlags wflags)
 
   this->EventLink->Connect(chart, vtkCommand::CursorChangedEvent, this,
                            SLOT(histogramClicked(vtkObject*)));
+
+  // Set up the joint histogram chart, where dragging selects ranges.
+  Ui::CentralWidget& ui = this->Internals->Ui;
+  this->JointHistogram->SetInteractor(ui.jointHistogramWidget->GetInteractor());
+  ui.jointHistogramWidget->SetRenderWindow(
+    this->JointHistogram->GetRenderWindow());
+  vtkChartJointHistogram* jointChart = this->JointChart.Get();
+  this->JointHistogram->GetScene()->AddItem(jointChart);
+  jointChart->SetRenderEmpty(true);
+  jointChart->SetActionToButton(vtkChart::SELECT,
+                                vtkContextMouseEvent::LEFT_BUTTON);
+  this->EventLink->Connect(jointChart,
+                           vtkChartJointHistogram::RangeSelectedEvent, this,
+                           SLOT(jointHistogramSelected(vtkObject*)));
+  ui.jointHistogramWidget->setVisible(false);
+  this->connect(ui.jointDataSource, SIGNAL(currentIndexChanged(int)),
+                SLOT(setJointDataSource(int)));
+  this->connect(&ModuleManager::instance(),
+                SIGNAL(dataSourceAdded(DataSource*)),
+                SLOT(updateJointDataSources()));
+  this->connect(&ModuleManager::instance(),
+                SIGNAL(dataSourceRemoved(DataSource*)),
+                SLOT(updateJointDataSources()));
+
+  HistogramScheduler& scheduler = HistogramScheduler::instance();
+  this->connect(&scheduler, SIGNAL(histogramProgress(DataSource*, vtkTable*)),
+                SLOT(histogramProgress(DataSource*, vtkTable*)));
+  this->connect(&scheduler, SIGNAL(histogramReady(DataSource*, vtkTable*)),
+                SLOT(histogramReady(DataSource*, vtkTable*)));
+  this->connect(&scheduler,
+                SIGNAL(jointHistogramReady(DataSource*, DataSource*,
+                                           vtkImageData*)),
+                SLOT(jointHistogramReady(DataSource*, DataSource*,
+                                         vtkImageData*)));
+  this->updateJointDataSources();
 }
 
 //-----------------------------------------------------------------------------
@@ -276,6 +278,7 @@ void CentralWidget::setDataSource(DataSource* source)
     {
     this->connect(source, SIGNAL(dataChanged()), SLOT(refreshHistogram()));
     }
+  this->updateJointDataSources();
 
   // Whenever the data source changes clear the plot, and then populate when
   // ready (or use the cached histogram values.
@@ -286,26 +289,12 @@ void CentralWidget::setDataSource(DataSource* source)
     return;
     }
 
-  // Get the actual data source, build a histogram out of it.
-  vtkTrivialProducer *t = vtkTrivialProducer::SafeDownCast(
-    source->producer()->GetClientSideObject());
-  vtkImageData *data = vtkImageData::SafeDownCast(t->GetOutputDataObject(0));
-
-  // Check our cache, and use that if appopriate (or update it).
-  if (this->HistogramCache.contains(data))
+  // Use the cached histogram of the current data if there is one.
+  HistogramScheduler& scheduler = HistogramScheduler::instance();
+  if (vtkTable *cachedTable = scheduler.histogram(source))
     {
-    vtkTable *cachedTable = this->HistogramCache[data];
-    if (cachedTable->GetMTime() > data->GetMTime())
-      {
-      this->setHistogramTable(cachedTable);
-      return;
-      }
-    else
-      {
-      // Need to recalculate, clear the plots, and remove the cached data.
-      this->Chart->ClearPlots();
-      this->HistogramCache.remove(data);
-      }
+    this->setHistogramTable(cachedTable);
+    return;
     }
 
   // Get the current color map
@@ -320,24 +309,8 @@ void CentralWidget::setDataSource(DataSource* source)
     this->LUT = NULL;
     }
 
-  // Calculate a histogram.
-  vtkNew<vtkTable> table;
-  this->HistogramCache[data] = table.Get();
-
-  if (!this->Worker)
-    {
-    this->Worker = new HistogramWorker(this);
-    connect(this->Worker, SIGNAL(finished()), SLOT(histogramReady()));
-    }
-  else if (this->Worker->isRunning())
-    {
-    // FIXME: Queue, abort, something.
-    qDebug() << "Worker already running, skipping this one.";
-    return;
-    }
-  this->Worker->input = data;
-  this->Worker->output = table.Get();
-  this->Worker->start();
+  // Calculate a histogram, showing estimates until it is ready.
+  scheduler.request(source);
 }
 
 void CentralWidget::refreshHistogram()
@@ -345,15 +318,23 @@ void CentralWidget::refreshHistogram()
   this->setDataSource(this->ADataSource);
 }
 
-void CentralWidget::histogramReady()
+void CentralWidget::histogramProgress(DataSource *source, vtkTable *table)
 {
-  if (!this->Worker || !this->Worker->input || !this->Worker->output)
-    return;
-
-  this->setHistogramTable(this->Worker->output.Get());
+  // Only show the estimate if it is for the data source being shown.
+  if (source == this->ADataSource &&
+      table->GetNumberOfRows() == HistogramScheduler::DefaultNumberOfBins)
+    {
+    this->setHistogramTable(table);
+    }
+}
 
-  this->Worker->input = NULL;
-  this->Worker->output = NULL;
+void CentralWidget::histogramReady(DataSource *source, vtkTable *table)
+{
+  if (source == this->ADataSource &&
+      table->GetNumberOfRows() == HistogramScheduler::DefaultNumberOfBins)
+    {
+    this->setHistogramTable(table);
+    }
 }
 
 void CentralWidget::histogramClicked(vtkObject *caller)
@@ -371,12 +352,6 @@ void CentralWidget::histogramClicked(vtkObject *caller)
 
   // Use active ModuleContour is possible. Otherwise, find the first existing
   // ModuleContour instance or just create a new one, if none exists.
-#ifdef DAX_DEVICE_ADAPTER
-  typedef ModuleStreamingContour ModuleContourType;
-#else
-  typedef ModuleContour ModuleContourType;
-#endif
-
   ModuleContourType* contour = qobject_cast<ModuleContourType*>(
     ActiveObjects::instance().activeModule());
   if (!contour)
@@ -399,6 +374,186 @@ void CentralWidget::histogramClicked(vtkObject *caller)
   tomviz::convert<pqView*>(view)->render();
 }
 
+void CentralWidget::updateJointDataSources()
+{
+  // List the other data sources with the same extent, whose voxels can be
+  // paired with those of the data source.
+  QList<QPointer<DataSource> >& sources = this->Internals->JointDataSources;
+  sources.clear();
+  if (this->ADataSource)
+    {
+    const int* extent =
+      this->ADataSource->producer()->GetDataInformation(0)->GetExtent();
+    foreach (DataSource* source, ModuleManager::instance().dataSources())
+      {
+      const int* otherExtent =
+        source->producer()->GetDataInformation(0)->GetExtent();
+      if (source != this->ADataSource &&
+          std::equal(extent, extent + 6, otherExtent))
+        {
+        sources.append(source);
+        }
+      }
+    }
+
+  QComboBox* combo = this->Internals->Ui.jointDataSource;
+  bool prev = combo->blockSignals(true);
+  combo->clear();
+  combo->addItem("None");
+  foreach (DataSource* source, sources)
+    {
+    combo->addItem(tomviz::label(source->producer()));
+    }
+  int index = sources.indexOf(this->JointDataSource);
+  combo->setCurrentIndex(index + 1);
+  combo->blockSignals(prev);
+  this->setJointDataSource(index + 1);
+}
+
+void CentralWidget::setJointDataSource(int index)
+{
+  DataSource* source = index > 0 ?
+    this->Internals->JointDataSources.value(index - 1).data() : NULL;
+  if (this->JointDataSource)
+    {
+    this->disconnect(this->JointDataSource, SIGNAL(dataChanged()),
+                     this, SLOT(updateJointDataSources()));
+    }
+  this->JointDataSource = source;
+  if (source)
+    {
+    // Its extent may change, e.g. when it is cropped.
+    this->connect(source, SIGNAL(dataChanged()),
+                  SLOT(updateJointDataSources()), Qt::UniqueConnection);
+    }
+  this->refreshJointHistogram();
+}
+
+void CentralWidget::refreshJointHistogram()
+{
+  Ui::CentralWidget& ui = this->Internals->Ui;
+  DataSource* first = this->ADataSource;
+  DataSource* second = this->JointDataSource;
+  if (!first || !second)
+    {
+    ui.jointHistogramWidget->setVisible(false);
+    ui.jointHistogramStatus->setText("");
+    return;
+    }
+
+  HistogramScheduler& scheduler = HistogramScheduler::instance();
+  if (vtkImageData *cachedImage = scheduler.jointHistogram(first, second))
+    {
+    this->setJointHistogramImage(cachedImage);
+    return;
+    }
+  ui.jointHistogramStatus->setText("Computing...");
+  scheduler.requestJoint(first, second);
+}
+
+void CentralWidget::jointHistogramReady(DataSource *first, DataSource *second,
+                                        vtkImageData *histogram)
+{
+  if (first == this->ADataSource && second == this->JointDataSource &&
+      histogram->GetDimensions()[0] ==
+      HistogramScheduler::DefaultJointNumberOfBins)
+    {
+    this->setJointHistogramImage(histogram);
+    }
+}
+
+void CentralWidget::setJointHistogramImage(vtkImageData *image)
+{
+  vtkIdTypeArray *pops =
+      vtkIdTypeArray::SafeDownCast(image->GetPointData()->GetScalars());
+  if (!pops)
+    {
+    return;
+    }
+
+  // Show the counts on a log scale, so sparse pairs remain visible.
+  vtkNew<vtkImageData> display;
+  display->CopyStructure(image);
+  vtkNew<vtkFloatArray> logPops;
+  logPops->SetNumberOfTuples(pops->GetNumberOfTuples());
+  float max = 1.0f;
+  for (vtkIdType i = 0; i < pops->GetNumberOfTuples(); ++i)
+    {
+    float value = static_cast<float>(log10(1.0 + pops->GetValue(i)));
+    logPops->SetValue(i, value);
+    max = std::max(max, value);
+    }
+  display->GetPointData()->SetScalars(logPops.Get());
+
+  vtkNew<vtkColorTransferFunction> transferFunction;
+  transferFunction->AddRGBPoint(0.0, 1.0, 1.0, 1.0);
+  transferFunction->AddRGBPoint(0.5 * max, 0.3, 0.3, 1.0);
+  transferFunction->AddRGBPoint(max, 0.0, 0.0, 0.4);
+
+  vtkChartJointHistogram* chart = this->JointChart.Get();
+  chart->SetInputData(display.Get());
+  chart->SetTransferFunction(transferFunction.Get());
+  chart->GetAxis(vtkAxis::BOTTOM)->SetTitle(
+    tomviz::label(this->ADataSource->producer()).toLatin1().data());
+  chart->GetAxis(vtkAxis::LEFT)->SetTitle(
+    tomviz::label(this->JointDataSource->producer()).toLatin1().data());
+  chart->RecalculateBounds();
+
+  Ui::CentralWidget& ui = this->Internals->Ui;
+  ui.jointHistogramStatus->setText("");
+  ui.jointHistogramWidget->setVisible(true);
+  ui.jointHistogramWidget->update();
+}
+
+void CentralWidget::jointHistogramSelected(vtkObject *)
+{
+  vtkSMViewProxy* view = ActiveObjects::instance().activeView();
+  if (!view || !this->ADataSource || !this->JointDataSource)
+    {
+    return;
+    }
+
+  // The active threshold or contour of either data source takes the range of
+  // its axis, a contour its middle value. Otherwise both data sources are
+  // thresholded to the selected ranges, with new thresholds if need be.
+  DataSource* sources[2] = { this->ADataSource, this->JointDataSource };
+  const double* selection = this->JointChart->Selection;
+  Module* active = ActiveObjects::instance().activeModule();
+  for (int i = 0; i < 2; ++i)
+    {
+    if (!active || active->dataSource() != sources[i])
+      {
+      continue;
+      }
+    if (ModuleThreshold* threshold = qobject_cast<ModuleThreshold*>(active))
+      {
+      threshold->setThresholdRange(selection + 2 * i);
+      tomviz::convert<pqView*>(view)->render();
+      return;
+      }
+    if (ModuleContourType* contour = qobject_cast<ModuleContourType*>(active))
+      {
+      contour->setIsoValue(0.5 * (selection[2 * i] + selection[2 * i + 1]));
+      tomviz::convert<pqView*>(view)->render();
+      return;
+      }
+    }
+
+  for (int i = 0; i < 2; ++i)
+    {
+    QList<ModuleThreshold*> thresholds =
+      ModuleManager::instance().findModules<ModuleThreshold*>(sources[i], view);
+    ModuleThreshold* threshold = thresholds.size() > 0 ? thresholds[0] :
+      qobject_cast<ModuleThreshold*>(ModuleManager::instance().createAndAddModule(
+          "Threshold", sources[i], view));
+    if (threshold)
+      {
+      threshold->setThresholdRange(selection + 2 * i);
+      }
+    }
+  tomviz::convert<pqView*>(view)->render();
+}
+
 void CentralWidget::setHistogramTable(vtkTable *table)
 {
   vtkDataArray *arr =
@@ -443,5 +598,3 @@ void CentralWidget::setHistogramTable(vtkTable *table)
 }
 
 } // end of namespace tomviz
-
-#include "CentralWidget.moc"
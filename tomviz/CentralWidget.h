@@ -18,7 +18,6 @@
 
 #include <QScopedPointer>
 #include <QWidget>
-#include <QMap>
 #include <QPointer>
 #include <vtkNew.h>
 #include <vtkWeakPointer.h>
@@ -35,12 +34,14 @@ class vtkScalarsToColors;
 namespace tomviz
 {
 class DataSource;
-class HistogramWorker;
 class vtkChartHistogram;
+class vtkChartJointHistogram;
 
 /// CentralWidget is a QWidget that is used as the central widget
 /// for the application. This include a histogram at the top and a
-/// ParaView view-layout widget at the bottom.
+/// ParaView view-layout widget at the bottom. A second tab at the top shows
+/// the joint histogram of the data source and another one of the same
+/// extent, on which a range of both can be selected.
 class CentralWidget : public QWidget
 {
   Q_OBJECT
@@ -57,23 +58,32 @@ public slots:
   void setDataSource(DataSource*);
 
 private slots:
-  void histogramReady();
+  void histogramProgress(DataSource *source, vtkTable *table);
+  void histogramReady(DataSource *source, vtkTable *table);
   void histogramClicked(vtkObject *caller);
   void refreshHistogram();
+  void jointHistogramReady(DataSource *first, DataSource *second,
+                           vtkImageData *histogram);
+  void jointHistogramSelected(vtkObject *caller);
+  void setJointDataSource(int index);
+  void updateJointDataSources();
 
 private:
   Q_DISABLE_COPY(CentralWidget)
 
   void setHistogramTable(vtkTable *table);
+  void refreshJointHistogram();
+  void setJointHistogramImage(vtkImageData *image);
 
   class CWInternals;
   QScopedPointer<CWInternals> Internals;
   vtkNew<vtkContextView> Histogram;
   vtkNew<vtkChartHistogram> Chart;
+  vtkNew<vtkContextView> JointHistogram;
+  vtkNew<vtkChartJointHistogram> JointChart;
   vtkNew<vtkEventQtSlotConnect> EventLink;
   QPointer<DataSource> ADataSource;
-  HistogramWorker *Worker;
-  QMap<vtkImageData *, vtkSmartPointer<vtkTable> > HistogramCache;
+  QPointer<DataSource> JointDataSource;
   vtkScalarsToColors *LUT;
 };
 
@@ -1,15 +1,263 @@
 #ifndef tomvizComputeHistogram_h
 #define tomvizComputeHistogram_h
 
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPTools.h>
+#include <vtkType.h>
+#include <vtkTypeTraits.h>
+
+#include <algorithm>
+#include <vector>
+
 #ifdef DAX_DEVICE_ADAPTER
 #include <dax/cont/ArrayHandle.h>
 #include <dax/cont/ArrayHandleCounting.h>
 #include <dax/cont/DispatcherMapField.h>
 #include "dax/Worklets.h"
+#include <tbb/spin_mutex.h>
 #endif
 
+// GetScalarRange() computes the range of n values into minmax, returning
+// false when there are no values other than NaNs. CalculateHistogram() adds
+// the counts of n values into numberOfBins bins of width inc, starting at
+// min, so a volume may be binned a chunk at a time. NaNs are not counted.
+// When moments is not NULL the sum and the sum of squares of (value - min)
+// and the number of values that are not NaN are added to moments[0],
+// moments[1] and moments[2] in the same pass, from which the mean and
+// variance follow.
 namespace tomviz
 {
+
+namespace detail
+{
+
+template<typename T>
+class GatherSamplesFunctor
+{
+public:
+  GatherSamplesFunctor(const T* values, vtkIdType stride, T* samples)
+    : Values(values), Stride(stride), Samples(samples)
+  {
+  }
+
+  void operator()(vtkIdType begin, vtkIdType end)
+  {
+    for (vtkIdType j = begin; j < end; ++j)
+      {
+      this->Samples[j] = this->Values[j * this->Stride];
+      }
+  }
+
+  const T* Values;
+  vtkIdType Stride;
+  T* Samples;
+};
+
+// The bin a value falls in, clamped to [0, maxBin], NaNs giving bin 0. The
+// value is clamped before the conversion to int, which is undefined out of
+// the range of int, with min and max that compile without branches.
+inline int binIndex(double value, double min, double inverseInc, int maxBin)
+{
+  // std::max(0.0, NaN) is 0.0, as NaN compares false.
+  const double index = std::max(0.0, (value - min) * inverseInc);
+  return static_cast<int>(std::min(static_cast<double>(maxBin), index));
+}
+
+// Adds the counts of n values into pops and, when moments is not NULL, their
+// moments as CalculateHistogram() does. The bin index is found by multiplying
+// with the reciprocal of the bin width and clamping, without branches, so the
+// loop stays tight. It runs serially, on the share of the values of one
+// thread.
+template<typename T, typename CountT>
+void binValues(const T* values, vtkIdType n, double min, double inverseInc,
+               int maxBin, CountT* pops, double* moments)
+{
+  if (!moments)
+    {
+    for (vtkIdType j = 0; j < n; ++j)
+      {
+      const double value = static_cast<double>(values[j]);
+      pops[binIndex(value, min, inverseInc, maxBin)] += value == value;
+      }
+    return;
+    }
+
+  // Moments are accumulated relative to min, which keeps the variance
+  // accurate for data far from zero. NaNs are left out.
+  double sum = 0.0;
+  double sumSquares = 0.0;
+  double count = 0.0;
+  for (vtkIdType j = 0; j < n; ++j)
+    {
+    const double value = static_cast<double>(values[j]);
+    const bool valid = value == value;
+    pops[binIndex(value, min, inverseInc, maxBin)] += valid;
+    const double d = valid ? value - min : 0.0;
+    sum += d;
+    sumSquares += d * d;
+    count += valid ? 1.0 : 0.0;
+    }
+  moments[0] += sum;
+  moments[1] += sumSquares;
+  moments[2] += count;
+}
+
+// Types with few enough values to be counted in a table with one entry per
+// possible value, 256 or 65536 entries.
+template<typename T> struct DirectIndexTraits
+{
+  static const bool Enabled = false;
+};
+template<> struct DirectIndexTraits<char>
+{
+  static const bool Enabled = true;
+};
+template<> struct DirectIndexTraits<signed char>
+{
+  static const bool Enabled = true;
+};
+template<> struct DirectIndexTraits<unsigned char>
+{
+  static const bool Enabled = true;
+};
+template<> struct DirectIndexTraits<short>
+{
+  static const bool Enabled = true;
+};
+template<> struct DirectIndexTraits<unsigned short>
+{
+  static const bool Enabled = true;
+};
+
+// The number of entries of a direct index table of T, and the value counted
+// by its first entry.
+template<typename T> int directTableSize()
+{
+  return static_cast<int>(vtkTypeTraits<T>::Max()) -
+    static_cast<int>(vtkTypeTraits<T>::Min()) + 1;
+}
+template<typename T> int directTableOffset()
+{
+  return static_cast<int>(vtkTypeTraits<T>::Min());
+}
+
+// Adds the counts of a direct index table, in which table[i] counts the value
+// i + offset, into pops and moments, binning each value exactly as
+// binValues() would.
+template<typename CountT>
+void binTable(const vtkIdType* table, int size, int offset, double min,
+              double inverseInc, int maxBin, CountT* pops, double* moments)
+{
+  for (int i = 0; i < size; ++i)
+    {
+    const vtkIdType count = table[i];
+    if (count)
+      {
+      pops[binIndex(i + offset, min, inverseInc, maxBin)] +=
+        static_cast<CountT>(count);
+      if (moments)
+        {
+        const double d = i + offset - min;
+        moments[0] += count * d;
+        moments[1] += count * d * d;
+        moments[2] += count;
+        }
+      }
+    }
+}
+
+// Per-thread private joint histograms of pairs of values, merged in Reduce().
+template<typename T1, typename T2>
+class JointHistogramFunctor
+{
+public:
+  JointHistogramFunctor(const T1* first, const T2* second,
+                        const double min[2], const double inc[2],
+                        int numberOfBins, vtkIdType* pops)
+    : First(first), Second(second), NumberOfBins(numberOfBins), Pops(pops)
+  {
+    for (int i = 0; i < 2; ++i)
+      {
+      this->Min[i] = min[i];
+      this->InverseInc[i] = 1.0 / inc[i];
+      }
+  }
+
+  void Initialize()
+  {
+    this->LocalPops.Local().assign(this->NumberOfBins * this->NumberOfBins,
+                                   0);
+  }
+
+  void operator()(vtkIdType begin, vtkIdType end)
+  {
+    vtkIdType* pops = &this->LocalPops.Local()[0];
+    const int bins = this->NumberOfBins;
+    for (vtkIdType j = begin; j < end; ++j)
+      {
+      const double a = static_cast<double>(this->First[j]);
+      const double b = static_cast<double>(this->Second[j]);
+      // Pairs with a NaN are left out.
+      if (a == a && b == b)
+        {
+        ++pops[binIndex(a, this->Min[0], this->InverseInc[0], bins - 1) +
+               bins * binIndex(b, this->Min[1], this->InverseInc[1],
+                               bins - 1)];
+        }
+      }
+  }
+
+  void Reduce()
+  {
+    const int size = this->NumberOfBins * this->NumberOfBins;
+    for (typename vtkSMPThreadLocal<std::vector<vtkIdType> >::iterator it =
+         this->LocalPops.begin(); it != this->LocalPops.end(); ++it)
+      {
+      for (int i = 0; i < size; ++i)
+        {
+        this->Pops[i] += (*it)[i];
+        }
+      }
+  }
+
+  const T1* First;
+  const T2* Second;
+  double Min[2];
+  double InverseInc[2];
+  int NumberOfBins;
+  vtkIdType* Pops;
+  vtkSMPThreadLocal<std::vector<vtkIdType> > LocalPops;
+};
+
+}
+
+/// Copies every stride'th of the n values into samples, which must hold
+/// (n + stride - 1) / stride values. The samples can then be passed to
+/// GetScalarRange() and CalculateHistogram() for a quick estimate.
+template<typename T>
+void GatherSamples(const T *values, const vtkIdType n, const vtkIdType stride,
+                   T *samples)
+{
+  detail::GatherSamplesFunctor<T> functor(values, stride, samples);
+  vtkSMPTools::For(0, (n + stride - 1) / stride, functor);
+}
+
+/// Adds the counts of n pairs of values (first[i], second[i]) into a
+/// numberOfBins x numberOfBins joint histogram, at pops[i + numberOfBins * j]
+/// for bin i of the first and bin j of the second values. min and inc are the
+/// start and the bin width for the first and the second values. Pairs with a
+/// NaN are not counted.
+template<typename T1, typename T2>
+void CalculateJointHistogram(const T1 *first, const T2 *second,
+                             const vtkIdType n, const double min[2],
+                             const double inc[2], const int numberOfBins,
+                             vtkIdType *pops)
+{
+  detail::JointHistogramFunctor<T1, T2> functor(first, second, min, inc,
+                                                numberOfBins, pops);
+  vtkSMPTools::For(0, n, functor);
+}
+
 #ifdef DAX_DEVICE_ADAPTER
 
 namespace worklets
@@ -21,7 +269,7 @@ struct ScalarRange: dax::exec::WorkletMapField
   typedef _1 ExecutionSignature(WorkId);
 
   DAX_CONT_EXPORT
-  ScalarRange(T* v, int len, int numWorkers):
+  ScalarRange(T* v, vtkIdType len, int numWorkers):
     Values(v),
     Length(len),
     TaskSize(len/numWorkers),
@@ -41,21 +289,23 @@ struct ScalarRange: dax::exec::WorkletMapField
       { end_offset = (id+1)*TaskSize; }
     const T* myEnd = this->Values + end_offset;
 
+    //NaNs never compare smaller or larger, so they are ignored. A task with
+    //no other values returns an empty range, min > max.
     dax::Tuple<T,2> lh;
-    lh[0] = myValue[0];
-    lh[1] = myValue[0];
+    lh[0] = vtkTypeTraits<T>::Max();
+    lh[1] = vtkTypeTraits<T>::Min();
 
-    for(myValue++; myValue != myEnd; myValue++)
+    for(; myValue != myEnd; myValue++)
       {
-      lh[0] = std::min(lh[0],*myValue);
-      lh[1] = std::max(lh[1],*myValue);
+      lh[0] = *myValue < lh[0] ? *myValue : lh[0];
+      lh[1] = *myValue > lh[1] ? *myValue : lh[1];
       }
 
     return dax::Tuple<double,2>(lh[0],lh[1]);
   }
   T* Values;
-  int Length;
-  int TaskSize;
+  vtkIdType Length;
+  vtkIdType TaskSize;
   int NumWorkers;
 };
 
@@ -66,8 +316,9 @@ struct Histogram: dax::exec::WorkletMapField
   typedef void ExecutionSignature(_1);
 
   DAX_CONT_EXPORT
-  Histogram(T* v, int valueLength, int numWorkers,
-            int* histo, float minValue, int numBins, float binSize):
+  Histogram(T* v, vtkIdType valueLength, int numWorkers,
+            vtkIdType* histo, double minValue, int numBins, double binSize,
+            double* moments, tbb::spin_mutex* momentsMutex):
     Length(valueLength),
     TaskSize(valueLength/numWorkers),
     NumWorkers(numWorkers),
@@ -75,13 +326,15 @@ struct Histogram: dax::exec::WorkletMapField
     MinValue(minValue),
     BinSize(binSize),
     Values(v),
-    GlobalHisto(histo)
+    GlobalHisto(histo),
+    Moments(moments),
+    MomentsMutex(momentsMutex)
     {}
 
   DAX_EXEC_EXPORT
   void operator()(dax::Id id) const
   {
-    std::vector<int> histo(this->NumBins, 0);
+    std::vector<vtkIdType> histo(this->NumBins, 0);
 
     const int maxBin(this->NumBins - 1);
 
@@ -95,38 +348,59 @@ struct Histogram: dax::exec::WorkletMapField
 
     const T* myEnd = this->Values + end_offset;
 
+    const double inverseInc = 1.0 / this->BinSize;
+    double sum = 0.0;
+    double sumSquares = 0.0;
+    double count = 0.0;
     for(; myValue != myEnd; myValue++)
       {
-      const int index = std::min(maxBin,
-                     static_cast<int>((*myValue - MinValue) / BinSize));
-      ++histo[index];
+      const int index = detail::binIndex(*myValue, this->MinValue, inverseInc,
+                                         maxBin);
+      const bool valid = *myValue == *myValue;
+      histo[index] += valid;
+      if (this->Moments && valid)
+        {
+        const double d = *myValue - MinValue;
+        sum += d;
+        sumSquares += d * d;
+        ++count;
+        }
+      }
+
+    if (this->Moments)
+      {
+      tbb::spin_mutex::scoped_lock lock(*this->MomentsMutex);
+      this->Moments[0] += sum;
+      this->Moments[1] += sumSquares;
+      this->Moments[2] += count;
       }
 
     //using tbb atomics add my histo to the global histogram
-    tbb::atomic<int> x;
+    tbb::atomic<vtkIdType>* globalHisto =
+      reinterpret_cast<tbb::atomic<vtkIdType>*>(this->GlobalHisto);
     for(int i=0; i < this->NumBins; ++i)
       {
-      x = GlobalHisto[i];
-      x.fetch_and_add( histo[ i ]);
-      GlobalHisto[i] = x;
+      globalHisto[i].fetch_and_add(histo[i]);
       }
 
   }
 
-  int Length;
-  int TaskSize;
+  vtkIdType Length;
+  vtkIdType TaskSize;
   int NumWorkers;
   int NumBins;
-  float MinValue;
-  float BinSize;
+  double MinValue;
+  double BinSize;
   T* Values;
-  int* GlobalHisto;
+  vtkIdType* GlobalHisto;
+  double* Moments;
+  tbb::spin_mutex* MomentsMutex;
 };
 
 }
 
 template<typename T>
-void GetScalarRange(T *values, const unsigned int n, double* minmax)
+bool GetScalarRange(T *values, const vtkIdType n, double* minmax)
 {
   using namespace dax::cont;
   const int numTasks = 32;
@@ -143,52 +417,258 @@ void GetScalarRange(T *values, const unsigned int n, double* minmax)
                                         minmaxHandle.GetPortalConstControl();
   minmax[0] = portal.Get(0)[0];
   minmax[1] = portal.Get(0)[1];
-  for (unsigned int j = 1; j < minmaxHandle.GetNumberOfValues(); ++j)
+  for (dax::Id j = 1; j < minmaxHandle.GetNumberOfValues(); ++j)
     {
     minmax[0] = std::min(portal.Get(j)[0], minmax[0]);
     minmax[1] = std::max(portal.Get(j)[1], minmax[1]);
     }
+  if (minmax[0] > minmax[1])
+    {
+    // Empty, or nothing but NaNs.
+    minmax[0] = minmax[1] = 0.0;
+    return false;
+    }
+  return true;
 }
 
 template<typename T>
-void CalculateHistogram(T *values, const unsigned int n, const float min,
-                        int *pops, const float inc, const int numberOfBins)
+void CalculateHistogram(T *values, const vtkIdType n, const double min,
+                        vtkIdType *pops, const double inc,
+                        const int numberOfBins, double *moments = NULL)
 {
   using namespace dax::cont;
   const int numTasks = 32;
 
-  worklets::Histogram<T> worklet(values, n, numTasks, pops,  min, numberOfBins, inc);
+  tbb::spin_mutex momentsMutex;
+  worklets::Histogram<T> worklet(values, n, numTasks, pops,  min, numberOfBins,
+                                 inc, moments, &momentsMutex);
   DispatcherMapField< worklets::Histogram<T> > dispatcher(worklet);
   dispatcher.Invoke( make_ArrayHandleCounting<dax::Id>(0,numTasks) );
 }
 
 #else
+
+namespace detail
+{
+
+// Per-thread min/max, merged in Reduce(). NaNs never compare smaller or
+// larger, so they are ignored.
 template<typename T>
-void GetScalarRange(T *values, const unsigned int n, double* minmax)
+class ScalarRangeFunctor
 {
-  T tempMinMax[2];
-  tempMinMax[0] = values[0];
-  tempMinMax[1] = values[0];
-  for (unsigned int j = 1; j < n; ++j)
-    {
-    tempMinMax[0] = std::min(values[j], tempMinMax[0]);
-    tempMinMax[1] = std::max(values[j], tempMinMax[1]);
-    }
+public:
+  ScalarRangeFunctor(const T* values)
+    : Values(values), Min(vtkTypeTraits<T>::Max()),
+      Max(vtkTypeTraits<T>::Min()), LocalMin(vtkTypeTraits<T>::Max()),
+      LocalMax(vtkTypeTraits<T>::Min())
+  {
+  }
+
+  // The locals start from the exemplar values, but vtkSMPTools only calls
+  // Reduce() on functors that provide Initialize().
+  void Initialize()
+  {
+  }
+
+  void operator()(vtkIdType begin, vtkIdType end)
+  {
+    T lo = this->LocalMin.Local();
+    T hi = this->LocalMax.Local();
+    for (vtkIdType j = begin; j < end; ++j)
+      {
+      const T value = this->Values[j];
+      lo = value < lo ? value : lo;
+      hi = value > hi ? value : hi;
+      }
+    this->LocalMin.Local() = lo;
+    this->LocalMax.Local() = hi;
+  }
+
+  void Reduce()
+  {
+    typedef typename vtkSMPThreadLocal<T>::iterator Iterator;
+    for (Iterator it = this->LocalMin.begin(); it != this->LocalMin.end(); ++it)
+      {
+      this->Min = std::min(this->Min, *it);
+      }
+    for (Iterator it = this->LocalMax.begin(); it != this->LocalMax.end(); ++it)
+      {
+      this->Max = std::max(this->Max, *it);
+      }
+  }
+
+  const T* Values;
+  T Min;
+  T Max;
+  vtkSMPThreadLocal<T> LocalMin;
+  vtkSMPThreadLocal<T> LocalMax;
+};
+
+// Per-thread private histograms, merged in Reduce().
+template<typename T>
+class HistogramFunctor
+{
+public:
+  HistogramFunctor(const T* values, double min, double inc, int numberOfBins,
+                   vtkIdType* pops, double* moments)
+    : Values(values), Min(min), InverseInc(1.0 / inc),
+      NumberOfBins(numberOfBins), Pops(pops), Moments(moments)
+  {
+  }
+
+  void Initialize()
+  {
+    this->LocalPops.Local().assign(this->NumberOfBins, 0);
+    this->LocalMoments.Local().assign(3, 0.0);
+  }
+
+  void operator()(vtkIdType begin, vtkIdType end)
+  {
+    binValues(this->Values + begin, end - begin, this->Min, this->InverseInc,
+              this->NumberOfBins - 1, &this->LocalPops.Local()[0],
+              this->Moments ? &this->LocalMoments.Local()[0] : NULL);
+  }
+
+  void Reduce()
+  {
+    for (typename vtkSMPThreadLocal<std::vector<vtkIdType> >::iterator it =
+         this->LocalPops.begin(); it != this->LocalPops.end(); ++it)
+      {
+      for (int i = 0; i < this->NumberOfBins; ++i)
+        {
+        this->Pops[i] += (*it)[i];
+        }
+      }
+    if (this->Moments)
+      {
+      for (typename vtkSMPThreadLocal<std::vector<double> >::iterator it =
+           this->LocalMoments.begin(); it != this->LocalMoments.end(); ++it)
+        {
+        for (int i = 0; i < 3; ++i)
+          {
+          this->Moments[i] += (*it)[i];
+          }
+        }
+      }
+  }
+
+  const T* Values;
+  double Min;
+  double InverseInc;
+  int NumberOfBins;
+  vtkIdType* Pops;
+  double* Moments;
+  vtkSMPThreadLocal<std::vector<vtkIdType> > LocalPops;
+  vtkSMPThreadLocal<std::vector<double> > LocalMoments;
+};
+
+// Counts every possible value of an 8 or 16 bit integer type by direct
+// indexing, with no floating point math in the loop. Per-thread tables are
+// merged into Table in Reduce().
+template<typename T>
+class DirectHistogramFunctor
+{
+public:
+  DirectHistogramFunctor(const T* values)
+    : Values(values), Offset(directTableOffset<T>()),
+      Size(directTableSize<T>()), Table(Size, 0)
+  {
+  }
+
+  void Initialize()
+  {
+    this->LocalTable.Local().assign(this->Size, 0);
+  }
+
+  void operator()(vtkIdType begin, vtkIdType end)
+  {
+    vtkIdType* table = &this->LocalTable.Local()[0];
+    const int offset = this->Offset;
+    for (vtkIdType j = begin; j < end; ++j)
+      {
+      ++table[static_cast<int>(this->Values[j]) - offset];
+      }
+  }
+
+  void Reduce()
+  {
+    for (typename vtkSMPThreadLocal<std::vector<vtkIdType> >::iterator it =
+         this->LocalTable.begin(); it != this->LocalTable.end(); ++it)
+      {
+      for (int i = 0; i < this->Size; ++i)
+        {
+        this->Table[i] += (*it)[i];
+        }
+      }
+  }
+
+  const T* Values;
+  int Offset;
+  int Size;
+  std::vector<vtkIdType> Table;
+  vtkSMPThreadLocal<std::vector<vtkIdType> > LocalTable;
+};
+
+template<typename T, bool DirectIndex>
+struct HistogramDispatch
+{
+  static void calculate(const T* values, vtkIdType n, double min, double inc,
+                        vtkIdType* pops, int numberOfBins, double* moments)
+  {
+    HistogramFunctor<T> functor(values, min, inc, numberOfBins, pops, moments);
+    vtkSMPTools::For(0, n, functor);
+  }
+};
+
+template<typename T>
+struct HistogramDispatch<T, true>
+{
+  static void calculate(const T* values, vtkIdType n, double min, double inc,
+                        vtkIdType* pops, int numberOfBins, double* moments)
+  {
+    DirectHistogramFunctor<T> functor(values);
+    // Merging and rebinning the full table is only worth it when there are
+    // many more voxels than table entries.
+    if (n < 4 * static_cast<vtkIdType>(functor.Size))
+      {
+      HistogramDispatch<T, false>::calculate(values, n, min, inc, pops,
+                                             numberOfBins, moments);
+      return;
+      }
+    vtkSMPTools::For(0, n, functor);
+
+    // Derive the requested bins, and the moments, from the full resolution
+    // table.
+    binTable(&functor.Table[0], functor.Size, functor.Offset, min, 1.0 / inc,
+             numberOfBins - 1, pops, moments);
+  }
+};
 
-  minmax[0] = static_cast<double>(tempMinMax[0]);
-  minmax[1] = static_cast<double>(tempMinMax[1]);
 }
 
 template<typename T>
-void CalculateHistogram(T *values, const unsigned int n, const float min,
-                        int *pops, const float inc, const int numberOfBins)
+bool GetScalarRange(T *values, const vtkIdType n, double* minmax)
 {
-  const int maxBin(numberOfBins - 1);
-  for (unsigned int j = 0; j < n; ++j)
+  detail::ScalarRangeFunctor<T> functor(values);
+  vtkSMPTools::For(0, n, functor);
+  if (functor.Min > functor.Max)
     {
-    int index = std::min(static_cast<int>((*(values++) - min) / inc), maxBin);
-    ++pops[index];
+    // Empty, or nothing but NaNs.
+    minmax[0] = minmax[1] = 0.0;
+    return false;
     }
+  minmax[0] = static_cast<double>(functor.Min);
+  minmax[1] = static_cast<double>(functor.Max);
+  return true;
+}
+
+template<typename T>
+void CalculateHistogram(T *values, const vtkIdType n, const double min,
+                        vtkIdType *pops, const double inc,
+                        const int numberOfBins, double *moments = NULL)
+{
+  detail::HistogramDispatch<T, detail::DirectIndexTraits<T>::Enabled>::
+    calculate(values, n, min, inc, pops, numberOfBins, moments);
 }
 #endif
 
@@ -96,6 +96,9 @@ DataPropertiesPanel::DataPropertiesPanel(QWidget* parentObject)
   this->connect(&ActiveObjects::instance(),
                 SIGNAL(dataSourceChanged(DataSource*)),
                 SLOT(setDataSource(DataSource*)));
+  this->connect(this->Internals->Ui.PercentileColorMapRange,
+                SIGNAL(clicked(bool)),
+                SLOT(usePercentileColorMapRange(bool)));
 }
 
 //-----------------------------------------------------------------------------
@@ -157,6 +160,8 @@ void DataPropertiesPanel::update()
                                      .arg(tscalars->GetComponentRange(0)[1]));
     }
 
+  ui.PercentileColorMapRange->setChecked(dsource->usePercentileColorMapRange());
+
   pqProxyWidget* colorMapWidget = new pqProxyWidget(dsource->colorMap());
   colorMapWidget->setApplyChangesImmediately(true);
   colorMapWidget->updatePanel();
@@ -182,4 +187,14 @@ void DataPropertiesPanel::render()
 }
 
 //-----------------------------------------------------------------------------
+void DataPropertiesPanel::usePercentileColorMapRange(bool val)
+{
+  DataSource* dsource = this->Internals->CurrentDataSource;
+  if (dsource)
+    {
+    dsource->setUsePercentileColorMapRange(val);
+    this->render();
+    }
+}
+
 }
@@ -40,6 +40,7 @@ private slots:
   void setDataSource(DataSource*);
   void update();
   void render();
+  void usePercentileColorMapRange(bool);
 
 private:
   Q_DISABLE_COPY(DataPropertiesPanel)
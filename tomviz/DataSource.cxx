@@ -15,7 +15,9 @@
 ******************************************************************************/
 #include "DataSource.h"
 
-#include "OperatorPython.h"
+#include "HistogramScheduler.h"
+#include "Operator.h"
+#include "OperatorFactory.h"
 #include "Utilities.h"
 #include "vtkDataObject.h"
 #include "vtkExtractVOI.h"
@@ -32,6 +34,7 @@
 
 #include <vtk_pugixml.h>
 
+#include <algorithm>
 
 namespace tomviz
 {
@@ -43,6 +46,22 @@ public:
   vtkWeakPointer<vtkSMSourceProxy> Producer;
   QList<QSharedPointer<Operator> > Operators;
   vtkSmartPointer<vtkSMProxy> ColorMap;
+  bool UsePercentileColorMapRange;
+  double ColorMapPercentiles[2];
+
+  // The last change to the data: the versions before and after it, and the
+  // extent of the voxels it changed if it is known.
+  unsigned long PreviousVersion;
+  unsigned long Version;
+  bool HasModifiedExtent;
+  int ModifiedExtent[6];
+
+  DSInternals() : UsePercentileColorMapRange(false), PreviousVersion(0),
+    Version(0), HasModifiedExtent(false)
+    {
+    this->ColorMapPercentiles[0] = 0.1;
+    this->ColorMapPercentiles[1] = 99.9;
+    }
 };
 
 //-----------------------------------------------------------------------------
@@ -91,6 +110,11 @@ DataSource::DataSource(vtkSMSourceProxy* dataSource, QObject* parentObject)
   // every time the data changes, we should update the color map.
   this->connect(this, SIGNAL(dataChanged()), SLOT(updateColorMap()));
 
+  // percentile ranges come from the histogram, which arrives later.
+  this->connect(&HistogramScheduler::instance(),
+                SIGNAL(histogramReady(DataSource*, vtkTable*)),
+                SLOT(histogramReady(DataSource*)));
+
   this->resetData();
 }
 
@@ -117,6 +141,12 @@ bool DataSource::serialize(pugi::xml_node& ns) const
 {
   pugi::xml_node node = ns.append_child("ColorMap");
   tomviz::serialize(this->colorMap(), node);
+  node.append_attribute("use_percentile_range").set_value(
+    this->Internals->UsePercentileColorMapRange? 1 : 0);
+  node.append_attribute("lower_percentile").set_value(
+    this->Internals->ColorMapPercentiles[0]);
+  node.append_attribute("upper_percentile").set_value(
+    this->Internals->ColorMapPercentiles[1]);
 
   node = ns.append_child("OpacityMap");
   tomviz::serialize(this->opacityMap(), node);
@@ -127,6 +157,8 @@ bool DataSource::serialize(pugi::xml_node& ns) const
   foreach (QSharedPointer<Operator> op, this->Internals->Operators)
     {
     pugi::xml_node node = ns.append_child("Operator");
+    node.append_attribute("type").set_value(
+      OperatorFactory::operatorType(op.data()));
     if (!op->serialize(node))
       {
       qWarning("failed to serialize Operator. Skipping it.");
@@ -139,8 +171,15 @@ bool DataSource::serialize(pugi::xml_node& ns) const
 //-----------------------------------------------------------------------------
 bool DataSource::deserialize(const pugi::xml_node& ns)
 {
-  tomviz::deserialize(this->colorMap(), ns.child("ColorMap"));
+  pugi::xml_node cmapNode = ns.child("ColorMap");
+  tomviz::deserialize(this->colorMap(), cmapNode);
   tomviz::deserialize(this->opacityMap(), ns.child("OpacityMap"));
+  this->Internals->UsePercentileColorMapRange =
+    cmapNode.attribute("use_percentile_range").as_int(0) == 1;
+  this->Internals->ColorMapPercentiles[0] =
+    cmapNode.attribute("lower_percentile").as_double(0.1);
+  this->Internals->ColorMapPercentiles[1] =
+    cmapNode.attribute("upper_percentile").as_double(99.9);
   vtkSMPropertyHelper(this->colorMap(),
                       "ScalarOpacityFunction").Set(this->opacityMap());
   this->colorMap()->UpdateVTKObjects();
@@ -156,7 +195,14 @@ bool DataSource::deserialize(const pugi::xml_node& ns)
 
   for (pugi::xml_node node=ns.child("Operator"); node; node = node.next_sibling("Operator"))
     {
-    QSharedPointer<Operator> op(new OperatorPython());
+    // State files written before native operators existed have no type.
+    const char* type = node.attribute("type").as_string("Python");
+    QSharedPointer<Operator> op(OperatorFactory::createOperator(type));
+    if (!op)
+      {
+      qWarning("Unknown Operator type '%s'. Skipping it.", type);
+      continue;
+      }
     if (op->deserialize(node))
       {
       this->addOperator(op);
@@ -247,13 +293,68 @@ void DataSource::operate(Operator* op)
   Q_ASSERT(tp);
   if (op->transform(tp->GetOutputDataObject(0)))
     {
-    this->dataModified();
+    // Operators that change only part of the data say so, so that derived
+    // data such as histograms is only updated there.
+    int extent[6];
+    if (op->modifiedExtent(extent))
+      {
+      this->regionModified(extent);
+      }
+    else
+      {
+      this->dataModified();
+      }
+    return;
     }
 
   emit this->dataChanged();
 }
 
 void DataSource::dataModified()
+{
+  this->updateProducer();
+  this->recordModification(NULL);
+  emit this->dataChanged();
+}
+
+//-----------------------------------------------------------------------------
+void DataSource::regionModified(const int extent[6])
+{
+  this->updateProducer();
+  this->recordModification(extent);
+  emit this->dataChanged();
+}
+
+//-----------------------------------------------------------------------------
+bool DataSource::lastModification(unsigned long& previousVersion,
+                                  int extent[6]) const
+{
+  // Only valid while the data is still at the version the change produced.
+  if (!this->Internals->HasModifiedExtent ||
+      this->Internals->Version != this->dataVersion())
+    {
+    return false;
+    }
+  previousVersion = this->Internals->PreviousVersion;
+  std::copy(this->Internals->ModifiedExtent,
+            this->Internals->ModifiedExtent + 6, extent);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void DataSource::recordModification(const int* extent)
+{
+  this->Internals->PreviousVersion = this->Internals->Version;
+  this->Internals->Version = this->dataVersion();
+  this->Internals->HasModifiedExtent = extent != NULL;
+  if (extent)
+    {
+    std::copy(extent, extent + 6, this->Internals->ModifiedExtent);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void DataSource::updateProducer()
 {
   vtkTrivialProducer* tp = vtkTrivialProducer::SafeDownCast(
     this->Internals->Producer->GetClientSideObject());
@@ -274,8 +375,6 @@ void DataSource::dataModified()
   filter->UpdateVTKObjects();
   filter->UpdatePipeline();
   filter->Delete();
-
-  emit this->dataChanged();
 }
 
 //-----------------------------------------------------------------------------
@@ -310,6 +409,7 @@ void DataSource::resetData()
   Q_ASSERT(tp);
   tp->SetOutput(clone);
   clone->FastDelete();
+  this->recordModification(NULL);
   emit this->dataChanged();
 }
 
@@ -340,13 +440,72 @@ vtkSMProxy* DataSource::opacityMap() const
   vtkSMPropertyHelper(this->Internals->ColorMap, "ScalarOpacityFunction").GetAsProxy() : NULL;
 }
 
+//-----------------------------------------------------------------------------
+unsigned long DataSource::dataVersion() const
+{
+  vtkTrivialProducer* tp = vtkTrivialProducer::SafeDownCast(
+    this->Internals->Producer->GetClientSideObject());
+  vtkDataObject* data = tp ? tp->GetOutputDataObject(0) : NULL;
+  return data ? data->GetMTime() : 0;
+}
+
+//-----------------------------------------------------------------------------
+void DataSource::setUsePercentileColorMapRange(bool val)
+{
+  if (this->Internals->UsePercentileColorMapRange != val)
+    {
+    this->Internals->UsePercentileColorMapRange = val;
+    this->updateColorMap();
+    emit this->colorMapRescaled();
+    }
+}
+
+//-----------------------------------------------------------------------------
+bool DataSource::usePercentileColorMapRange() const
+{
+  return this->Internals->UsePercentileColorMapRange;
+}
+
+//-----------------------------------------------------------------------------
+void DataSource::setColorMapPercentiles(double lower, double upper)
+{
+  Q_ASSERT(lower >= 0.0 && lower < upper && upper <= 100.0);
+  this->Internals->ColorMapPercentiles[0] = lower;
+  this->Internals->ColorMapPercentiles[1] = upper;
+  if (this->Internals->UsePercentileColorMapRange)
+    {
+    this->updateColorMap();
+    emit this->colorMapRescaled();
+    }
+}
+
+//-----------------------------------------------------------------------------
+const double* DataSource::colorMapPercentiles() const
+{
+  return this->Internals->ColorMapPercentiles;
+}
+
 //-----------------------------------------------------------------------------
 void DataSource::updateColorMap()
 {
   // rescale the color/opacity maps for the data source.
-  tomviz::rescaleColorMap(this->colorMap(), this);
+  tomviz::rescaleColorMap(this->colorMap(), this,
+    this->Internals->UsePercentileColorMapRange?
+    this->Internals->ColorMapPercentiles : NULL);
+}
+
+//-----------------------------------------------------------------------------
+void DataSource::histogramReady(DataSource* source)
+{
+  if (source == this && this->Internals->UsePercentileColorMapRange &&
+      tomviz::rescaleColorMap(this->colorMap(), this,
+                              this->Internals->ColorMapPercentiles))
+    {
+    emit this->colorMapRescaled();
+    }
 }
 
+//-----------------------------------------------------------------------------
 void DataSource::crop(int bounds[6])
 {
   vtkTrivialProducer* tp = vtkTrivialProducer::SafeDownCast(
@@ -356,13 +515,33 @@ void DataSource::crop(int bounds[6])
   vtkDataObject* data = tp->GetOutputDataObject(0);
   Q_ASSERT(data);
 
+  vtkImageData* image = vtkImageData::SafeDownCast(data);
+  int extent[6] = { 0, -1, 0, -1, 0, -1 };
+  if (image)
+    {
+    image->GetExtent(extent);
+    }
+
   vtkNew<vtkExtractVOI> extractor;
   extractor->SetVOI(bounds);
   extractor->SetInputDataObject(data);
   extractor->Update();
   extractor->UpdateWholeExtent();
   data->DeepCopy(extractor->GetOutputDataObject(0));
-  this->dataModified();
+
+  // The voxels kept are unchanged, and keep their indices, so the histograms
+  // need only be updated at the new boundaries.
+  bool indicesKept = image != NULL;
+  for (int i = 0; i < 3 && indicesKept; ++i)
+    {
+    const int* cropped = image->GetExtent();
+    indicesKept =
+      cropped[2 * i] == std::max(bounds[2 * i], extent[2 * i]) &&
+      cropped[2 * i + 1] == std::min(bounds[2 * i + 1], extent[2 * i + 1]);
+    }
+  this->updateProducer();
+  const int unchanged[6] = { 0, -1, 0, -1, 0, -1 };
+  this->recordModification(indicesKept ? unchanged : NULL);
   emit this->dataChanged();
 }
 
@@ -74,6 +74,33 @@ public:
   vtkSMProxy* colorMap() const;
   vtkSMProxy* opacityMap() const;
 
+  /// When enabled, the color map is rescaled to the colorMapPercentiles() of
+  /// the data rather than its full range, so a few outliers don't stretch it.
+  /// The percentiles are estimated from the cached histogram of the data,
+  /// without another pass over it. Off by default.
+  void setUsePercentileColorMapRange(bool);
+  bool usePercentileColorMapRange() const;
+
+  /// The lower and upper percentiles (0 to 100) the color map is rescaled to
+  /// when usePercentileColorMapRange() is on, 0.1 and 99.9 by default.
+  void setColorMapPercentiles(double lower, double upper);
+  const double* colorMapPercentiles() const;
+
+  /// Returns a version number for the data, which increases whenever the data
+  /// changes. It is the modification time of the data object.
+  unsigned long dataVersion() const;
+
+  /// Describes the last change to the data, so that data derived from it can
+  /// be updated incrementally: previousVersion is the dataVersion() before
+  /// the change, and extent the structured extent of the voxels it changed
+  /// (empty if none did, e.g. after a crop). Returns false if the change is
+  /// unknown, i.e. all of the data may have changed.
+  bool lastModification(unsigned long& previousVersion, int extent[6]) const;
+
+  /// Notify that only the voxels in the given extent of the data were
+  /// modified in place. Otherwise like dataModified().
+  void regionModified(const int extent[6]);
+
   /// Crop the data to the given volume
   void crop(int bounds[6]);
 
@@ -82,6 +109,10 @@ signals:
   /// new/updated data.
   void dataChanged();
 
+  /// This signal is fired when the color map is rescaled other than in response
+  /// to dataChanged(), e.g. once the percentiles of the data are known.
+  void colorMapRescaled();
+
   /// This signal is fired every time a new operator is added to this
   /// DataSource.
   void operatorAdded(Operator*);
@@ -93,6 +124,8 @@ public slots:
 protected:
   void operate(Operator* op);
   void resetData();
+  void updateProducer();
+  void recordModification(const int* extent);
 
 protected slots:
   void operatorTransformModified();
@@ -100,6 +133,9 @@ protected slots:
   /// update the color map range.
   void updateColorMap();
 
+  /// re-apply the percentile range once the data's histogram is computed.
+  void histogramReady(DataSource* source);
+
 private:
   Q_DISABLE_COPY(DataSource)
 
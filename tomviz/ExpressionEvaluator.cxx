@@ -0,0 +1,714 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "ExpressionEvaluator.h"
+
+#include <vtkDataArray.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace
+{
+
+typedef tomviz::ExpressionEvaluator::Instruction Instruction;
+typedef tomviz::ExpressionEvaluator::OpCode OpCode;
+
+// Number of voxels evaluated by each instruction at a time. Small enough for
+// the stack of blocks to stay in cache, large enough to amortize dispatch.
+const vtkIdType blockSize = 1024;
+
+struct FunctionInfo
+{
+  const char* Name;
+  OpCode Op;
+  int Arguments;
+};
+
+const FunctionInfo functions[] = {
+  { "sqrt", tomviz::ExpressionEvaluator::Sqrt, 1 },
+  { "abs", tomviz::ExpressionEvaluator::Abs, 1 },
+  { "exp", tomviz::ExpressionEvaluator::Exp, 1 },
+  { "log", tomviz::ExpressionEvaluator::Log, 1 },
+  { "log10", tomviz::ExpressionEvaluator::Log10, 1 },
+  { "sin", tomviz::ExpressionEvaluator::Sin, 1 },
+  { "cos", tomviz::ExpressionEvaluator::Cos, 1 },
+  { "tan", tomviz::ExpressionEvaluator::Tan, 1 },
+  { "asin", tomviz::ExpressionEvaluator::Asin, 1 },
+  { "acos", tomviz::ExpressionEvaluator::Acos, 1 },
+  { "atan", tomviz::ExpressionEvaluator::Atan, 1 },
+  { "floor", tomviz::ExpressionEvaluator::Floor, 1 },
+  { "ceil", tomviz::ExpressionEvaluator::Ceil, 1 },
+  { "atan2", tomviz::ExpressionEvaluator::Atan2, 2 },
+  { "pow", tomviz::ExpressionEvaluator::Power, 2 },
+  { "min", tomviz::ExpressionEvaluator::Min, 2 },
+  { "max", tomviz::ExpressionEvaluator::Max, 2 },
+  { NULL, tomviz::ExpressionEvaluator::Add, 0 }
+};
+
+//-----------------------------------------------------------------------------
+int numberOfArguments(OpCode op)
+{
+  switch (op)
+    {
+    case tomviz::ExpressionEvaluator::PushVariable:
+    case tomviz::ExpressionEvaluator::PushConstant:
+      return 0;
+    case tomviz::ExpressionEvaluator::Add:
+    case tomviz::ExpressionEvaluator::Subtract:
+    case tomviz::ExpressionEvaluator::Multiply:
+    case tomviz::ExpressionEvaluator::Divide:
+    case tomviz::ExpressionEvaluator::Power:
+    case tomviz::ExpressionEvaluator::Atan2:
+    case tomviz::ExpressionEvaluator::Min:
+    case tomviz::ExpressionEvaluator::Max:
+      return 2;
+    default:
+      return 1;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Scalar evaluation, used for constant folding.
+double apply(OpCode op, double a, double b)
+{
+  switch (op)
+    {
+    case tomviz::ExpressionEvaluator::Negate: return -a;
+    case tomviz::ExpressionEvaluator::Add: return a + b;
+    case tomviz::ExpressionEvaluator::Subtract: return a - b;
+    case tomviz::ExpressionEvaluator::Multiply: return a * b;
+    case tomviz::ExpressionEvaluator::Divide: return a / b;
+    case tomviz::ExpressionEvaluator::Power: return pow(a, b);
+    case tomviz::ExpressionEvaluator::Sqrt: return sqrt(a);
+    case tomviz::ExpressionEvaluator::Abs: return fabs(a);
+    case tomviz::ExpressionEvaluator::Exp: return exp(a);
+    case tomviz::ExpressionEvaluator::Log: return log(a);
+    case tomviz::ExpressionEvaluator::Log10: return log10(a);
+    case tomviz::ExpressionEvaluator::Sin: return sin(a);
+    case tomviz::ExpressionEvaluator::Cos: return cos(a);
+    case tomviz::ExpressionEvaluator::Tan: return tan(a);
+    case tomviz::ExpressionEvaluator::Asin: return asin(a);
+    case tomviz::ExpressionEvaluator::Acos: return acos(a);
+    case tomviz::ExpressionEvaluator::Atan: return atan(a);
+    case tomviz::ExpressionEvaluator::Floor: return floor(a);
+    case tomviz::ExpressionEvaluator::Ceil: return ceil(a);
+    case tomviz::ExpressionEvaluator::Atan2: return atan2(a, b);
+    case tomviz::ExpressionEvaluator::Min: return std::min(a, b);
+    case tomviz::ExpressionEvaluator::Max: return std::max(a, b);
+    default: return 0.0;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Block kernels, one loop per instruction so that each vectorizes.
+template<typename Function>
+void applyUnary(double* a, vtkIdType n, Function f)
+{
+  for (vtkIdType i = 0; i < n; ++i)
+    {
+    a[i] = f(a[i]);
+    }
+}
+
+double negate(double a) { return -a; }
+double absolute(double a) { return fabs(a); }
+double minimum(double a, double b) { return a < b ? a : b; }
+double maximum(double a, double b) { return a > b ? a : b; }
+
+void applyBlock(OpCode op, double* a, const double* b, vtkIdType n)
+{
+  switch (op)
+    {
+    case tomviz::ExpressionEvaluator::Negate:
+      applyUnary(a, n, negate);
+      break;
+    case tomviz::ExpressionEvaluator::Add:
+      for (vtkIdType i = 0; i < n; ++i) { a[i] += b[i]; }
+      break;
+    case tomviz::ExpressionEvaluator::Subtract:
+      for (vtkIdType i = 0; i < n; ++i) { a[i] -= b[i]; }
+      break;
+    case tomviz::ExpressionEvaluator::Multiply:
+      for (vtkIdType i = 0; i < n; ++i) { a[i] *= b[i]; }
+      break;
+    case tomviz::ExpressionEvaluator::Divide:
+      for (vtkIdType i = 0; i < n; ++i) { a[i] /= b[i]; }
+      break;
+    case tomviz::ExpressionEvaluator::Min:
+      for (vtkIdType i = 0; i < n; ++i) { a[i] = minimum(a[i], b[i]); }
+      break;
+    case tomviz::ExpressionEvaluator::Max:
+      for (vtkIdType i = 0; i < n; ++i) { a[i] = maximum(a[i], b[i]); }
+      break;
+    case tomviz::ExpressionEvaluator::Power:
+      for (vtkIdType i = 0; i < n; ++i) { a[i] = pow(a[i], b[i]); }
+      break;
+    case tomviz::ExpressionEvaluator::Atan2:
+      for (vtkIdType i = 0; i < n; ++i) { a[i] = atan2(a[i], b[i]); }
+      break;
+    case tomviz::ExpressionEvaluator::Sqrt:
+      for (vtkIdType i = 0; i < n; ++i) { a[i] = sqrt(a[i]); }
+      break;
+    case tomviz::ExpressionEvaluator::Abs:
+      applyUnary(a, n, absolute);
+      break;
+    default:
+      // Transcendental functions, dominated by the call itself.
+      for (vtkIdType i = 0; i < n; ++i) { a[i] = apply(op, a[i], 0.0); }
+      break;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Conversion of array blocks to and from double.
+typedef void (*LoadFunction)(const void* data, int numComps, vtkIdType begin,
+                             vtkIdType n, double* out);
+typedef void (*StoreFunction)(const double* in, void* data, int numComps,
+                              vtkIdType begin, vtkIdType n);
+
+template<typename T>
+void loadBlock(const void* data, int numComps, vtkIdType begin, vtkIdType n,
+               double* out)
+{
+  const T* src = static_cast<const T*>(data) + begin * numComps;
+  for (vtkIdType i = 0; i < n; ++i)
+    {
+    out[i] = static_cast<double>(src[i * numComps]);
+    }
+}
+
+template<typename T>
+void storeBlock(const double* in, void* data, int numComps, vtkIdType begin,
+                vtkIdType n)
+{
+  T* dst = static_cast<T*>(data) + begin * numComps;
+  for (vtkIdType i = 0; i < n; ++i)
+    {
+    dst[i * numComps] = static_cast<T>(in[i]);
+    }
+}
+
+template<typename T>
+LoadFunction loadFunction(T*)
+{
+  return &loadBlock<T>;
+}
+
+template<typename T>
+StoreFunction storeFunction(T*)
+{
+  return &storeBlock<T>;
+}
+
+struct InputArray
+{
+  LoadFunction Load;
+  const void* Data;
+  int NumberOfComponents;
+};
+
+//-----------------------------------------------------------------------------
+class EvaluateFunctor
+{
+public:
+  EvaluateFunctor(const std::vector<Instruction>& program, int depth,
+                  const std::vector<InputArray>& inputs, StoreFunction store,
+                  void* output, int outputComps, vtkIdType size)
+    : Program(program), Depth(depth), Inputs(inputs), Store(store),
+      Output(output), OutputComps(outputComps), Size(size)
+  {
+  }
+
+  void operator()(vtkIdType beginBlock, vtkIdType endBlock)
+  {
+    std::vector<double>& stack = this->Stack.Local();
+    stack.resize(this->Depth * blockSize);
+    for (vtkIdType block = beginBlock; block < endBlock; ++block)
+      {
+      const vtkIdType begin = block * blockSize;
+      const vtkIdType n = std::min(blockSize, this->Size - begin);
+      double* top = &stack[0] - blockSize;
+      for (size_t pc = 0; pc < this->Program.size(); ++pc)
+        {
+        const Instruction& instruction = this->Program[pc];
+        switch (instruction.Op)
+          {
+          case tomviz::ExpressionEvaluator::PushVariable:
+            {
+            const InputArray& input = this->Inputs[instruction.Variable];
+            top += blockSize;
+            input.Load(input.Data, input.NumberOfComponents, begin, n, top);
+            }
+            break;
+          case tomviz::ExpressionEvaluator::PushConstant:
+            top += blockSize;
+            std::fill(top, top + n, instruction.Constant);
+            break;
+          default:
+            if (numberOfArguments(instruction.Op) == 2)
+              {
+              top -= blockSize;
+              applyBlock(instruction.Op, top, top + blockSize, n);
+              }
+            else
+              {
+              applyBlock(instruction.Op, top, NULL, n);
+              }
+            break;
+          }
+        }
+      this->Store(top, this->Output, this->OutputComps, begin, n);
+      }
+  }
+
+private:
+  const std::vector<Instruction>& Program;
+  int Depth;
+  const std::vector<InputArray>& Inputs;
+  StoreFunction Store;
+  void* Output;
+  int OutputComps;
+  vtkIdType Size;
+  vtkSMPThreadLocal<std::vector<double> > Stack;
+};
+
+}
+
+namespace tomviz
+{
+
+// Recursive descent parser emitting postfix bytecode. Grammar, lowest
+// precedence first:
+//   expression := term (('+' | '-') term)*
+//   term       := unary (('*' | '/') unary)*
+//   unary      := ('-' | '+') unary | power
+//   power      := primary ('^' unary)?
+//   primary    := number | name | name '(' arguments ')' | '(' expression ')'
+class ExpressionEvaluator::Parser
+{
+public:
+  Parser(const std::string& text, const QStringList& variables,
+         std::vector<Instruction>& program)
+    : Text(text), Position(0), Variables(variables), Program(program)
+  {
+  }
+
+  bool parse(QString& error)
+  {
+    if (!this->expression())
+      {
+      error = this->Error;
+      return false;
+      }
+    this->skipSpace();
+    if (this->Position != this->Text.size())
+      {
+      error = QString("Unexpected '%1' at position %2")
+        .arg(this->Text[this->Position]).arg(this->Position + 1);
+      return false;
+      }
+    return true;
+  }
+
+private:
+  void skipSpace()
+  {
+    while (this->Position < this->Text.size() &&
+           isspace(static_cast<unsigned char>(this->Text[this->Position])))
+      {
+      ++this->Position;
+      }
+  }
+
+  // Consume c if it is the next non-space character.
+  bool accept(char c)
+  {
+    this->skipSpace();
+    if (this->Position < this->Text.size() && this->Text[this->Position] == c)
+      {
+      ++this->Position;
+      return true;
+      }
+    return false;
+  }
+
+  bool fail(const QString& message)
+  {
+    if (this->Error.isEmpty())
+      {
+      this->Error = message;
+      }
+    return false;
+  }
+
+  // Append an instruction, folding it if all of its arguments are constants.
+  // In postfix order those arguments are the last instructions emitted.
+  void appendInstruction(OpCode op, int variable = -1, double constant = 0.0)
+  {
+    const int arguments = numberOfArguments(op);
+    const size_t size = this->Program.size();
+    bool foldable = arguments > 0 && size >= static_cast<size_t>(arguments);
+    for (int i = 1; foldable && i <= arguments; ++i)
+      {
+      foldable = this->Program[size - i].Op == PushConstant;
+      }
+    if (foldable)
+      {
+      const double a = this->Program[size - arguments].Constant;
+      const double b = arguments == 2 ? this->Program[size - 1].Constant : 0.0;
+      this->Program.resize(size - arguments);
+      constant = apply(op, a, b);
+      op = PushConstant;
+      }
+    Instruction instruction;
+    instruction.Op = op;
+    instruction.Variable = variable;
+    instruction.Constant = constant;
+    this->Program.push_back(instruction);
+  }
+
+  bool expression()
+  {
+    if (!this->term())
+      {
+      return false;
+      }
+    for (;;)
+      {
+      if (this->accept('+'))
+        {
+        if (!this->term())
+          {
+          return false;
+          }
+        this->appendInstruction(Add);
+        }
+      else if (this->accept('-'))
+        {
+        if (!this->term())
+          {
+          return false;
+          }
+        this->appendInstruction(Subtract);
+        }
+      else
+        {
+        return true;
+        }
+      }
+  }
+
+  bool term()
+  {
+    if (!this->unary())
+      {
+      return false;
+      }
+    for (;;)
+      {
+      if (this->accept('*'))
+        {
+        if (!this->unary())
+          {
+          return false;
+          }
+        this->appendInstruction(Multiply);
+        }
+      else if (this->accept('/'))
+        {
+        if (!this->unary())
+          {
+          return false;
+          }
+        this->appendInstruction(Divide);
+        }
+      else
+        {
+        return true;
+        }
+      }
+  }
+
+  bool unary()
+  {
+    if (this->accept('-'))
+      {
+      if (!this->unary())
+        {
+        return false;
+        }
+      this->appendInstruction(Negate);
+      return true;
+      }
+    if (this->accept('+'))
+      {
+      return this->unary();
+      }
+    return this->power();
+  }
+
+  bool power()
+  {
+    if (!this->primary())
+      {
+      return false;
+      }
+    if (this->accept('^'))
+      {
+      // Right associative, and binds tighter than a unary minus on its left.
+      if (!this->unary())
+        {
+        return false;
+        }
+      this->appendInstruction(Power);
+      }
+    return true;
+  }
+
+  bool primary()
+  {
+    this->skipSpace();
+    if (this->Position >= this->Text.size())
+      {
+      return this->fail("Unexpected end of expression");
+      }
+    const char c = this->Text[this->Position];
+    if (c == '(')
+      {
+      ++this->Position;
+      if (!this->expression())
+        {
+        return false;
+        }
+      return this->accept(')') ? true :
+        this->fail(QString("Expected ')' at position %1")
+                   .arg(this->Position + 1));
+      }
+    if (isdigit(static_cast<unsigned char>(c)) || c == '.')
+      {
+      const char* start = this->Text.c_str() + this->Position;
+      char* end = NULL;
+      const double value = strtod(start, &end);
+      if (end == start)
+        {
+        return this->fail(QString("Invalid number at position %1")
+                          .arg(this->Position + 1));
+        }
+      this->Position += end - start;
+      this->appendInstruction(PushConstant, -1, value);
+      return true;
+      }
+    if (isalpha(static_cast<unsigned char>(c)) || c == '_')
+      {
+      const size_t start = this->Position;
+      while (this->Position < this->Text.size() &&
+             (isalnum(static_cast<unsigned char>(this->Text[this->Position])) ||
+              this->Text[this->Position] == '_'))
+        {
+        ++this->Position;
+        }
+      const std::string name = this->Text.substr(start, this->Position - start);
+      if (this->accept('('))
+        {
+        return this->function(name);
+        }
+      const int variable = this->Variables.indexOf(QString(name.c_str()));
+      if (variable >= 0)
+        {
+        this->appendInstruction(PushVariable, variable);
+        }
+      else if (name == "pi")
+        {
+        this->appendInstruction(PushConstant, -1, 3.14159265358979323846);
+        }
+      else if (name == "e")
+        {
+        this->appendInstruction(PushConstant, -1, 2.71828182845904523536);
+        }
+      else
+        {
+        return this->fail(QString("Unknown variable '%1'").arg(name.c_str()));
+        }
+      return true;
+      }
+    return this->fail(QString("Unexpected '%1' at position %2")
+                      .arg(c).arg(this->Position + 1));
+  }
+
+  // Parse the arguments of a function call, the '(' has been consumed.
+  bool function(const std::string& name)
+  {
+    const FunctionInfo* info = functions;
+    while (info->Name && name != info->Name)
+      {
+      ++info;
+      }
+    if (!info->Name)
+      {
+      return this->fail(QString("Unknown function '%1'").arg(name.c_str()));
+      }
+    for (int i = 0; i < info->Arguments; ++i)
+      {
+      if (i > 0 && !this->accept(','))
+        {
+        return this->fail(QString("'%1' expects %2 arguments")
+                          .arg(name.c_str()).arg(info->Arguments));
+        }
+      if (!this->expression())
+        {
+        return false;
+        }
+      }
+    if (!this->accept(')'))
+      {
+      return this->fail(QString("'%1' expects %2 argument(s)")
+                        .arg(name.c_str()).arg(info->Arguments));
+      }
+    this->appendInstruction(info->Op);
+    return true;
+  }
+
+  std::string Text;
+  size_t Position;
+  const QStringList& Variables;
+  std::vector<Instruction>& Program;
+  QString Error;
+};
+
+//-----------------------------------------------------------------------------
+ExpressionEvaluator::ExpressionEvaluator()
+  : StackDepth(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+ExpressionEvaluator::~ExpressionEvaluator()
+{
+}
+
+//-----------------------------------------------------------------------------
+bool ExpressionEvaluator::compile(const QString& expression,
+                                  const QStringList& variables)
+{
+  this->Program.clear();
+  this->StackDepth = 0;
+  this->Variables = variables;
+  this->Used.assign(variables.size(), false);
+  this->ErrorMessage.clear();
+
+  Parser parser(expression.toStdString(), this->Variables, this->Program);
+  if (!parser.parse(this->ErrorMessage))
+    {
+    this->Program.clear();
+    return false;
+    }
+
+  // The maximum depth of the stack of blocks.
+  int depth = 0;
+  for (size_t pc = 0; pc < this->Program.size(); ++pc)
+    {
+    const Instruction& instruction = this->Program[pc];
+    if (instruction.Op == PushVariable || instruction.Op == PushConstant)
+      {
+      this->StackDepth = std::max(this->StackDepth, ++depth);
+      if (instruction.Op == PushVariable)
+        {
+        this->Used[instruction.Variable] = true;
+        }
+      }
+    else
+      {
+      depth -= numberOfArguments(instruction.Op) - 1;
+      }
+    }
+  Q_ASSERT(depth == 1);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+QStringList ExpressionEvaluator::usedVariables() const
+{
+  QStringList used;
+  for (int i = 0; i < this->Variables.size(); ++i)
+    {
+    if (this->Used[i])
+      {
+      used.append(this->Variables[i]);
+      }
+    }
+  return used;
+}
+
+//-----------------------------------------------------------------------------
+bool ExpressionEvaluator::evaluate(const std::vector<vtkDataArray*>& inputs,
+                                   vtkDataArray* output) const
+{
+  if (this->Program.empty() || !output ||
+      inputs.size() != static_cast<size_t>(this->Variables.size()))
+    {
+    return false;
+    }
+  const vtkIdType size = output->GetNumberOfTuples();
+
+  std::vector<InputArray> arrays(inputs.size());
+  for (size_t i = 0; i < inputs.size(); ++i)
+    {
+    arrays[i].Load = NULL;
+    arrays[i].Data = NULL;
+    arrays[i].NumberOfComponents = 1;
+    if (!this->Used[i])
+      {
+      continue;
+      }
+    vtkDataArray* input = inputs[i];
+    if (!input || input->GetNumberOfTuples() != size)
+      {
+      return false;
+      }
+    switch (input->GetDataType())
+      {
+      vtkTemplateMacro(
+        arrays[i].Load = loadFunction(static_cast<VTK_TT*>(NULL)));
+      default:
+        return false;
+      }
+    arrays[i].Data = input->GetVoidPointer(0);
+    arrays[i].NumberOfComponents = input->GetNumberOfComponents();
+    }
+
+  StoreFunction store = NULL;
+  switch (output->GetDataType())
+    {
+    vtkTemplateMacro(store = storeFunction(static_cast<VTK_TT*>(NULL)));
+    default:
+      return false;
+    }
+
+  EvaluateFunctor functor(this->Program, this->StackDepth, arrays, store,
+                          output->GetVoidPointer(0),
+                          output->GetNumberOfComponents(), size);
+  vtkSMPTools::For(0, (size + blockSize - 1) / blockSize, functor);
+  output->Modified();
+  return true;
+}
+
+}
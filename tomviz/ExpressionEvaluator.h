@@ -0,0 +1,113 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizExpressionEvaluator_h
+#define tomvizExpressionEvaluator_h
+
+#include <QString>
+#include <QStringList>
+
+#include <vector>
+
+class vtkDataArray;
+
+namespace tomviz
+{
+
+/// ExpressionEvaluator compiles a voxelwise arithmetic expression, such as
+/// "sqrt(x) + 0.5 * abs(x - d1)", into a small bytecode program and evaluates
+/// it over data arrays. Evaluation proceeds in blocks of voxels: each
+/// instruction runs a tight loop over the block, so no full-size temporaries
+/// are created, and blocks are processed in parallel.
+///
+/// Supported are numbers, the constants pi and e, the variables given to
+/// compile(), the operators + - * / ^ (power) with the usual precedence and
+/// parentheses, and the functions sqrt, abs, exp, log, log10, sin, cos, tan,
+/// asin, acos, atan, floor, ceil, atan2(y, x), pow(x, y), min(a, b) and
+/// max(a, b).
+class ExpressionEvaluator
+{
+public:
+  ExpressionEvaluator();
+  ~ExpressionEvaluator();
+
+  /// Parse and compile expression, which may reference the given variable
+  /// names. Returns false, setting errorMessage(), if the expression is
+  /// invalid.
+  bool compile(const QString& expression, const QStringList& variables);
+
+  QString errorMessage() const { return this->ErrorMessage; }
+
+  /// The variables the compiled expression references.
+  QStringList usedVariables() const;
+
+  /// Evaluate the expression for every tuple, writing the first component of
+  /// output. inputs holds one array per variable given to compile(), in the
+  /// same order, using the first component of each. Arrays of unused
+  /// variables may be NULL, used ones must have as many tuples as output.
+  bool evaluate(const std::vector<vtkDataArray*>& inputs,
+                vtkDataArray* output) const;
+
+  enum OpCode
+    {
+    PushVariable,
+    PushConstant,
+    Negate,
+    Add,
+    Subtract,
+    Multiply,
+    Divide,
+    Power,
+    Sqrt,
+    Abs,
+    Exp,
+    Log,
+    Log10,
+    Sin,
+    Cos,
+    Tan,
+    Asin,
+    Acos,
+    Atan,
+    Floor,
+    Ceil,
+    Atan2,
+    Min,
+    Max
+    };
+
+  struct Instruction
+    {
+    OpCode Op;
+    int Variable;
+    double Constant;
+    };
+
+private:
+  ExpressionEvaluator(const ExpressionEvaluator&);
+  void operator=(const ExpressionEvaluator&);
+
+  class Parser;
+
+  std::vector<Instruction> Program;
+  int StackDepth;
+  QStringList Variables;
+  std::vector<bool> Used;
+  QString ErrorMessage;
+};
+
+}
+
+#endif
@@ -0,0 +1,297 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "ExpressionOperator.h"
+
+#include "DataSource.h"
+#include "ExpressionEvaluator.h"
+#include "ModuleManager.h"
+
+#include <vtkDataArray.h>
+#include <vtkDataObject.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkSMSourceProxy.h>
+#include <vtkSmartPointer.h>
+#include <vtkTrivialProducer.h>
+
+#include <QtDebug>
+
+#include <vector>
+
+namespace
+{
+
+// Name of the variable holding the scalars being transformed.
+const char* scalarVariable = "x";
+
+vtkImageData* imageData(tomviz::DataSource* source)
+{
+  vtkTrivialProducer* t = vtkTrivialProducer::SafeDownCast(
+    source->producer()->GetClientSideObject());
+  return vtkImageData::SafeDownCast(t->GetOutputDataObject(0));
+}
+
+QString sourceLabel(tomviz::DataSource* source)
+{
+  return QString(source->producer()->GetAnnotation("tomviz.Label"));
+}
+
+}
+
+namespace tomviz
+{
+
+//-----------------------------------------------------------------------------
+ExpressionOperator::ExpressionOperator(QObject* parentObject)
+  : Superclass(parentObject), Expression(scalarVariable)
+{
+}
+
+//-----------------------------------------------------------------------------
+ExpressionOperator::~ExpressionOperator()
+{
+}
+
+//-----------------------------------------------------------------------------
+QString ExpressionOperator::label() const
+{
+  return this->Label.isEmpty() ? this->Expression : this->Label;
+}
+
+//-----------------------------------------------------------------------------
+void ExpressionOperator::setLabel(const QString& txt)
+{
+  this->Label = txt;
+}
+
+//-----------------------------------------------------------------------------
+QIcon ExpressionOperator::icon() const
+{
+  return QIcon(":/pqWidgets/Icons/pqCalculator24.png");
+}
+
+//-----------------------------------------------------------------------------
+void ExpressionOperator::setExpression(const QString& expr)
+{
+  this->Expression = expr;
+  emit this->transformModified();
+}
+
+//-----------------------------------------------------------------------------
+void ExpressionOperator::setVariable(const QString& name, DataSource* source)
+{
+  this->UnresolvedSources.remove(name);
+  if (source)
+    {
+    this->Sources[name] = source;
+    }
+  else
+    {
+    this->Sources.remove(name);
+    }
+  emit this->transformModified();
+}
+
+//-----------------------------------------------------------------------------
+QStringList ExpressionOperator::variableNames() const
+{
+  QStringList names = this->Sources.keys();
+  foreach (const QString& name, this->UnresolvedSources.keys())
+    {
+    if (!names.contains(name))
+      {
+      names.append(name);
+      }
+    }
+  return names;
+}
+
+//-----------------------------------------------------------------------------
+QString ExpressionOperator::validate(const QString& expr,
+                                     const QStringList& variables,
+                                     QStringList* used)
+{
+  ExpressionEvaluator evaluator;
+  QStringList names(scalarVariable);
+  names.append(variables);
+  if (!evaluator.compile(expr, names))
+    {
+    return evaluator.errorMessage();
+    }
+  if (used)
+    {
+    *used = evaluator.usedVariables();
+    used->removeAll(scalarVariable);
+    }
+  return QString();
+}
+
+//-----------------------------------------------------------------------------
+DataSource* ExpressionOperator::variableSource(const QString& name)
+{
+  if (this->Sources.value(name))
+    {
+    return this->Sources.value(name);
+    }
+  if (this->UnresolvedSources.contains(name))
+    {
+    const QString labelText = this->UnresolvedSources.value(name);
+    foreach (DataSource* source, ModuleManager::instance().dataSources())
+      {
+      if (sourceLabel(source) == labelText)
+        {
+        this->Sources[name] = source;
+        this->UnresolvedSources.remove(name);
+        return source;
+        }
+      }
+    }
+  return NULL;
+}
+
+//-----------------------------------------------------------------------------
+bool ExpressionOperator::transform(vtkDataObject* data)
+{
+  vtkImageData* image = vtkImageData::SafeDownCast(data);
+  vtkDataArray* scalars = image ? image->GetPointData()->GetScalars() : NULL;
+  if (!scalars)
+    {
+    return false;
+    }
+
+  QStringList names(scalarVariable);
+  names.append(this->variableNames());
+  ExpressionEvaluator evaluator;
+  if (!evaluator.compile(this->Expression, names))
+    {
+    qWarning() << "Invalid expression:" << evaluator.errorMessage();
+    return false;
+    }
+
+  // Gather the arrays of the referenced variables.
+  std::vector<vtkDataArray*> inputs(names.size(), NULL);
+  inputs[0] = scalars;
+  const QStringList used = evaluator.usedVariables();
+  bool useDouble = false;
+  int dims[3];
+  image->GetDimensions(dims);
+  for (int i = 0; i < names.size(); ++i)
+    {
+    if (!used.contains(names[i]))
+      {
+      continue;
+      }
+    if (i > 0)
+      {
+      DataSource* source = this->variableSource(names[i]);
+      vtkImageData* other = source ? imageData(source) : NULL;
+      int otherDims[3] = { 0, 0, 0 };
+      if (other)
+        {
+        other->GetDimensions(otherDims);
+        }
+      if (!other || otherDims[0] != dims[0] || otherDims[1] != dims[1] ||
+          otherDims[2] != dims[2] || !other->GetPointData()->GetScalars())
+        {
+        qWarning() << "Expression variable" << names[i]
+                   << "does not refer to data of the same extent.";
+        return false;
+        }
+      inputs[i] = other->GetPointData()->GetScalars();
+      }
+    useDouble = useDouble || inputs[i]->GetDataType() == VTK_DOUBLE;
+    }
+
+  vtkSmartPointer<vtkDataArray> result;
+  result.TakeReference(vtkDataArray::CreateDataArray(
+    useDouble ? VTK_DOUBLE : VTK_FLOAT));
+  result->SetName(scalars->GetName());
+  result->SetNumberOfComponents(1);
+  result->SetNumberOfTuples(scalars->GetNumberOfTuples());
+  if (!evaluator.evaluate(inputs, result))
+    {
+    return false;
+    }
+  image->GetPointData()->SetScalars(result);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+Operator* ExpressionOperator::clone() const
+{
+  ExpressionOperator* newClone = new ExpressionOperator();
+  newClone->setLabel(this->Label);
+  newClone->setExpression(this->Expression);
+  for (QMap<QString, QPointer<DataSource> >::const_iterator it =
+       this->Sources.begin(); it != this->Sources.end(); ++it)
+    {
+    newClone->setVariable(it.key(), it.value());
+    }
+  newClone->UnresolvedSources = this->UnresolvedSources;
+  return newClone;
+}
+
+//-----------------------------------------------------------------------------
+bool ExpressionOperator::serialize(pugi::xml_node& ns) const
+{
+  ns.append_attribute("expression").set_value(
+    this->Expression.toLatin1().data());
+  if (!this->Label.isEmpty())
+    {
+    ns.append_attribute("label").set_value(this->Label.toLatin1().data());
+    }
+  for (QMap<QString, QPointer<DataSource> >::const_iterator it =
+       this->Sources.begin(); it != this->Sources.end(); ++it)
+    {
+    if (it.value())
+      {
+      pugi::xml_node node = ns.append_child("Variable");
+      node.append_attribute("name").set_value(it.key().toLatin1().data());
+      node.append_attribute("source_label").set_value(
+        sourceLabel(it.value()).toLatin1().data());
+      }
+    }
+  for (QMap<QString, QString>::const_iterator it =
+       this->UnresolvedSources.begin(); it != this->UnresolvedSources.end();
+       ++it)
+    {
+    pugi::xml_node node = ns.append_child("Variable");
+    node.append_attribute("name").set_value(it.key().toLatin1().data());
+    node.append_attribute("source_label").set_value(
+      it.value().toLatin1().data());
+    }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool ExpressionOperator::deserialize(const pugi::xml_node& ns)
+{
+  // Sources are restored by label when the expression is first evaluated, as
+  // the DataSources they refer to may not have been restored yet.
+  this->Sources.clear();
+  this->UnresolvedSources.clear();
+  for (pugi::xml_node node = ns.child("Variable"); node;
+       node = node.next_sibling("Variable"))
+    {
+    this->UnresolvedSources.insert(node.attribute("name").value(),
+                                   node.attribute("source_label").value());
+    }
+  this->Label = ns.attribute("label").value();
+  this->setExpression(ns.attribute("expression").value());
+  return true;
+}
+
+}
@@ -0,0 +1,90 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizExpressionOperator_h
+#define tomvizExpressionOperator_h
+
+#include "Operator.h"
+
+#include <QMap>
+#include <QPointer>
+#include <QStringList>
+
+namespace tomviz
+{
+class DataSource;
+
+/// Operator that replaces the scalars with a voxelwise arithmetic expression,
+/// evaluated natively by ExpressionEvaluator. The scalars of the data being
+/// transformed are the variable "x", other DataSources with the same extent
+/// may be bound to further variable names. The result is float, or double if
+/// any of the referenced arrays is double.
+class ExpressionOperator : public Operator
+{
+  Q_OBJECT
+  typedef Operator Superclass;
+
+public:
+  ExpressionOperator(QObject* parent=NULL);
+  virtual ~ExpressionOperator();
+
+  /// Returns the label if set, otherwise the expression.
+  virtual QString label() const;
+  void setLabel(const QString& label);
+
+  /// Returns an icon to use for this operator.
+  virtual QIcon icon() const;
+
+  /// Method to transform a dataset in-place.
+  virtual bool transform(vtkDataObject* data);
+
+  /// return a new clone.
+  virtual Operator* clone() const;
+
+  virtual bool serialize(pugi::xml_node& in) const;
+  virtual bool deserialize(const pugi::xml_node& ns);
+
+  void setExpression(const QString& expression);
+  const QString& expression() const { return this->Expression; }
+
+  /// Bind the variable name to the scalars of another DataSource, which must
+  /// have the same extent as the transformed data. A NULL source removes the
+  /// binding.
+  void setVariable(const QString& name, DataSource* source);
+  QStringList variableNames() const;
+
+  /// Check expression, using the variable "x" and the given names. Returns
+  /// an empty string if it is valid, otherwise the error message. When used
+  /// is not NULL it is set to the given names the expression references.
+  static QString validate(const QString& expression,
+                          const QStringList& variables,
+                          QStringList* used = NULL);
+
+private:
+  Q_DISABLE_COPY(ExpressionOperator)
+
+  // Returns the source bound to name, resolving bindings restored from a
+  // state file by the label of the source.
+  DataSource* variableSource(const QString& name);
+
+  QString Label;
+  QString Expression;
+  QMap<QString, QPointer<DataSource> > Sources;
+  QMap<QString, QString> UnresolvedSources;
+};
+
+}
+
+#endif
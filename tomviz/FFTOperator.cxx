@@ -0,0 +1,436 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "FFTOperator.h"
+
+#include "FFTService.h"
+
+#include <vtkDataArray.h>
+#include <vtkDataObject.h>
+#include <vtkFloatArray.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+
+// Copies the (sub)volume into the padded real layout used by the in-place
+// transform, converting to float. Only the first component is used.
+template<typename T>
+class FillFunctor
+{
+public:
+  FillFunctor(const T* in, int numComps, const int dims[3],
+              const int offset[3], const int subDims[3], float* buffer)
+    : In(in), NumComps(numComps), Buffer(buffer)
+  {
+    for (int i = 0; i < 3; ++i)
+      {
+      this->Dims[i] = dims[i];
+      this->Offset[i] = offset[i];
+      this->SubDims[i] = subDims[i];
+      }
+    this->RowFloats = 2 * (this->SubDims[0] / 2 + 1);
+  }
+
+  void operator()(vtkIdType begin, vtkIdType end)
+  {
+    for (vtkIdType r = begin; r < end; ++r)
+      {
+      const vtkIdType y = r % this->SubDims[1] + this->Offset[1];
+      const vtkIdType z = r / this->SubDims[1] + this->Offset[2];
+      const T* src = this->In + ((z * this->Dims[1] + y) * this->Dims[0] +
+                                 this->Offset[0]) * this->NumComps;
+      float* dst = this->Buffer + r * this->RowFloats;
+      for (vtkIdType x = 0; x < this->SubDims[0]; ++x)
+        {
+        dst[x] = static_cast<float>(src[x * this->NumComps]);
+        }
+      }
+  }
+
+private:
+  const T* In;
+  vtkIdType NumComps;
+  vtkIdType Dims[3];
+  vtkIdType Offset[3];
+  vtkIdType SubDims[3];
+  vtkIdType RowFloats;
+  float* Buffer;
+};
+
+template<typename T>
+void fillBuffer(const T* in, int numComps, const int dims[3],
+                const int offset[3], const int subDims[3], float* buffer)
+{
+  FillFunctor<T> functor(in, numComps, dims, offset, subDims, buffer);
+  vtkSMPTools::For(0, static_cast<vtkIdType>(subDims[1]) * subDims[2],
+                   functor);
+}
+
+// Maximum squared magnitude over the non-redundant half of the spectrum, the
+// other half holds the same magnitudes.
+class MaxNormFunctor
+{
+public:
+  MaxNormFunctor(const tomviz::FFTComplex* data) : Data(data), MaxNorm(0.0) {}
+
+  void Initialize()
+  {
+    this->LocalMax.Local() = 0.0;
+  }
+
+  void operator()(vtkIdType begin, vtkIdType end)
+  {
+    double& localMax = this->LocalMax.Local();
+    for (vtkIdType i = begin; i < end; ++i)
+      {
+      const double re = this->Data[i].real();
+      const double im = this->Data[i].imag();
+      localMax = std::max(localMax, re * re + im * im);
+      }
+  }
+
+  void Reduce()
+  {
+    this->MaxNorm = 0.0;
+    for (vtkSMPThreadLocal<double>::iterator it = this->LocalMax.begin();
+         it != this->LocalMax.end(); ++it)
+      {
+      this->MaxNorm = std::max(this->MaxNorm, *it);
+      }
+  }
+
+  double maxNorm() const { return this->MaxNorm; }
+
+private:
+  const tomviz::FFTComplex* Data;
+  vtkSMPThreadLocal<double> LocalMax;
+  double MaxNorm;
+};
+
+// Writes the full, centered output volume from the half spectrum in a single
+// pass: magnitude, log, normalization and fftshift are fused, and the missing
+// half is read from the Hermitian symmetric entry.
+class OutputFunctor
+{
+public:
+  OutputFunctor(const tomviz::FFTComplex* data, const int dims[3],
+                tomviz::FFTOperator::Mode mode, double maxNorm, float* out)
+    : Data(data), Mode(mode), Out(out)
+  {
+    for (int i = 0; i < 3; ++i)
+      {
+      this->Dims[i] = dims[i];
+      }
+    this->HalfX = dims[0] / 2 + 1;
+
+    // fftshift: output index i holds frequency (i + (n + 1) / 2) % n.
+    this->XFrequency.resize(dims[0]);
+    for (int x = 0; x < dims[0]; ++x)
+      {
+      this->XFrequency[x] = (x + (dims[0] + 1) / 2) % dims[0];
+      }
+
+    // The normalization makes the largest output value 1.
+    this->Scale = 1.0;
+    if (maxNorm > 0.0)
+      {
+      switch (this->Mode)
+        {
+        case tomviz::FFTOperator::LogMagnitude:
+          if (log(maxNorm) != 0.0)
+            {
+            this->Scale = 1.0 / log(maxNorm);
+            }
+          break;
+        case tomviz::FFTOperator::Magnitude:
+          this->Scale = 1.0 / sqrt(maxNorm);
+          break;
+        case tomviz::FFTOperator::PowerSpectrum:
+          this->Scale = 1.0 / maxNorm;
+          break;
+        }
+      }
+  }
+
+  void operator()(vtkIdType begin, vtkIdType end)
+  {
+    const vtkIdType nx = this->Dims[0];
+    const vtkIdType ny = this->Dims[1];
+    const vtkIdType nz = this->Dims[2];
+    for (vtkIdType z = begin; z < end; ++z)
+      {
+      const vtkIdType kz = (z + (nz + 1) / 2) % nz;
+      const vtkIdType mz = (nz - kz) % nz;
+      for (vtkIdType y = 0; y < ny; ++y)
+        {
+        const vtkIdType ky = (y + (ny + 1) / 2) % ny;
+        const vtkIdType my = (ny - ky) % ny;
+        const tomviz::FFTComplex* direct =
+          this->Data + (kz * ny + ky) * this->HalfX;
+        const tomviz::FFTComplex* mirror =
+          this->Data + (mz * ny + my) * this->HalfX;
+        float* out = this->Out + (z * ny + y) * nx;
+        for (vtkIdType x = 0; x < nx; ++x)
+          {
+          const int kx = this->XFrequency[x];
+          const tomviz::FFTComplex& value =
+            kx < this->HalfX ? direct[kx] : mirror[nx - kx];
+          out[x] = this->map(value);
+          }
+        }
+      }
+  }
+
+private:
+  float map(const tomviz::FFTComplex& value) const
+  {
+    const double re = value.real();
+    const double im = value.imag();
+    const double norm = re * re + im * im;
+    switch (this->Mode)
+      {
+      case tomviz::FFTOperator::LogMagnitude:
+        // log|X| / log(max|X|) == log|X|^2 / log(max|X|^2), zero magnitudes
+        // are clamped rather than producing -inf.
+        return static_cast<float>(log(std::max(norm, DBL_MIN)) * this->Scale);
+      case tomviz::FFTOperator::Magnitude:
+        return static_cast<float>(sqrt(norm) * this->Scale);
+      case tomviz::FFTOperator::PowerSpectrum:
+      default:
+        return static_cast<float>(norm * this->Scale);
+      }
+  }
+
+  const tomviz::FFTComplex* Data;
+  tomviz::FFTOperator::Mode Mode;
+  float* Out;
+  vtkIdType Dims[3];
+  vtkIdType HalfX;
+  std::vector<int> XFrequency;
+  double Scale;
+};
+
+const char* modeName(tomviz::FFTOperator::Mode mode)
+{
+  switch (mode)
+    {
+    case tomviz::FFTOperator::Magnitude:
+      return "Magnitude";
+    case tomviz::FFTOperator::PowerSpectrum:
+      return "PowerSpectrum";
+    case tomviz::FFTOperator::LogMagnitude:
+    default:
+      return "LogMagnitude";
+    }
+}
+
+}
+
+namespace tomviz
+{
+
+//-----------------------------------------------------------------------------
+FFTOperator::FFTOperator(QObject* parentObject)
+  : Superclass(parentObject), OutputMode(LogMagnitude), PreviewSize(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+FFTOperator::~FFTOperator()
+{
+}
+
+//-----------------------------------------------------------------------------
+QString FFTOperator::label() const
+{
+  QString text;
+  switch (this->OutputMode)
+    {
+    case Magnitude:
+      text = "FFT (Magnitude)";
+      break;
+    case PowerSpectrum:
+      text = "FFT (Power Spectrum)";
+      break;
+    case LogMagnitude:
+    default:
+      text = "FFT (ABS LOG)";
+      break;
+    }
+  if (this->PreviewSize > 0)
+    {
+    text += QString(" [%1 preview]").arg(this->PreviewSize);
+    }
+  return text;
+}
+
+//-----------------------------------------------------------------------------
+QIcon FFTOperator::icon() const
+{
+  return QIcon(":/pqWidgets/Icons/pqCalculator24.png");
+}
+
+//-----------------------------------------------------------------------------
+void FFTOperator::setMode(Mode newMode)
+{
+  this->OutputMode = newMode;
+  emit this->transformModified();
+}
+
+//-----------------------------------------------------------------------------
+void FFTOperator::setPreviewSize(int size)
+{
+  this->PreviewSize = std::max(0, size);
+  emit this->transformModified();
+}
+
+//-----------------------------------------------------------------------------
+bool FFTOperator::transform(vtkDataObject* data)
+{
+  return FFTOperator::computeFFT(vtkImageData::SafeDownCast(data),
+                                 this->OutputMode, this->PreviewSize);
+}
+
+//-----------------------------------------------------------------------------
+bool FFTOperator::computeFFT(vtkImageData* image, Mode mode, int previewSize)
+{
+  vtkDataArray* scalars = image ? image->GetPointData()->GetScalars() : NULL;
+  if (!scalars)
+    {
+    return false;
+    }
+
+  // We are assuming an image that begins at 0, 0, 0 in memory, the extent is
+  // only used for the dimensions.
+  int dims[3], subDims[3], offset[3];
+  image->GetDimensions(dims);
+  for (int i = 0; i < 3; ++i)
+    {
+    subDims[i] = dims[i];
+    if (previewSize > 0 && previewSize < dims[i])
+      {
+      subDims[i] = previewSize;
+      }
+    offset[i] = (dims[i] - subDims[i]) / 2;
+    }
+  if (subDims[0] < 1 || subDims[1] < 1 || subDims[2] < 1)
+    {
+    return false;
+    }
+
+  // Single precision buffer in the padded layout of the in-place transform,
+  // about half the size of the complex result of a full complex transform.
+  // Both the plan and the buffer are reused when the operator is re-run.
+  QSharedPointer<const FFTPlan3D> plan = FFTService::instance().plan(
+    subDims, FFTPlan3D::RealToComplex, FFTPlan1D::Forward);
+  FFTBuffer buffer(plan->bufferSize() * sizeof(float));
+  float* bufferData = static_cast<float*>(buffer.data());
+  if (!bufferData)
+    {
+    return false;
+    }
+  switch (scalars->GetDataType())
+    {
+    vtkTemplateMacro(
+      fillBuffer(static_cast<const VTK_TT*>(scalars->GetVoidPointer(0)),
+                 scalars->GetNumberOfComponents(), dims, offset, subDims,
+                 bufferData));
+    default:
+      return false;
+    }
+
+  plan->execute(bufferData);
+
+  const FFTComplex* spectrum = reinterpret_cast<FFTComplex*>(bufferData);
+  const vtkIdType halfSize =
+    static_cast<vtkIdType>(subDims[0] / 2 + 1) * subDims[1] * subDims[2];
+  MaxNormFunctor maxNorm(spectrum);
+  vtkSMPTools::For(0, halfSize, maxNorm);
+
+  vtkNew<vtkFloatArray> result;
+  result->SetName(scalars->GetName());
+  result->SetNumberOfComponents(1);
+  result->SetNumberOfTuples(
+    static_cast<vtkIdType>(subDims[0]) * subDims[1] * subDims[2]);
+  OutputFunctor output(spectrum, subDims, mode, maxNorm.maxNorm(),
+                       result->GetPointer(0));
+  vtkSMPTools::For(0, subDims[2], output);
+
+  if (subDims[0] != dims[0] || subDims[1] != dims[1] || subDims[2] != dims[2])
+    {
+    // The other point arrays no longer match the shrunken extent.
+    int extent[6];
+    image->GetExtent(extent);
+    for (int i = 0; i < 3; ++i)
+      {
+      extent[2 * i + 1] = extent[2 * i] + subDims[i] - 1;
+      }
+    image->GetPointData()->Initialize();
+    image->SetExtent(extent);
+    }
+  image->GetPointData()->SetScalars(result.GetPointer());
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+Operator* FFTOperator::clone() const
+{
+  FFTOperator* newClone = new FFTOperator();
+  newClone->setMode(this->OutputMode);
+  newClone->setPreviewSize(this->PreviewSize);
+  return newClone;
+}
+
+//-----------------------------------------------------------------------------
+bool FFTOperator::serialize(pugi::xml_node& ns) const
+{
+  ns.append_attribute("mode").set_value(modeName(this->OutputMode));
+  ns.append_attribute("preview_size").set_value(this->PreviewSize);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool FFTOperator::deserialize(const pugi::xml_node& ns)
+{
+  QString name = ns.attribute("mode").as_string("LogMagnitude");
+  Mode newMode = LogMagnitude;
+  if (name == modeName(Magnitude))
+    {
+    newMode = Magnitude;
+    }
+  else if (name == modeName(PowerSpectrum))
+    {
+    newMode = PowerSpectrum;
+    }
+  else if (name != modeName(LogMagnitude))
+    {
+    return false;
+    }
+  this->OutputMode = newMode;
+  this->setPreviewSize(ns.attribute("preview_size").as_int(0));
+  return true;
+}
+
+}
@@ -0,0 +1,85 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizFFTOperator_h
+#define tomvizFFTOperator_h
+
+#include "Operator.h"
+
+class vtkImageData;
+
+namespace tomviz
+{
+
+/// Operator that replaces the scalars with the centered (fftshift-ed) 3D
+/// Fourier transform magnitude of the volume, normalized so that the maximum
+/// value is 1. The transform is computed in single precision using an in-place
+/// real to complex FFT, and the magnitude, log, normalization and shift are
+/// fused into a single pass writing the float32 output. Optionally only a
+/// central subvolume is transformed, for quick previews of large volumes.
+class FFTOperator : public Operator
+{
+  Q_OBJECT
+  typedef Operator Superclass;
+
+public:
+  enum Mode
+    {
+    LogMagnitude,
+    Magnitude,
+    PowerSpectrum
+    };
+
+  FFTOperator(QObject* parent=NULL);
+  virtual ~FFTOperator();
+
+  virtual QString label() const;
+
+  /// Returns an icon to use for this operator.
+  virtual QIcon icon() const;
+
+  /// Method to transform a dataset in-place.
+  virtual bool transform(vtkDataObject* data);
+
+  /// return a new clone.
+  virtual Operator* clone() const;
+
+  virtual bool serialize(pugi::xml_node& in) const;
+  virtual bool deserialize(const pugi::xml_node& ns);
+
+  /// Quantity written to the output, log magnitude by default.
+  void setMode(Mode mode);
+  Mode mode() const { return this->OutputMode; }
+
+  /// When positive, only the central subvolume of at most this many voxels
+  /// along each axis is transformed. 0 (the default) transforms the whole
+  /// volume.
+  void setPreviewSize(int size);
+  int previewSize() const { return this->PreviewSize; }
+
+  /// Replace the scalars of image with the transform. When a preview size is
+  /// used the extent of image shrinks to that of the subvolume.
+  static bool computeFFT(vtkImageData* image, Mode mode, int previewSize);
+
+private:
+  Q_DISABLE_COPY(FFTOperator)
+
+  Mode OutputMode;
+  int PreviewSize;
+};
+
+}
+
+#endif
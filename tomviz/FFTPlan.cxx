@@ -0,0 +1,477 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "FFTPlan.h"
+
+#include "FFTService.h"
+
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPTools.h>
+#include <vtkType.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+
+const double pi = 3.14159265358979323846;
+
+bool isPowerOfTwo(int n)
+{
+  return n > 0 && (n & (n - 1)) == 0;
+}
+
+int nextPowerOfTwo(int n)
+{
+  int m = 1;
+  while (m < n)
+    {
+    m <<= 1;
+    }
+  return m;
+}
+
+// Per-thread scratch space taken from the FFTService pool, and returned to
+// it once the transform is done.
+class ThreadScratch
+{
+public:
+  ThreadScratch(size_t count)
+    : Count(std::max<size_t>(count, 1)), Buffers(NULL)
+  {
+  }
+
+  ~ThreadScratch()
+  {
+    for (vtkSMPThreadLocal<tomviz::FFTComplex*>::iterator it =
+         this->Buffers.begin(); it != this->Buffers.end(); ++it)
+      {
+      if (*it)
+        {
+        tomviz::FFTService::instance().releaseBuffer(*it);
+        }
+      }
+  }
+
+  tomviz::FFTComplex* local()
+  {
+    tomviz::FFTComplex*& buffer = this->Buffers.Local();
+    if (!buffer)
+      {
+      buffer = static_cast<tomviz::FFTComplex*>(
+        tomviz::FFTService::instance().acquireBuffer(
+          this->Count * sizeof(tomviz::FFTComplex)));
+      }
+    return buffer;
+  }
+
+private:
+  size_t Count;
+  vtkSMPThreadLocal<tomviz::FFTComplex*> Buffers;
+};
+
+// Real to complex FFT along x of each row in the padded real layout.
+class RowFunctor
+{
+public:
+  RowFunctor(float* buffer, const int dims[3],
+             const tomviz::FFTRealPlan1D& plan)
+    : Buffer(buffer), Plan(plan),
+      Scratch(plan.scratchSize() + (plan.length() + 1) / 2)
+  {
+    this->RowFloats = 2 * (dims[0] / 2 + 1);
+  }
+
+  void operator()(vtkIdType begin, vtkIdType end)
+  {
+    const int n = this->Plan.length();
+    tomviz::FFTComplex* scratch = this->Scratch.local();
+    // The row input is copied out first, as the complex output overlaps it.
+    float* row = reinterpret_cast<float*>(scratch + this->Plan.scratchSize());
+    for (vtkIdType r = begin; r < end; ++r)
+      {
+      float* data = this->Buffer + r * this->RowFloats;
+      memcpy(row, data, n * sizeof(float));
+      this->Plan.execute(row, reinterpret_cast<tomviz::FFTComplex*>(data),
+                         scratch);
+      }
+  }
+
+private:
+  float* Buffer;
+  vtkIdType RowFloats;
+  const tomviz::FFTRealPlan1D& Plan;
+  ThreadScratch Scratch;
+};
+
+// Strided lines are gathered this many at a time, the complex values in a
+// 64 byte cache line.
+const vtkIdType LinesPerGather = 64 / sizeof(tomviz::FFTComplex);
+
+// Complex FFT of strided lines. Lines are grouped: each index passed to the
+// functor selects a group of Count lines with consecutive starting offsets.
+// Strided lines are gathered LinesPerGather at a time, so that each step of
+// the gather reads a contiguous run of values, one from each line, rather
+// than a single value. Contiguous lines are transformed in place without a
+// gather.
+class LineFunctor
+{
+public:
+  LineFunctor(tomviz::FFTComplex* data, vtkIdType groupStride,
+              vtkIdType count, vtkIdType stride,
+              const tomviz::FFTPlan1D& plan)
+    : Data(data), GroupStride(groupStride), Count(count), Stride(stride),
+      Plan(plan), Scratch(plan.scratchSize() +
+                          (stride == 1 ? 0 : LinesPerGather * plan.length()))
+  {
+  }
+
+  void operator()(vtkIdType begin, vtkIdType end)
+  {
+    const int n = this->Plan.length();
+    tomviz::FFTComplex* scratch = this->Scratch.local();
+    tomviz::FFTComplex* lines = scratch + this->Plan.scratchSize();
+    for (vtkIdType g = begin; g < end; ++g)
+      {
+      tomviz::FFTComplex* group = this->Data + g * this->GroupStride;
+      if (this->Stride == 1)
+        {
+        for (vtkIdType l = 0; l < this->Count; ++l)
+          {
+          this->Plan.execute(group + l, scratch);
+          }
+        continue;
+        }
+      for (vtkIdType l = 0; l < this->Count; l += LinesPerGather)
+        {
+        tomviz::FFTComplex* start = group + l;
+        const vtkIdType batch = std::min(LinesPerGather, this->Count - l);
+        for (int i = 0; i < n; ++i)
+          {
+          const tomviz::FFTComplex* values = start + i * this->Stride;
+          for (vtkIdType b = 0; b < batch; ++b)
+            {
+            lines[b * n + i] = values[b];
+            }
+          }
+        for (vtkIdType b = 0; b < batch; ++b)
+          {
+          this->Plan.execute(lines + b * n, scratch);
+          }
+        for (int i = 0; i < n; ++i)
+          {
+          tomviz::FFTComplex* values = start + i * this->Stride;
+          for (vtkIdType b = 0; b < batch; ++b)
+            {
+            values[b] = lines[b * n + i];
+            }
+          }
+        }
+      }
+  }
+
+private:
+  tomviz::FFTComplex* Data;
+  vtkIdType GroupStride;
+  vtkIdType Count;
+  vtkIdType Stride;
+  const tomviz::FFTPlan1D& Plan;
+  ThreadScratch Scratch;
+};
+
+}
+
+namespace tomviz
+{
+
+//-----------------------------------------------------------------------------
+FFTPlan1D::FFTPlan1D(int length, Direction dir)
+  : N(length), Sign(dir), PowerOfTwo(isPowerOfTwo(length)), M(length)
+{
+  if (!this->PowerOfTwo)
+    {
+    // Bluestein: the convolution needs a power of two length >= 2N - 1.
+    this->M = nextPowerOfTwo(2 * this->N - 1);
+    }
+
+  // Bit reversal permutation and forward twiddles for the length M transform.
+  int bits = 0;
+  while ((1 << bits) < this->M)
+    {
+    ++bits;
+    }
+  this->BitReverse.resize(this->M);
+  for (int i = 0; i < this->M; ++i)
+    {
+    int r = 0;
+    for (int b = 0; b < bits; ++b)
+      {
+      r |= ((i >> b) & 1) << (bits - 1 - b);
+      }
+    this->BitReverse[i] = r;
+    }
+  const double twiddleSign =
+    this->PowerOfTwo ? static_cast<double>(this->Sign) : -1.0;
+  this->Twiddles.resize(this->M / 2);
+  for (int k = 0; k < this->M / 2; ++k)
+    {
+    const double angle = twiddleSign * 2.0 * pi * k / this->M;
+    this->Twiddles[k] = FFTComplex(static_cast<float>(cos(angle)),
+                                   static_cast<float>(sin(angle)));
+    }
+
+  if (!this->PowerOfTwo)
+    {
+    // chirp[n] = exp(sign * i * pi * n^2 / N), reduce n^2 mod 2N for accuracy.
+    this->Chirp.resize(this->N);
+    for (int n = 0; n < this->N; ++n)
+      {
+      const vtkTypeInt64 n2 = (static_cast<vtkTypeInt64>(n) * n) %
+        (2 * static_cast<vtkTypeInt64>(this->N));
+      const double angle = this->Sign * pi * static_cast<double>(n2) / this->N;
+      this->Chirp[n] = FFTComplex(static_cast<float>(cos(angle)),
+                                  static_cast<float>(sin(angle)));
+      }
+    this->ChirpTransform.assign(this->M, FFTComplex(0.0f, 0.0f));
+    this->ChirpTransform[0] = std::conj(this->Chirp[0]);
+    for (int n = 1; n < this->N; ++n)
+      {
+      this->ChirpTransform[n] = std::conj(this->Chirp[n]);
+      this->ChirpTransform[this->M - n] = std::conj(this->Chirp[n]);
+      }
+    this->executePow2(&this->ChirpTransform[0], false);
+    }
+}
+
+//-----------------------------------------------------------------------------
+int FFTPlan1D::scratchSize() const
+{
+  return this->PowerOfTwo ? 0 : this->M;
+}
+
+//-----------------------------------------------------------------------------
+void FFTPlan1D::executePow2(FFTComplex* a, bool inverse) const
+{
+  const int n = this->M;
+  for (int i = 0; i < n; ++i)
+    {
+    const int j = this->BitReverse[i];
+    if (i < j)
+      {
+      std::swap(a[i], a[j]);
+      }
+    }
+  for (int len = 2; len <= n; len <<= 1)
+    {
+    const int half = len >> 1;
+    const int step = n / len;
+    for (int i = 0; i < n; i += len)
+      {
+      FFTComplex* lo = a + i;
+      FFTComplex* hi = lo + half;
+      for (int k = 0; k < half; ++k)
+        {
+        FFTComplex w = this->Twiddles[k * step];
+        if (inverse)
+          {
+          w = std::conj(w);
+          }
+        const FFTComplex v = hi[k] * w;
+        hi[k] = lo[k] - v;
+        lo[k] += v;
+        }
+      }
+    }
+}
+
+//-----------------------------------------------------------------------------
+void FFTPlan1D::execute(FFTComplex* data, FFTComplex* scratch) const
+{
+  if (this->N <= 1)
+    {
+    return;
+    }
+  if (this->PowerOfTwo)
+    {
+    // Twiddles already carry the sign of the requested direction.
+    this->executePow2(data, false);
+    return;
+    }
+
+  // Bluestein: X[k] = chirp[k] * sum_n (x[n] chirp[n]) conj(chirp[k - n]).
+  for (int n = 0; n < this->N; ++n)
+    {
+    scratch[n] = data[n] * this->Chirp[n];
+    }
+  std::fill(scratch + this->N, scratch + this->M, FFTComplex(0.0f, 0.0f));
+  this->executePow2(scratch, false);
+  for (int k = 0; k < this->M; ++k)
+    {
+    scratch[k] *= this->ChirpTransform[k];
+    }
+  this->executePow2(scratch, true);
+  const float scale = 1.0f / this->M;
+  for (int k = 0; k < this->N; ++k)
+    {
+    data[k] = scratch[k] * this->Chirp[k] * scale;
+    }
+}
+
+//-----------------------------------------------------------------------------
+FFTRealPlan1D::FFTRealPlan1D(int length)
+  : N(length),
+    HalfPlan(length % 2 == 0 ? length / 2 : length, FFTPlan1D::Forward)
+{
+  if (this->N % 2 == 0)
+    {
+    this->Twiddles.resize(this->N / 2 + 1);
+    for (int k = 0; k <= this->N / 2; ++k)
+      {
+      const double angle = -2.0 * pi * k / this->N;
+      this->Twiddles[k] = FFTComplex(static_cast<float>(cos(angle)),
+                                     static_cast<float>(sin(angle)));
+      }
+    }
+}
+
+//-----------------------------------------------------------------------------
+int FFTRealPlan1D::scratchSize() const
+{
+  return this->HalfPlan.scratchSize() + this->HalfPlan.length();
+}
+
+//-----------------------------------------------------------------------------
+void FFTRealPlan1D::execute(const float* input, FFTComplex* output,
+                            FFTComplex* scratch) const
+{
+  const int n = this->HalfPlan.length();
+  FFTComplex* z = scratch;
+  FFTComplex* planScratch = scratch + n;
+  if (this->N % 2 != 0)
+    {
+    // Odd lengths are transformed as complex data with zero imaginary part.
+    for (int i = 0; i < n; ++i)
+      {
+      z[i] = FFTComplex(input[i], 0.0f);
+      }
+    this->HalfPlan.execute(z, planScratch);
+    std::copy(z, z + this->N / 2 + 1, output);
+    return;
+    }
+
+  // Pack even/odd samples as real/imaginary parts, transform at half length
+  // and then separate the two interleaved spectra.
+  for (int i = 0; i < n; ++i)
+    {
+    z[i] = FFTComplex(input[2 * i], input[2 * i + 1]);
+    }
+  this->HalfPlan.execute(z, planScratch);
+  const FFTComplex minusHalfI(0.0f, -0.5f);
+  for (int k = 0; k <= n; ++k)
+    {
+    const FFTComplex zk = z[k % n];
+    const FFTComplex zc = std::conj(z[(n - k) % n]);
+    const FFTComplex even = 0.5f * (zk + zc);
+    const FFTComplex odd = minusHalfI * (zk - zc);
+    output[k] = even + this->Twiddles[k] * odd;
+    }
+}
+
+//-----------------------------------------------------------------------------
+FFTPlan3D::FFTPlan3D(const int dims[3], Type type,
+                     FFTPlan1D::Direction direction)
+  : PlanType(type), Sign(direction), RealPlan(NULL)
+{
+  for (int i = 0; i < 3; ++i)
+    {
+    this->Dims[i] = dims[i];
+    this->Plans[i] = NULL;
+    }
+  if (type == RealToComplex)
+    {
+    // The x pass also converts to the complex layout, so it always runs.
+    this->Sign = FFTPlan1D::Forward;
+    this->RealPlan = new FFTRealPlan1D(dims[0]);
+    }
+  else if (dims[0] > 1)
+    {
+    this->Plans[0] = new FFTPlan1D(dims[0], direction);
+    }
+  for (int i = 1; i < 3; ++i)
+    {
+    if (dims[i] > 1)
+      {
+      this->Plans[i] = new FFTPlan1D(dims[i], this->Sign);
+      }
+    }
+}
+
+//-----------------------------------------------------------------------------
+FFTPlan3D::~FFTPlan3D()
+{
+  delete this->RealPlan;
+  for (int i = 0; i < 3; ++i)
+    {
+    delete this->Plans[i];
+    }
+}
+
+//-----------------------------------------------------------------------------
+size_t FFTPlan3D::bufferSize() const
+{
+  const size_t rowFloats = this->PlanType == RealToComplex ?
+    2 * (this->Dims[0] / 2 + 1) : 2 * this->Dims[0];
+  return rowFloats * this->Dims[1] * this->Dims[2];
+}
+
+//-----------------------------------------------------------------------------
+void FFTPlan3D::execute(float* buffer) const
+{
+  const vtkIdType nx = this->PlanType == RealToComplex ?
+    this->Dims[0] / 2 + 1 : this->Dims[0];
+  const vtkIdType ny = this->Dims[1];
+  const vtkIdType nz = this->Dims[2];
+  FFTComplex* data = reinterpret_cast<FFTComplex*>(buffer);
+
+  // Along x, one row at a time.
+  if (this->RealPlan)
+    {
+    RowFunctor rows(buffer, this->Dims, *this->RealPlan);
+    vtkSMPTools::For(0, ny * nz, rows);
+    }
+  else if (this->Plans[0])
+    {
+    LineFunctor lines(data, nx, 1, 1, *this->Plans[0]);
+    vtkSMPTools::For(0, ny * nz, lines);
+    }
+
+  // Along y, each z slice is a group of nx lines with a stride of nx.
+  if (this->Plans[1])
+    {
+    LineFunctor lines(data, nx * ny, nx, nx, *this->Plans[1]);
+    vtkSMPTools::For(0, nz, lines);
+    }
+
+  // Along z, each y row is a group of nx lines with a stride of nx * ny.
+  if (this->Plans[2])
+    {
+    LineFunctor lines(data, nx, nx, nx * ny, *this->Plans[2]);
+    vtkSMPTools::For(0, ny, lines);
+    }
+}
+
+}
@@ -0,0 +1,140 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizFFTPlan_h
+#define tomvizFFTPlan_h
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+namespace tomviz
+{
+
+typedef std::complex<float> FFTComplex;
+
+/// A single precision 1D complex FFT of a fixed length. Powers of two use an
+/// iterative radix-2 transform, other lengths use Bluestein's algorithm on top
+/// of a power of two transform. Twiddle factors are computed once when the
+/// plan is created, a plan is immutable and may be shared between threads.
+class FFTPlan1D
+{
+public:
+  enum Direction { Forward = -1, Inverse = 1 };
+
+  FFTPlan1D(int length, Direction direction);
+
+  int length() const { return this->N; }
+  Direction direction() const { return this->Sign; }
+
+  /// Number of complex values of scratch space execute() requires.
+  int scratchSize() const;
+
+  /// Transform data in-place. The inverse transform is not normalized.
+  void execute(FFTComplex* data, FFTComplex* scratch) const;
+
+private:
+  void executePow2(FFTComplex* data, bool inverse) const;
+
+  int N;
+  Direction Sign;
+  bool PowerOfTwo;
+
+  // Power of two transform of length M, M == N unless using Bluestein.
+  int M;
+  std::vector<int> BitReverse;
+  std::vector<FFTComplex> Twiddles;
+
+  // Bluestein chirp, and the forward transform of its padded conjugate.
+  std::vector<FFTComplex> Chirp;
+  std::vector<FFTComplex> ChirpTransform;
+};
+
+/// A single precision real to complex forward FFT of a fixed length N,
+/// producing the N/2 + 1 non-redundant complex outputs. Even lengths are
+/// computed as a complex transform of half the length.
+class FFTRealPlan1D
+{
+public:
+  FFTRealPlan1D(int length);
+
+  int length() const { return this->N; }
+
+  /// Number of complex values of scratch space execute() requires.
+  int scratchSize() const;
+
+  /// Transform N reals in input into N/2 + 1 complex values in output. The
+  /// input and output may not overlap.
+  void execute(const float* input, FFTComplex* output,
+               FFTComplex* scratch) const;
+
+private:
+  int N;
+  FFTPlan1D HalfPlan;
+  std::vector<FFTComplex> Twiddles;
+};
+
+/// A single precision 3D FFT of a fixed shape, built from 1D plans along each
+/// axis. Axes of length 1 are skipped, so 1D and 2D transforms use the same
+/// class. Lines along each axis are transformed in parallel, with scratch
+/// space taken from the FFTService buffer pool. Plans are normally obtained
+/// from FFTService::plan() which caches them.
+class FFTPlan3D
+{
+public:
+  enum Type
+    {
+    /// Forward transform of real input, producing the non-redundant half of
+    /// the spectrum along x.
+    RealToComplex,
+    /// Forward or inverse transform of complex data.
+    ComplexToComplex
+    };
+
+  FFTPlan3D(const int dims[3], Type type, FFTPlan1D::Direction direction);
+  ~FFTPlan3D();
+
+  const int* dimensions() const { return this->Dims; }
+  Type type() const { return this->PlanType; }
+  FFTPlan1D::Direction direction() const { return this->Sign; }
+
+  /// Number of floats in the buffer passed to execute(). For RealToComplex the
+  /// buffer uses the padded in-place layout: each row along x holds
+  /// 2 * (dims[0] / 2 + 1) floats, of which the first dims[0] are the real
+  /// input values. On return it holds (dims[0] / 2 + 1) x dims[1] x dims[2]
+  /// complex values, x fastest. For ComplexToComplex the buffer holds the
+  /// dims[0] x dims[1] x dims[2] interleaved complex values.
+  size_t bufferSize() const;
+
+  /// Transform buffer in-place. The inverse transform is not normalized.
+  void execute(float* buffer) const;
+
+private:
+  FFTPlan3D(const FFTPlan3D&);
+  void operator=(const FFTPlan3D&);
+
+  int Dims[3];
+  Type PlanType;
+  FFTPlan1D::Direction Sign;
+
+  // The x axis uses RealPlan for RealToComplex, Plans[0] otherwise. NULL
+  // entries are axes of length 1.
+  FFTRealPlan1D* RealPlan;
+  FFTPlan1D* Plans[3];
+};
+
+}
+
+#endif
@@ -0,0 +1,314 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "FFTService.h"
+
+#include <QHash>
+#include <QList>
+#include <QMultiMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPair>
+
+#include <cstdlib>
+
+namespace
+{
+
+// Alignment of pooled buffers, a cache line and wide enough for any SIMD
+// load.
+const size_t bufferAlignment = 64;
+
+struct PlanKey
+{
+  int Dims[3];
+  int Type;
+  int Direction;
+
+  bool operator==(const PlanKey& other) const
+  {
+    return this->Dims[0] == other.Dims[0] && this->Dims[1] == other.Dims[1] &&
+           this->Dims[2] == other.Dims[2] && this->Type == other.Type &&
+           this->Direction == other.Direction;
+  }
+};
+
+uint qHash(const PlanKey& key)
+{
+  uint hash = static_cast<uint>(key.Type * 2 + (key.Direction > 0 ? 1 : 0));
+  for (int i = 0; i < 3; ++i)
+    {
+    hash = hash * 31 + static_cast<uint>(key.Dims[i]);
+    }
+  return hash;
+}
+
+}
+
+namespace tomviz
+{
+
+class FFTService::FSInternals
+{
+public:
+  FSInternals() : MaximumNumberOfPlans(64),
+    MaximumPooledBytes(static_cast<size_t>(256) * 1024 * 1024), PooledBytes(0),
+    LastReleased(NULL)
+  {
+  }
+
+  ~FSInternals()
+  {
+    this->freePool();
+  }
+
+  void* allocate(size_t bytes)
+  {
+    // Over-allocate, and keep the pointer returned by malloc just before the
+    // aligned address.
+    char* raw = static_cast<char*>(malloc(bytes + bufferAlignment +
+                                          sizeof(void*)));
+    if (!raw)
+      {
+      return NULL;
+      }
+    size_t address = reinterpret_cast<size_t>(raw + sizeof(void*));
+    address = (address + bufferAlignment - 1) & ~(bufferAlignment - 1);
+    void* aligned = reinterpret_cast<void*>(address);
+    reinterpret_cast<void**>(aligned)[-1] = raw;
+    this->Sizes.insert(aligned, bytes);
+    return aligned;
+  }
+
+  void deallocate(void* buffer)
+  {
+    this->Sizes.remove(buffer);
+    free(reinterpret_cast<void**>(buffer)[-1]);
+  }
+
+  void freePool()
+  {
+    for (QMultiMap<size_t, void*>::iterator it = this->Pool.begin();
+         it != this->Pool.end(); ++it)
+      {
+      this->deallocate(it.value());
+      }
+    this->Pool.clear();
+    this->PooledBytes = 0;
+    this->LastReleased = NULL;
+  }
+
+  // Drop pooled buffers, largest first, until the pool fits its limit. The
+  // last released buffer is neither dropped nor counted.
+  void trimPool()
+  {
+    const size_t kept = this->LastReleased ?
+      this->Sizes.value(this->LastReleased, 0) : 0;
+    QMultiMap<size_t, void*>::iterator it = this->Pool.end();
+    while (this->PooledBytes - kept > this->MaximumPooledBytes &&
+           it != this->Pool.begin())
+      {
+      --it;
+      if (it.value() == this->LastReleased)
+        {
+        continue;
+        }
+      this->PooledBytes -= it.key();
+      this->deallocate(it.value());
+      it = this->Pool.erase(it);
+      }
+  }
+
+  void trimPlans()
+  {
+    while (this->Plans.size() > this->MaximumNumberOfPlans)
+      {
+      this->Plans.remove(this->PlanOrder.takeFirst());
+      }
+  }
+
+  mutable QMutex Mutex;
+
+  // Most recently used plans are at the end of PlanOrder.
+  QHash<PlanKey, QSharedPointer<const FFTPlan3D> > Plans;
+  QList<PlanKey> PlanOrder;
+  int MaximumNumberOfPlans;
+
+  // Free buffers by size, and the size of every allocated buffer.
+  QMultiMap<size_t, void*> Pool;
+  QHash<void*, size_t> Sizes;
+  size_t MaximumPooledBytes;
+  size_t PooledBytes;
+  // The pooled buffer released last, if it is still in the pool.
+  void* LastReleased;
+};
+
+//-----------------------------------------------------------------------------
+FFTService::FFTService()
+  : Internals(new FFTService::FSInternals())
+{
+}
+
+//-----------------------------------------------------------------------------
+FFTService::~FFTService()
+{
+}
+
+//-----------------------------------------------------------------------------
+FFTService& FFTService::instance()
+{
+  static FFTService theInstance;
+  return theInstance;
+}
+
+//-----------------------------------------------------------------------------
+QSharedPointer<const FFTPlan3D> FFTService::plan(const int dims[3],
+                                                 FFTPlan3D::Type type,
+                                                 FFTPlan1D::Direction direction)
+{
+  PlanKey key;
+  key.Dims[0] = dims[0];
+  key.Dims[1] = dims[1];
+  key.Dims[2] = dims[2];
+  key.Type = type;
+  // Real to complex plans are always forward.
+  key.Direction = type == FFTPlan3D::RealToComplex ?
+    static_cast<int>(FFTPlan1D::Forward) : static_cast<int>(direction);
+
+  FSInternals& internals = *this->Internals;
+  {
+  QMutexLocker lock(&internals.Mutex);
+  QHash<PlanKey, QSharedPointer<const FFTPlan3D> >::iterator it =
+    internals.Plans.find(key);
+  if (it != internals.Plans.end())
+    {
+    internals.PlanOrder.removeOne(key);
+    internals.PlanOrder.append(key);
+    return it.value();
+    }
+  }
+
+  // Build the plan without holding the lock, planning large Bluestein sizes
+  // is not free. If another thread raced us the first plan inserted wins.
+  QSharedPointer<const FFTPlan3D> newPlan(
+    new FFTPlan3D(dims, type, direction));
+
+  QMutexLocker lock(&internals.Mutex);
+  QHash<PlanKey, QSharedPointer<const FFTPlan3D> >::iterator it =
+    internals.Plans.find(key);
+  if (it != internals.Plans.end())
+    {
+    return it.value();
+    }
+  internals.Plans.insert(key, newPlan);
+  internals.PlanOrder.append(key);
+  internals.trimPlans();
+  return newPlan;
+}
+
+//-----------------------------------------------------------------------------
+void FFTService::setMaximumNumberOfPlans(int count)
+{
+  QMutexLocker lock(&this->Internals->Mutex);
+  this->Internals->MaximumNumberOfPlans = count > 0 ? count : 1;
+  this->Internals->trimPlans();
+}
+
+//-----------------------------------------------------------------------------
+int FFTService::maximumNumberOfPlans() const
+{
+  QMutexLocker lock(&this->Internals->Mutex);
+  return this->Internals->MaximumNumberOfPlans;
+}
+
+//-----------------------------------------------------------------------------
+int FFTService::numberOfPlans() const
+{
+  QMutexLocker lock(&this->Internals->Mutex);
+  return this->Internals->Plans.size();
+}
+
+//-----------------------------------------------------------------------------
+void* FFTService::acquireBuffer(size_t bytes)
+{
+  FSInternals& internals = *this->Internals;
+  QMutexLocker lock(&internals.Mutex);
+
+  // Reuse the smallest pooled buffer that fits, unless it would waste more
+  // than half of its size.
+  QMultiMap<size_t, void*>::iterator it = internals.Pool.lowerBound(bytes);
+  if (it != internals.Pool.end() && it.key() / 2 <= bytes)
+    {
+    void* buffer = it.value();
+    internals.PooledBytes -= it.key();
+    internals.Pool.erase(it);
+    if (buffer == internals.LastReleased)
+      {
+      internals.LastReleased = NULL;
+      }
+    return buffer;
+    }
+  return internals.allocate(bytes);
+}
+
+//-----------------------------------------------------------------------------
+void FFTService::releaseBuffer(void* buffer)
+{
+  if (!buffer)
+    {
+    return;
+    }
+  FSInternals& internals = *this->Internals;
+  QMutexLocker lock(&internals.Mutex);
+  const size_t bytes = internals.Sizes.value(buffer, 0);
+  Q_ASSERT(internals.Sizes.contains(buffer));
+  internals.Pool.insert(bytes, buffer);
+  internals.PooledBytes += bytes;
+  internals.LastReleased = buffer;
+  internals.trimPool();
+}
+
+//-----------------------------------------------------------------------------
+void FFTService::setMaximumPooledBytes(size_t bytes)
+{
+  QMutexLocker lock(&this->Internals->Mutex);
+  this->Internals->MaximumPooledBytes = bytes;
+  this->Internals->trimPool();
+}
+
+//-----------------------------------------------------------------------------
+size_t FFTService::maximumPooledBytes() const
+{
+  QMutexLocker lock(&this->Internals->Mutex);
+  return this->Internals->MaximumPooledBytes;
+}
+
+//-----------------------------------------------------------------------------
+size_t FFTService::pooledBytes() const
+{
+  QMutexLocker lock(&this->Internals->Mutex);
+  return this->Internals->PooledBytes;
+}
+
+//-----------------------------------------------------------------------------
+void FFTService::clear()
+{
+  QMutexLocker lock(&this->Internals->Mutex);
+  this->Internals->Plans.clear();
+  this->Internals->PlanOrder.clear();
+  this->Internals->freePool();
+}
+
+}
@@ -0,0 +1,96 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizFFTService_h
+#define tomvizFFTService_h
+
+#include "FFTPlan.h"
+
+#include <QScopedPointer>
+#include <QSharedPointer>
+
+namespace tomviz
+{
+
+/// FFTService is a process-wide cache of FFT plans and of the scratch buffers
+/// used to execute them. Repeated transforms of the same shape, such as one
+/// per tilt image, reuse the plan (twiddle factors, permutations, Bluestein
+/// chirps) and the scratch memory instead of rebuilding them on every call.
+/// All methods are thread safe.
+class FFTService
+{
+public:
+  /// Returns reference to the singleton instance.
+  static FFTService& instance();
+
+  /// Returns the cached plan for the given shape, type and direction, creating
+  /// it if needed. The least recently used plans are dropped once more than
+  /// maximumNumberOfPlans() are cached. Plans do not depend on the number of
+  /// threads, the same plan is shared by all threads.
+  QSharedPointer<const FFTPlan3D> plan(const int dims[3], FFTPlan3D::Type type,
+                                       FFTPlan1D::Direction direction);
+
+  void setMaximumNumberOfPlans(int count);
+  int maximumNumberOfPlans() const;
+  int numberOfPlans() const;
+
+  /// Returns a buffer of at least the given number of bytes, aligned for SIMD
+  /// loads. Buffers are reused from the pool when one of a suitable size is
+  /// available. The buffer must be returned with releaseBuffer().
+  void* acquireBuffer(size_t bytes);
+  void releaseBuffer(void* buffer);
+
+  /// Released buffers are kept in the pool as long as the pool holds at most
+  /// this many bytes, larger buffers are freed. The most recently released
+  /// buffer is kept whatever its size, and not counted against the limit, so
+  /// that repeating a transform of a large volume does not allocate again.
+  void setMaximumPooledBytes(size_t bytes);
+  size_t maximumPooledBytes() const;
+  size_t pooledBytes() const;
+
+  /// Drop all cached plans and free all pooled buffers.
+  void clear();
+
+private:
+  FFTService();
+  ~FFTService();
+  FFTService(const FFTService&);
+  void operator=(const FFTService&);
+
+  class FSInternals;
+  const QScopedPointer<FSInternals> Internals;
+};
+
+/// Scoped buffer from the FFTService pool, returned to the pool when it goes
+/// out of scope.
+class FFTBuffer
+{
+public:
+  FFTBuffer(size_t bytes)
+    : Data(FFTService::instance().acquireBuffer(bytes)) {}
+  ~FFTBuffer() { FFTService::instance().releaseBuffer(this->Data); }
+
+  void* data() const { return this->Data; }
+
+private:
+  FFTBuffer(const FFTBuffer&);
+  void operator=(const FFTBuffer&);
+
+  void* Data;
+};
+
+}
+
+#endif
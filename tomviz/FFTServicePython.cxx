@@ -0,0 +1,208 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "vtkPython.h"
+#include "FFTServicePython.h"
+
+#include "FFTService.h"
+
+#include <cstring>
+
+namespace
+{
+
+// Scoped Py_buffer, released when it goes out of scope.
+class ScopedBuffer
+{
+public:
+  ScopedBuffer() : Valid(false) {}
+  ~ScopedBuffer()
+  {
+    if (this->Valid)
+      {
+      PyBuffer_Release(&this->View);
+      }
+  }
+
+  bool acquire(PyObject* obj, int flags)
+  {
+    this->Valid = PyObject_GetBuffer(obj, &this->View, flags) == 0;
+    return this->Valid;
+  }
+
+  Py_buffer View;
+
+private:
+  ScopedBuffer(const ScopedBuffer&);
+  void operator=(const ScopedBuffer&);
+
+  bool Valid;
+};
+
+//----------------------------------------------------------------------------
+// Check the buffer holds an array of 1 to 3 dimensions of the given struct
+// format ("f" or "Zf"), and fill dims in x, y, z order.
+bool checkArray(const Py_buffer& view, const char* format, int dims[3])
+{
+  const char* viewFormat = view.format ? view.format : "B";
+  if (*viewFormat == '<' || *viewFormat == '=' || *viewFormat == '@')
+    {
+    ++viewFormat;
+    }
+  if (strcmp(viewFormat, format) != 0)
+    {
+    PyErr_Format(PyExc_TypeError, "expected an array of format '%s', got '%s'",
+                 format, view.format ? view.format : "B");
+    return false;
+    }
+  if (view.ndim < 1 || view.ndim > 3)
+    {
+    PyErr_SetString(PyExc_ValueError, "expected an array of 1 to 3 dimensions");
+    return false;
+    }
+  for (int i = 0; i < 3; ++i)
+    {
+    Py_ssize_t size = i < view.ndim ? view.shape[i] : 1;
+    if (size < 1 || size > 0x7fffffff)
+      {
+      PyErr_SetString(PyExc_ValueError, "unsupported array shape");
+      return false;
+      }
+    dims[i] = static_cast<int>(size);
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+PyObject* fftInPlace(PyObject*, PyObject* args)
+{
+  PyObject* array = NULL;
+  int inverse = 0;
+  if (!PyArg_ParseTuple(args, "O|i:fft_inplace", &array, &inverse))
+    {
+    return NULL;
+    }
+  ScopedBuffer buffer;
+  int dims[3];
+  if (!buffer.acquire(array,
+                      PyBUF_F_CONTIGUOUS | PyBUF_FORMAT | PyBUF_WRITABLE) ||
+      !checkArray(buffer.View, "Zf", dims))
+    {
+    return NULL;
+    }
+
+  QSharedPointer<const tomviz::FFTPlan3D> plan =
+    tomviz::FFTService::instance().plan(dims,
+      tomviz::FFTPlan3D::ComplexToComplex,
+      inverse ? tomviz::FFTPlan1D::Inverse : tomviz::FFTPlan1D::Forward);
+  Py_BEGIN_ALLOW_THREADS
+  plan->execute(static_cast<float*>(buffer.View.buf));
+  Py_END_ALLOW_THREADS
+  Py_RETURN_NONE;
+}
+
+//----------------------------------------------------------------------------
+PyObject* rfftn(PyObject*, PyObject* args)
+{
+  PyObject* input = NULL;
+  PyObject* output = NULL;
+  if (!PyArg_ParseTuple(args, "OO:rfftn", &input, &output))
+    {
+    return NULL;
+    }
+  ScopedBuffer in, out;
+  int dims[3], outDims[3];
+  if (!in.acquire(input, PyBUF_F_CONTIGUOUS | PyBUF_FORMAT) ||
+      !checkArray(in.View, "f", dims) ||
+      !out.acquire(output,
+                   PyBUF_F_CONTIGUOUS | PyBUF_FORMAT | PyBUF_WRITABLE) ||
+      !checkArray(out.View, "Zf", outDims))
+    {
+    return NULL;
+    }
+  if (outDims[0] != dims[0] / 2 + 1 || outDims[1] != dims[1] ||
+      outDims[2] != dims[2])
+    {
+    PyErr_SetString(PyExc_ValueError, "output shape does not match the input");
+    return NULL;
+    }
+
+  QSharedPointer<const tomviz::FFTPlan3D> plan =
+    tomviz::FFTService::instance().plan(dims,
+      tomviz::FFTPlan3D::RealToComplex, tomviz::FFTPlan1D::Forward);
+  const float* src = static_cast<const float*>(in.View.buf);
+  float* dst = static_cast<float*>(out.View.buf);
+  Py_BEGIN_ALLOW_THREADS
+  // The output array is exactly the padded in-place layout of the plan.
+  const size_t rowFloats = 2 * static_cast<size_t>(outDims[0]);
+  const size_t rows = static_cast<size_t>(dims[1]) * dims[2];
+  for (size_t r = 0; r < rows; ++r)
+    {
+    memcpy(dst + r * rowFloats, src + r * dims[0], dims[0] * sizeof(float));
+    }
+  plan->execute(dst);
+  Py_END_ALLOW_THREADS
+  Py_RETURN_NONE;
+}
+
+//----------------------------------------------------------------------------
+PyObject* clearCache(PyObject*, PyObject*)
+{
+  tomviz::FFTService::instance().clear();
+  Py_RETURN_NONE;
+}
+
+//----------------------------------------------------------------------------
+PyObject* cacheInfo(PyObject*, PyObject*)
+{
+  tomviz::FFTService& service = tomviz::FFTService::instance();
+  return Py_BuildValue("{s:i,s:n}",
+                       "plans", service.numberOfPlans(),
+                       "pooled_bytes",
+                       static_cast<Py_ssize_t>(service.pooledBytes()));
+}
+
+PyMethodDef methods[] = {
+  { "fft_inplace", fftInPlace, METH_VARARGS,
+    "fft_inplace(array, inverse=False)\n"
+    "Unnormalized in-place FFT of a Fortran ordered complex64 array." },
+  { "rfftn", rfftn, METH_VARARGS,
+    "rfftn(input, output)\n"
+    "Real to complex FFT of a Fortran ordered float32 array into a complex64 "
+    "array halved along the first axis." },
+  { "clear_cache", clearCache, METH_NOARGS,
+    "Drop all cached FFT plans and pooled buffers." },
+  { "cache_info", cacheInfo, METH_NOARGS,
+    "Number of cached plans and bytes held by the buffer pool." },
+  { NULL, NULL, 0, NULL }
+};
+
+}
+
+namespace tomviz
+{
+
+//----------------------------------------------------------------------------
+void initializeFFTPythonModule()
+{
+  static bool initialized = false;
+  if (initialized)
+    {
+    return;
+    }
+  initialized = Py_InitModule("_tomviz_fft", methods) != NULL;
+}
+
+}
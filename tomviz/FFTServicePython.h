@@ -0,0 +1,29 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizFFTServicePython_h
+#define tomvizFFTServicePython_h
+
+namespace tomviz
+{
+
+/// Registers the "_tomviz_fft" Python module, which exposes FFTService to
+/// the helpers in tomviz.utils. The Python interpreter must be initialized,
+/// calling this more than once is harmless.
+void initializeFFTPythonModule();
+
+}
+
+#endif
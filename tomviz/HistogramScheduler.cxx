@@ -0,0 +1,1152 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "HistogramScheduler.h"
+
+#include "BrickHistograms.h"
+#include "ComputeHistogram.h"
+#include "DataSource.h"
+#include "ScalarStatistics.h"
+#include "Utilities.h"
+
+#include <vtkDataArray.h>
+#include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPVArrayInformation.h>
+#include <vtkSMSourceProxy.h>
+#include <vtkSmartPointer.h>
+#include <vtkTable.h>
+#include <vtkTrivialProducer.h>
+
+#include <QAtomicInt>
+#include <QList>
+#include <QMap>
+#include <QPair>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSharedPointer>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+namespace
+{
+
+// Voxels in the estimate published before the full volume has been binned.
+const vtkIdType SampleSize = 1 << 20;
+
+// The volume is traversed in chunks of this many voxels, checking for
+// cancellation before each one.
+const vtkIdType ChunkSize = 1 << 24;
+
+// At most this many partial histograms are published while binning.
+const vtkIdType MaximumUpdates = 8;
+
+// The per-brick counts of the cached histograms are kept for the most
+// recently used ones up to this many bytes.
+const size_t MaximumBricksMemory = 256 << 20;
+
+// The output table will have the twice the number of columns, they will be
+// the x and y for input column. This is the bin centers, and the population.
+// Returns the zeroed populations to fill in.
+vtkIdType* InitializeHistogramTable(vtkTable *output, double minmax[2],
+                                    int numberOfBins)
+{
+  if (minmax[0] == minmax[1])
+    {
+    minmax[1] = minmax[0] + 1.0;
+    }
+
+  // The bin values are the centers, extending +/- half an inc either side
+  double inc = (minmax[1] - minmax[0]) / numberOfBins;
+  double halfInc = inc / 2.0;
+  vtkNew<vtkFloatArray> extents;
+  extents->SetName("image_extents");
+  extents->SetNumberOfTuples(numberOfBins);
+  double min = minmax[0] + halfInc;
+  for (int j = 0; j < numberOfBins; ++j)
+    {
+    extents->SetValue(j, min + j * inc);
+    }
+  // Counts are 64 bit, so that volumes with more than 2^31 voxels are safe.
+  vtkNew<vtkIdTypeArray> populations;
+  populations->SetName("image_pops");
+  populations->SetNumberOfTuples(numberOfBins);
+  vtkIdType *pops = populations->GetPointer(0);
+  std::fill(pops, pops + numberOfBins, 0);
+
+  output->AddColumn(extents.GetPointer());
+  output->AddColumn(populations.GetPointer());
+  return pops;
+}
+
+// Scale populations counted from part of the volume up to the full volume.
+void ScalePopulations(vtkTable *table, vtkIdType counted, vtkIdType total)
+{
+  vtkIdTypeArray *populations =
+      vtkIdTypeArray::SafeDownCast(table->GetColumnByName("image_pops"));
+  vtkIdType *pops = populations->GetPointer(0);
+  const double scale = static_cast<double>(total) / counted;
+  for (vtkIdType k = 0; k < populations->GetNumberOfTuples(); ++k)
+    {
+    pops[k] = static_cast<vtkIdType>(pops[k] * scale + 0.5);
+    }
+}
+
+vtkImageData* imageData(tomviz::DataSource *source)
+{
+  vtkTrivialProducer *t = vtkTrivialProducer::SafeDownCast(
+    source->producer()->GetClientSideObject());
+  return t ? vtkImageData::SafeDownCast(t->GetOutputDataObject(0)) : NULL;
+}
+
+}
+
+namespace tomviz
+{
+
+// Computes one histogram on the thread pool, by counting the histograms of
+// the bricks of the volume in chunks, with partial results published along
+// the way. A job is either given the brick histograms of an earlier version
+// of the data, updated so that only the bricks that changed are counted, or
+// starts from scratch, first publishing an estimate from a strided sample of
+// the voxels. The job holds a reference to the scalars, so they stay valid
+// even if the DataSource replaces its data while the job runs.
+class HistogramJob : public QObject, public QRunnable
+{
+  Q_OBJECT
+
+public:
+  HistogramJob(DataSource *source, vtkImageData *data, int numberOfBins,
+               const double *range, BrickHistograms *bricks)
+    : Source(source), Version(source->dataVersion()),
+      NumberOfBins(numberOfBins), Scalars(data->GetPointData()->GetScalars()),
+      HasRange(range != NULL), Bricks(bricks)
+  {
+    this->setAutoDelete(false);
+    data->GetExtent(this->Extent);
+    this->Range[0] = range ? range[0] : 0.0;
+    this->Range[1] = range ? range[1] : 0.0;
+  }
+
+  void run();
+
+  void cancel() { this->Cancelled.fetchAndStoreOrdered(1); }
+  bool isCancelled() const { return this->Cancelled != 0; }
+
+  /// Returns the most recently published partial histogram, if any.
+  vtkSmartPointer<vtkTable> takeProgress()
+  {
+    QMutexLocker locker(&this->ProgressMutex);
+    vtkSmartPointer<vtkTable> table = this->Progress;
+    this->Progress = NULL;
+    return table;
+  }
+
+  vtkTable* result() { return this->Output.Get(); }
+
+  /// The statistics of the data, valid once the job has finished.
+  const ScalarStatistics& statistics() const { return this->Statistics; }
+
+  /// The histograms of the bricks of the data, valid once the job has
+  /// finished, from which the next version of the data can be updated.
+  QSharedPointer<BrickHistograms> bricks() const { return this->Bricks; }
+
+  DataSource *Source;
+  unsigned long Version;
+  int NumberOfBins;
+
+signals:
+  /// Emitted from the pool thread when a partial histogram is published.
+  void progress();
+
+  /// Emitted from the pool thread when the job is done, or was cancelled.
+  void finished();
+
+private:
+  bool startBricks();
+  template<typename T>
+  bool estimate(T *values, vtkIdType n, double minmax[2]);
+  bool countBricks();
+  void finish();
+  vtkIdType* fillTable(vtkTable *table) const;
+  void publish(vtkTable *table);
+
+  vtkSmartPointer<vtkDataArray> Scalars;
+  int Extent[6];
+  bool HasRange;
+  double Range[2];
+  QSharedPointer<BrickHistograms> Bricks;
+  ScalarStatistics Statistics;
+  QAtomicInt Cancelled;
+  vtkNew<vtkTable> Output;
+  QMutex ProgressMutex;
+  vtkSmartPointer<vtkTable> Progress;
+};
+
+//-----------------------------------------------------------------------------
+void HistogramJob::run()
+{
+  if (!this->isCancelled() && (this->Bricks || this->startBricks()) &&
+      this->countBricks())
+    {
+    if (!this->Bricks->isInRange())
+      {
+      // The data changed beyond the bins of the histograms it was updated
+      // from, so bin all of it again over its new range.
+      this->HasRange = false;
+      this->Bricks.clear();
+      if (!this->startBricks() || !this->countBricks())
+        {
+        emit this->finished();
+        return;
+        }
+      }
+    this->finish();
+    }
+  emit this->finished();
+}
+
+//-----------------------------------------------------------------------------
+bool HistogramJob::startBricks()
+{
+  double minmax[2] = { this->Range[0], this->Range[1] };
+  bool ok = false;
+  switch (this->Scalars->GetDataType())
+    {
+    vtkTemplateMacro(
+      ok = this->estimate(static_cast<VTK_TT *>(
+                            this->Scalars->GetVoidPointer(0)),
+                          this->Scalars->GetNumberOfTuples(), minmax));
+    default:
+      break;
+    }
+  if (!ok)
+    {
+    return false;
+    }
+  if (minmax[0] == minmax[1])
+    {
+    minmax[1] = minmax[0] + 1.0;
+    }
+  this->Bricks = QSharedPointer<BrickHistograms>(
+    new BrickHistograms(this->Extent, minmax, this->NumberOfBins));
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+template<typename T>
+bool HistogramJob::estimate(T *values, vtkIdType n, double minmax[2])
+{
+  // An odd stride avoids sampling the same few columns of volumes with power
+  // of two dimensions.
+  const vtkIdType stride = (n / SampleSize) | 1;
+  if (stride > 1)
+    {
+    std::vector<T> samples((n + stride - 1) / stride);
+    const vtkIdType numberOfSamples = static_cast<vtkIdType>(samples.size());
+    tomviz::GatherSamples(values, n, stride, &samples[0]);
+    double sampleRange[2] = { minmax[0], minmax[1] };
+    if (!this->HasRange)
+      {
+      tomviz::GetScalarRange(&samples[0], numberOfSamples, sampleRange);
+      }
+    vtkNew<vtkTable> estimate;
+    vtkIdType *pops = InitializeHistogramTable(estimate.Get(), sampleRange,
+                                               this->NumberOfBins);
+    tomviz::CalculateHistogram(&samples[0], numberOfSamples, sampleRange[0],
+                               pops,
+                               (sampleRange[1] - sampleRange[0]) /
+                               this->NumberOfBins,
+                               this->NumberOfBins);
+    ScalePopulations(estimate.Get(), numberOfSamples, n);
+    this->publish(estimate.Get());
+    }
+
+  if (!this->HasRange)
+    {
+    const vtkIdType numberOfChunks =
+        std::max<vtkIdType>(1, (n + ChunkSize - 1) / ChunkSize);
+    bool valid = false;
+    for (vtkIdType c = 0; c < numberOfChunks; ++c)
+      {
+      if (this->isCancelled())
+        {
+        return false;
+        }
+      const vtkIdType begin = c * ChunkSize;
+      const vtkIdType end = std::min(n, begin + ChunkSize);
+      double chunkRange[2];
+      if (tomviz::GetScalarRange(values + begin, end - begin, chunkRange))
+        {
+        minmax[0] = valid ? std::min(minmax[0], chunkRange[0]) : chunkRange[0];
+        minmax[1] = valid ? std::max(minmax[1], chunkRange[1]) : chunkRange[1];
+        valid = true;
+        }
+      }
+    }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool HistogramJob::countBricks()
+{
+  BrickHistograms *bricks = this->Bricks.data();
+  const vtkIdType numberOfBricks = bricks->numberOfDirtyBricks();
+  const vtkIdType bricksPerChunk = std::max<vtkIdType>(1,
+    ChunkSize / (static_cast<vtkIdType>(BrickHistograms::BrickSize) *
+                 BrickHistograms::BrickSize * BrickHistograms::BrickSize));
+  const vtkIdType numberOfChunks =
+      (numberOfBricks + bricksPerChunk - 1) / bricksPerChunk;
+  const vtkIdType chunksPerUpdate =
+      std::max<vtkIdType>(1, numberOfChunks / MaximumUpdates);
+  for (vtkIdType c = 0; c < numberOfChunks; ++c)
+    {
+    if (this->isCancelled())
+      {
+      return false;
+      }
+    const vtkIdType first = c * bricksPerChunk;
+    const vtkIdType last = std::min(numberOfBricks, first + bricksPerChunk);
+    if (!bricks->count(this->Scalars, first, last))
+      {
+      return false;
+      }
+    if (c + 1 < numberOfChunks && (c + 1) % chunksPerUpdate == 0)
+      {
+      vtkNew<vtkTable> partial;
+      this->fillTable(partial.Get());
+      ScalePopulations(partial.Get(), bricks->numberOfCountedVoxels(),
+                       this->Scalars->GetNumberOfTuples());
+      this->publish(partial.Get());
+      }
+    }
+  bricks->clearDirty();
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+vtkIdType* HistogramJob::fillTable(vtkTable *table) const
+{
+  double binsRange[2] = { this->Bricks->binsRange()[0],
+                          this->Bricks->binsRange()[1] };
+  vtkIdType *pops = InitializeHistogramTable(table, binsRange,
+                                             this->NumberOfBins);
+  const std::vector<vtkIdType>& totals = this->Bricks->populations();
+  std::copy(totals.begin(), totals.end(), pops);
+  return pops;
+}
+
+//-----------------------------------------------------------------------------
+void HistogramJob::finish()
+{
+  vtkIdType *pops = this->fillTable(this->Output.Get());
+  double range[2];
+  double moments[3];
+  if (!this->Bricks->totals(range, moments))
+    {
+    range[0] = this->Bricks->binsRange()[0];
+    range[1] = this->Bricks->binsRange()[1];
+    }
+  this->Statistics.set(range, this->Bricks->binsRange(), pops,
+                       this->NumberOfBins, moments);
+
+#ifndef NDEBUG
+  // NaNs are in neither the populations nor the count.
+  vtkIdType total = 0;
+  for (int i = 0; i < this->NumberOfBins; ++i)
+    {
+    total += pops[i];
+    }
+  assert(total == this->Statistics.count());
+#endif
+}
+
+//-----------------------------------------------------------------------------
+void HistogramJob::publish(vtkTable *table)
+{
+  if (this->isCancelled())
+    {
+    return;
+    }
+  {
+  QMutexLocker locker(&this->ProgressMutex);
+  this->Progress = table;
+  }
+  emit this->progress();
+}
+
+// Computes the joint histogram of the scalars of two DataSources with the
+// same extent on the thread pool, in chunks, checking for cancellation
+// between them. The result is an image of NumberOfBins x NumberOfBins counts
+// with the first scalars along x and the second along y.
+class JointHistogramJob : public QObject, public QRunnable
+{
+  Q_OBJECT
+
+public:
+  JointHistogramJob(DataSource *first, DataSource *second,
+                    vtkDataArray *firstScalars, vtkDataArray *secondScalars,
+                    int numberOfBins, const double *firstRange,
+                    const double *secondRange)
+    : First(first), Second(second), FirstVersion(first->dataVersion()),
+      SecondVersion(second->dataVersion()), NumberOfBins(numberOfBins)
+  {
+    this->setAutoDelete(false);
+    this->Scalars[0] = firstScalars;
+    this->Scalars[1] = secondScalars;
+    const double *ranges[2] = { firstRange, secondRange };
+    for (int i = 0; i < 2; ++i)
+      {
+      this->HasRange[i] = ranges[i] != NULL;
+      this->Range[2 * i] = ranges[i] ? ranges[i][0] : 0.0;
+      this->Range[2 * i + 1] = ranges[i] ? ranges[i][1] : 0.0;
+      }
+  }
+
+  void run();
+
+  void cancel() { this->Cancelled.fetchAndStoreOrdered(1); }
+  bool isCancelled() const { return this->Cancelled != 0; }
+
+  /// The joint histogram, with no scalars unless the job completed.
+  vtkImageData* result() { return this->Output.Get(); }
+
+  DataSource *First;
+  DataSource *Second;
+  unsigned long FirstVersion;
+  unsigned long SecondVersion;
+  int NumberOfBins;
+
+signals:
+  /// Emitted from the pool thread when the job is done, or was cancelled.
+  void finished();
+
+private:
+  template<typename T1>
+  void compute(T1 *first);
+  template<typename T1, typename T2>
+  void compute(T1 *first, T2 *second);
+  template<typename T>
+  bool scalarRange(T *values, vtkIdType n, double minmax[2]);
+
+  vtkSmartPointer<vtkDataArray> Scalars[2];
+  bool HasRange[2];
+  double Range[4];
+  QAtomicInt Cancelled;
+  vtkNew<vtkImageData> Output;
+};
+
+//-----------------------------------------------------------------------------
+void JointHistogramJob::run()
+{
+  if (!this->isCancelled())
+    {
+    switch (this->Scalars[0]->GetDataType())
+      {
+      vtkTemplateMacro(
+        this->compute(static_cast<VTK_TT *>(
+                        this->Scalars[0]->GetVoidPointer(0))));
+      default:
+        break;
+      }
+    }
+  emit this->finished();
+}
+
+//-----------------------------------------------------------------------------
+template<typename T1>
+void JointHistogramJob::compute(T1 *first)
+{
+  switch (this->Scalars[1]->GetDataType())
+    {
+    vtkTemplateMacro(
+      this->compute(first, static_cast<VTK_TT *>(
+                             this->Scalars[1]->GetVoidPointer(0))));
+    default:
+      break;
+    }
+}
+
+//-----------------------------------------------------------------------------
+template<typename T>
+bool JointHistogramJob::scalarRange(T *values, vtkIdType n, double minmax[2])
+{
+  bool valid = false;
+  for (vtkIdType begin = 0; begin < n; begin += ChunkSize)
+    {
+    if (this->isCancelled())
+      {
+      return false;
+      }
+    double chunkRange[2];
+    if (tomviz::GetScalarRange(values + begin,
+                               std::min(n - begin, ChunkSize), chunkRange))
+      {
+      minmax[0] = valid ? std::min(minmax[0], chunkRange[0]) : chunkRange[0];
+      minmax[1] = valid ? std::max(minmax[1], chunkRange[1]) : chunkRange[1];
+      valid = true;
+      }
+    }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+template<typename T1, typename T2>
+void JointHistogramJob::compute(T1 *first, T2 *second)
+{
+  const vtkIdType n = this->Scalars[0]->GetNumberOfTuples();
+  if ((!this->HasRange[0] && !this->scalarRange(first, n, this->Range)) ||
+      (!this->HasRange[1] && !this->scalarRange(second, n, this->Range + 2)))
+    {
+    return;
+    }
+
+  const int bins = this->NumberOfBins;
+  double min[2];
+  double inc[2];
+  for (int i = 0; i < 2; ++i)
+    {
+    if (this->Range[2 * i] == this->Range[2 * i + 1])
+      {
+      this->Range[2 * i + 1] = this->Range[2 * i] + 1.0;
+      }
+    min[i] = this->Range[2 * i];
+    inc[i] = (this->Range[2 * i + 1] - this->Range[2 * i]) / bins;
+    }
+
+  vtkNew<vtkIdTypeArray> populations;
+  populations->SetName("joint_pops");
+  populations->SetNumberOfTuples(static_cast<vtkIdType>(bins) * bins);
+  vtkIdType *pops = populations->GetPointer(0);
+  std::fill(pops, pops + static_cast<vtkIdType>(bins) * bins, 0);
+  for (vtkIdType begin = 0; begin < n; begin += ChunkSize)
+    {
+    if (this->isCancelled())
+      {
+      return;
+      }
+    tomviz::CalculateJointHistogram(first + begin, second + begin,
+                                    std::min(n - begin, ChunkSize), min, inc,
+                                    bins, pops);
+    }
+
+  // Each pixel is at the center of its bins.
+  this->Output->SetDimensions(bins, bins, 1);
+  this->Output->SetOrigin(min[0] + inc[0] / 2.0, min[1] + inc[1] / 2.0, 0.0);
+  this->Output->SetSpacing(inc[0], inc[1], 1.0);
+  this->Output->GetPointData()->SetScalars(populations.Get());
+}
+
+class HistogramScheduler::HSInternals
+{
+public:
+  typedef QPair<DataSource*, int> JobKey;
+
+  struct CacheEntry
+  {
+    DataSource* Source;
+    unsigned long Version;
+    int NumberOfBins;
+    ScalarStatistics Statistics;
+    vtkSmartPointer<vtkTable> Table;
+    QSharedPointer<BrickHistograms> Bricks;
+  };
+
+  typedef QPair<DataSource*, DataSource*> JointKey;
+
+  struct JointCacheEntry
+  {
+    DataSource* First;
+    unsigned long FirstVersion;
+    DataSource* Second;
+    unsigned long SecondVersion;
+    int NumberOfBins;
+    vtkSmartPointer<vtkImageData> Histogram;
+  };
+
+  HSInternals() : MaximumCacheSize(32) {}
+
+  // Index of the cached entry, or -1.
+  int find(DataSource* source, unsigned long version, int numberOfBins) const
+  {
+    for (int i = 0; i < this->Cache.size(); ++i)
+      {
+      const CacheEntry& entry = this->Cache[i];
+      if (entry.Source == source && entry.Version == version &&
+          entry.NumberOfBins == numberOfBins)
+        {
+        return i;
+        }
+      }
+    return -1;
+  }
+
+  // Index of the cached joint histogram of the sources' current data, or -1.
+  int findJoint(DataSource* first, DataSource* second, int numberOfBins) const
+  {
+    for (int i = 0; i < this->JointCache.size(); ++i)
+      {
+      const JointCacheEntry& entry = this->JointCache[i];
+      if (entry.First == first && entry.Second == second &&
+          entry.NumberOfBins == numberOfBins &&
+          entry.FirstVersion == first->dataVersion() &&
+          entry.SecondVersion == second->dataVersion())
+        {
+        return i;
+        }
+      }
+    return -1;
+  }
+
+  void insert(const CacheEntry& entry)
+  {
+    this->Cache.prepend(entry);
+    this->trim();
+  }
+
+  void trim()
+  {
+    while (this->Cache.size() > this->MaximumCacheSize)
+      {
+      this->Cache.removeLast();
+      }
+    while (this->JointCache.size() > this->MaximumCacheSize)
+      {
+      this->JointCache.removeLast();
+      }
+
+    // The per-brick counts are only needed to update a histogram after a
+    // partial change, and take much more memory than the histogram, so they
+    // are dropped from the least recently used entries. Those of the most
+    // recent entry are always kept.
+    size_t bricksMemory = 0;
+    for (int i = 0; i < this->Cache.size(); ++i)
+      {
+      QSharedPointer<BrickHistograms>& bricks = this->Cache[i].Bricks;
+      if (bricks)
+        {
+        bricksMemory += bricks->memorySize();
+        if (i > 0 && bricksMemory > MaximumBricksMemory)
+          {
+          bricks.clear();
+          }
+        }
+      }
+  }
+
+  // Drop the entries of the source, or only those of other versions.
+  void drop(DataSource* source, bool keepCurrentVersion)
+  {
+    const unsigned long version =
+        keepCurrentVersion ? source->dataVersion() : 0;
+    for (int i = this->Cache.size() - 1; i >= 0; --i)
+      {
+      if (this->Cache[i].Source == source &&
+          !(keepCurrentVersion && this->Cache[i].Version == version))
+        {
+        this->Cache.removeAt(i);
+        }
+      }
+    for (int i = this->JointCache.size() - 1; i >= 0; --i)
+      {
+      const JointCacheEntry& entry = this->JointCache[i];
+      if ((entry.First == source &&
+           !(keepCurrentVersion && entry.FirstVersion == version)) ||
+          (entry.Second == source &&
+           !(keepCurrentVersion && entry.SecondVersion == version)))
+        {
+        this->JointCache.removeAt(i);
+        }
+      }
+  }
+
+  QThreadPool Pool;
+  // The latest job for each DataSource and bin count, removed when it
+  // finishes.
+  QMap<JobKey, HistogramJob*> Jobs;
+  // The latest joint histogram job for each pair of DataSources.
+  QMap<JointKey, JointHistogramJob*> JointJobs;
+  // Most recently used first.
+  QList<CacheEntry> Cache;
+  QList<JointCacheEntry> JointCache;
+  int MaximumCacheSize;
+};
+
+//-----------------------------------------------------------------------------
+HistogramScheduler::HistogramScheduler(QObject* parentObject)
+  : Superclass(parentObject),
+  Internals(new HistogramScheduler::HSInternals())
+{
+}
+
+//-----------------------------------------------------------------------------
+HistogramScheduler::~HistogramScheduler()
+{
+  foreach (HistogramJob* job, this->Internals->Jobs)
+    {
+    job->cancel();
+    }
+  foreach (JointHistogramJob* job, this->Internals->JointJobs)
+    {
+    job->cancel();
+    }
+  this->Internals->Pool.waitForDone();
+}
+
+//-----------------------------------------------------------------------------
+HistogramScheduler& HistogramScheduler::instance()
+{
+  static HistogramScheduler theInstance;
+  return theInstance;
+}
+
+//-----------------------------------------------------------------------------
+QThreadPool* HistogramScheduler::threadPool() const
+{
+  return &this->Internals->Pool;
+}
+
+//-----------------------------------------------------------------------------
+void HistogramScheduler::request(DataSource* source, int numberOfBins)
+{
+  if (!source || numberOfBins < 1)
+    {
+    return;
+    }
+
+  const unsigned long version = source->dataVersion();
+  if (this->Internals->find(source, version, numberOfBins) >= 0)
+    {
+    return;
+    }
+  const HSInternals::JobKey key(source, numberOfBins);
+  HistogramJob* current = this->Internals->Jobs.value(key, NULL);
+  if (current)
+    {
+    if (current->Version == version)
+      {
+      return;
+      }
+    this->Internals->Jobs.remove(key);
+    current->cancel();
+    }
+
+  vtkImageData* data = imageData(source);
+  if (!data || !data->GetPointData()->GetScalars())
+    {
+    return;
+    }
+
+  // When only part of the data changed since a cached histogram was
+  // computed, e.g. it was cropped, only the bricks that changed are counted.
+  BrickHistograms* bricks = NULL;
+  unsigned long previousVersion;
+  int modifiedExtent[6];
+  if (source->lastModification(previousVersion, modifiedExtent))
+    {
+    int index = this->Internals->find(source, previousVersion, numberOfBins);
+    if (index >= 0 && this->Internals->Cache[index].Bricks)
+      {
+      bricks = this->Internals->Cache[index].Bricks->updated(
+        data->GetExtent(), modifiedExtent);
+      }
+    }
+
+  double range[2];
+  const bool hasRange = this->dataRange(source, range);
+  HistogramJob* job = new HistogramJob(source, data, numberOfBins,
+                                       hasRange ? range : NULL, bricks);
+  this->connect(job, SIGNAL(progress()), SLOT(jobProgress()));
+  this->connect(job, SIGNAL(finished()), SLOT(jobFinished()));
+  this->Internals->Jobs[key] = job;
+
+  // Restart jobs and invalidate the cache whenever the data changes.
+  this->connect(source, SIGNAL(dataChanged()), SLOT(dataSourceChanged()),
+                Qt::UniqueConnection);
+  this->connect(source, SIGNAL(destroyed(QObject*)),
+                SLOT(dataSourceDestroyed(QObject*)), Qt::UniqueConnection);
+
+  this->Internals->Pool.start(job);
+}
+
+//-----------------------------------------------------------------------------
+bool HistogramScheduler::dataRange(DataSource* source, double range[2]) const
+{
+  // The range is usually already known, from a cached histogram or from the
+  // data information gathered when the pipeline updated, which saves a full
+  // pass over the data.
+  if (this->cachedRange(source, range))
+    {
+    return true;
+    }
+  vtkPVArrayInformation* ainfo =
+      tomviz::scalarArrayInformation(source->producer());
+  if (ainfo && ainfo->GetNumberOfComponents() == 1)
+    {
+    ainfo->GetComponentRange(0, range);
+    return true;
+    }
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+void HistogramScheduler::requestJoint(DataSource* first, DataSource* second,
+                                      int numberOfBins)
+{
+  if (!first || !second || numberOfBins < 1 ||
+      this->Internals->findJoint(first, second, numberOfBins) >= 0)
+    {
+    return;
+    }
+  const HSInternals::JointKey key(first, second);
+  JointHistogramJob* current = this->Internals->JointJobs.value(key, NULL);
+  if (current)
+    {
+    if (current->NumberOfBins == numberOfBins &&
+        current->FirstVersion == first->dataVersion() &&
+        current->SecondVersion == second->dataVersion())
+      {
+      return;
+      }
+    this->Internals->JointJobs.remove(key);
+    current->cancel();
+    }
+
+  // Voxels are paired by index, so the extents must match.
+  vtkImageData* firstData = imageData(first);
+  vtkImageData* secondData = imageData(second);
+  if (!firstData || !secondData ||
+      !std::equal(firstData->GetExtent(), firstData->GetExtent() + 6,
+                  secondData->GetExtent()))
+    {
+    return;
+    }
+  vtkDataArray* firstScalars = firstData->GetPointData()->GetScalars();
+  vtkDataArray* secondScalars = secondData->GetPointData()->GetScalars();
+  if (!firstScalars || !secondScalars ||
+      firstScalars->GetNumberOfComponents() != 1 ||
+      secondScalars->GetNumberOfComponents() != 1 ||
+      firstScalars->GetNumberOfTuples() != secondScalars->GetNumberOfTuples())
+    {
+    return;
+    }
+
+  double ranges[4];
+  const bool hasFirstRange = this->dataRange(first, ranges);
+  const bool hasSecondRange = this->dataRange(second, ranges + 2);
+  JointHistogramJob* job = new JointHistogramJob(
+    first, second, firstScalars, secondScalars, numberOfBins,
+    hasFirstRange ? ranges : NULL, hasSecondRange ? ranges + 2 : NULL);
+  this->connect(job, SIGNAL(finished()), SLOT(jointJobFinished()));
+  this->Internals->JointJobs[key] = job;
+
+  DataSource* sources[2] = { first, second };
+  for (int i = 0; i < 2; ++i)
+    {
+    this->connect(sources[i], SIGNAL(dataChanged()),
+                  SLOT(dataSourceChanged()), Qt::UniqueConnection);
+    this->connect(sources[i], SIGNAL(destroyed(QObject*)),
+                  SLOT(dataSourceDestroyed(QObject*)), Qt::UniqueConnection);
+    }
+
+  this->Internals->Pool.start(job);
+}
+
+//-----------------------------------------------------------------------------
+vtkImageData* HistogramScheduler::jointHistogram(DataSource* first,
+                                                 DataSource* second,
+                                                 int numberOfBins)
+{
+  if (!first || !second)
+    {
+    return NULL;
+    }
+  int index = this->Internals->findJoint(first, second, numberOfBins);
+  if (index < 0)
+    {
+    return NULL;
+    }
+  this->Internals->JointCache.move(index, 0);
+  return this->Internals->JointCache.first().Histogram;
+}
+
+//-----------------------------------------------------------------------------
+void HistogramScheduler::cancel(DataSource* source)
+{
+  // Jobs are deleted in jobFinished() once they stop running.
+  QMap<HSInternals::JobKey, HistogramJob*>::iterator iter =
+      this->Internals->Jobs.begin();
+  while (iter != this->Internals->Jobs.end())
+    {
+    if (iter.key().first == source)
+      {
+      iter.value()->cancel();
+      iter = this->Internals->Jobs.erase(iter);
+      }
+    else
+      {
+      ++iter;
+      }
+    }
+  QMap<HSInternals::JointKey, JointHistogramJob*>::iterator jointIter =
+      this->Internals->JointJobs.begin();
+  while (jointIter != this->Internals->JointJobs.end())
+    {
+    if (jointIter.key().first == source || jointIter.key().second == source)
+      {
+      jointIter.value()->cancel();
+      jointIter = this->Internals->JointJobs.erase(jointIter);
+      }
+    else
+      {
+      ++jointIter;
+      }
+    }
+}
+
+//-----------------------------------------------------------------------------
+bool HistogramScheduler::isPending(DataSource* source, int numberOfBins) const
+{
+  return this->Internals->Jobs.contains(
+    HSInternals::JobKey(source, numberOfBins));
+}
+
+//-----------------------------------------------------------------------------
+vtkTable* HistogramScheduler::histogram(DataSource* source, int numberOfBins)
+{
+  if (!source)
+    {
+    return NULL;
+    }
+  int index =
+      this->Internals->find(source, source->dataVersion(), numberOfBins);
+  if (index < 0)
+    {
+    return NULL;
+    }
+  // Move the entry to the front, it is the most recently used.
+  this->Internals->Cache.move(index, 0);
+  return this->Internals->Cache.first().Table;
+}
+
+//-----------------------------------------------------------------------------
+bool HistogramScheduler::cachedRange(DataSource* source, double range[2]) const
+{
+  ScalarStatistics stats;
+  if (!this->statistics(source, stats))
+    {
+    return false;
+    }
+  range[0] = stats.minimum();
+  range[1] = stats.maximum();
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool HistogramScheduler::statistics(DataSource* source,
+                                    ScalarStatistics& stats) const
+{
+  if (!source)
+    {
+    return false;
+    }
+  // Use the entry with the most bins, for the best percentile estimates.
+  const unsigned long version = source->dataVersion();
+  const HSInternals::CacheEntry* best = NULL;
+  foreach (const HSInternals::CacheEntry& entry, this->Internals->Cache)
+    {
+    if (entry.Source == source && entry.Version == version &&
+        (!best || entry.NumberOfBins > best->NumberOfBins))
+      {
+      best = &entry;
+      }
+    }
+  if (!best)
+    {
+    return false;
+    }
+  stats = best->Statistics;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+void HistogramScheduler::setMaximumCacheSize(int count)
+{
+  this->Internals->MaximumCacheSize = std::max(0, count);
+  this->Internals->trim();
+}
+
+//-----------------------------------------------------------------------------
+int HistogramScheduler::maximumCacheSize() const
+{
+  return this->Internals->MaximumCacheSize;
+}
+
+//-----------------------------------------------------------------------------
+void HistogramScheduler::clearCache()
+{
+  this->Internals->Cache.clear();
+  this->Internals->JointCache.clear();
+}
+
+//-----------------------------------------------------------------------------
+void HistogramScheduler::jobProgress()
+{
+  HistogramJob* job = qobject_cast<HistogramJob*>(this->sender());
+  if (!job || job->isCancelled() ||
+      this->Internals->Jobs.value(
+        HSInternals::JobKey(job->Source, job->NumberOfBins), NULL) != job)
+    {
+    return;
+    }
+  vtkSmartPointer<vtkTable> table = job->takeProgress();
+  if (table)
+    {
+    emit this->histogramProgress(job->Source, table);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void HistogramScheduler::jobFinished()
+{
+  HistogramJob* job = qobject_cast<HistogramJob*>(this->sender());
+  if (!job)
+    {
+    return;
+    }
+  const HSInternals::JobKey key(job->Source, job->NumberOfBins);
+  if (!job->isCancelled() && this->Internals->Jobs.value(key, NULL) == job)
+    {
+    this->Internals->Jobs.remove(key);
+    if (job->result()->GetNumberOfColumns() == 0)
+      {
+      // Unsupported scalar type, nothing was computed.
+      job->deleteLater();
+      return;
+      }
+    HSInternals::CacheEntry entry;
+    entry.Source = job->Source;
+    entry.Version = job->Version;
+    entry.NumberOfBins = job->NumberOfBins;
+    entry.Statistics = job->statistics();
+    entry.Table = job->result();
+    entry.Bricks = job->bricks();
+    this->Internals->insert(entry);
+    emit this->histogramReady(job->Source, job->result());
+    }
+  job->deleteLater();
+}
+
+//-----------------------------------------------------------------------------
+void HistogramScheduler::jointJobFinished()
+{
+  JointHistogramJob* job = qobject_cast<JointHistogramJob*>(this->sender());
+  if (!job)
+    {
+    return;
+    }
+  const HSInternals::JointKey key(job->First, job->Second);
+  if (!job->isCancelled() &&
+      this->Internals->JointJobs.value(key, NULL) == job)
+    {
+    this->Internals->JointJobs.remove(key);
+    if (job->result()->GetPointData()->GetScalars())
+      {
+      HSInternals::JointCacheEntry entry;
+      entry.First = job->First;
+      entry.FirstVersion = job->FirstVersion;
+      entry.Second = job->Second;
+      entry.SecondVersion = job->SecondVersion;
+      entry.NumberOfBins = job->NumberOfBins;
+      entry.Histogram = job->result();
+      this->Internals->JointCache.prepend(entry);
+      this->Internals->trim();
+      emit this->jointHistogramReady(job->First, job->Second, job->result());
+      }
+    }
+  job->deleteLater();
+}
+
+//-----------------------------------------------------------------------------
+void HistogramScheduler::dataSourceChanged()
+{
+  DataSource* source = qobject_cast<DataSource*>(this->sender());
+  if (!source)
+    {
+    return;
+    }
+
+  // Restart the jobs for the source, and update the histograms that only
+  // need a few bricks counted again, before the old versions are dropped.
+  QList<int> binCounts;
+  foreach (const HSInternals::JobKey& key, this->Internals->Jobs.keys())
+    {
+    if (key.first == source)
+      {
+      binCounts.append(key.second);
+      }
+    }
+  unsigned long previousVersion;
+  int modifiedExtent[6];
+  if (source->lastModification(previousVersion, modifiedExtent))
+    {
+    foreach (const HSInternals::CacheEntry& entry, this->Internals->Cache)
+      {
+      if (entry.Source == source && entry.Version == previousVersion &&
+          entry.Bricks && !binCounts.contains(entry.NumberOfBins))
+        {
+        binCounts.append(entry.NumberOfBins);
+        }
+      }
+    }
+  foreach (int numberOfBins, binCounts)
+    {
+    this->request(source, numberOfBins);
+    }
+
+  QList<JointHistogramJob*> jointJobs;
+  foreach (JointHistogramJob* job, this->Internals->JointJobs)
+    {
+    if (job->First == source || job->Second == source)
+      {
+      jointJobs.append(job);
+      }
+    }
+  foreach (JointHistogramJob* job, jointJobs)
+    {
+    this->requestJoint(job->First, job->Second, job->NumberOfBins);
+    }
+  this->Internals->drop(source, true);
+}
+
+//-----------------------------------------------------------------------------
+void HistogramScheduler::dataSourceDestroyed(QObject* source)
+{
+  // Only the address is used, the DataSource is already partly destroyed.
+  DataSource* dataSource = static_cast<DataSource*>(source);
+  this->cancel(dataSource);
+  this->Internals->drop(dataSource, false);
+}
+
+}
+
+#include "HistogramScheduler.moc"
@@ -0,0 +1,147 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizHistogramScheduler_h
+#define tomvizHistogramScheduler_h
+
+#include <QObject>
+#include <QScopedPointer>
+
+class QThreadPool;
+class vtkImageData;
+class vtkTable;
+
+namespace tomviz
+{
+class DataSource;
+class ScalarStatistics;
+
+/// HistogramScheduler computes the histograms of DataSources in the
+/// background, on a thread pool shared by all DataSources so several can be
+/// computed at once. Only the latest request for each DataSource is
+/// computed: a job for older data is cancelled, which it notices between
+/// chunks of the volume, and a job whose DataSource's data changes is
+/// restarted on the new data. Results are delivered through signals on the
+/// GUI thread as tables with the bin centers in "image_extents" and the
+/// counts in "image_pops".
+///
+/// Finished histograms are kept in a bounded least recently used cache, keyed
+/// by DataSource, data version and number of bins. Entries for old versions
+/// are dropped when a DataSource's data changes, and all of its entries when
+/// it is destroyed.
+///
+/// Histograms are counted per brick of the volume. When the data changes only
+/// in part, as DataSource::lastModification() reports after a crop or a
+/// region edit, the cached histograms of the previous version are updated by
+/// counting only the bricks that changed. The per-brick counts are kept for
+/// the most recently used histograms only, up to 256 MB, and the others are
+/// counted in full after a change.
+///
+/// Joint histograms of pairs of DataSources are computed and cached the
+/// same way, to compare two reconstructions, or a reconstruction and its
+/// segmentation.
+class HistogramScheduler : public QObject
+{
+  Q_OBJECT
+  typedef QObject Superclass;
+
+public:
+  enum { DefaultNumberOfBins = 256, DefaultJointNumberOfBins = 128 };
+
+  /// Returns reference to the singleton instance.
+  static HistogramScheduler& instance();
+
+  /// Request the histogram of the source's current data. This does nothing
+  /// if that version of the data is already cached or being computed.
+  void request(DataSource* source, int numberOfBins = DefaultNumberOfBins);
+
+  /// Cancel any histogram being computed for the source.
+  void cancel(DataSource* source);
+
+  /// Returns true if a histogram is being computed for the source.
+  bool isPending(DataSource* source, int numberOfBins = DefaultNumberOfBins) const;
+
+  /// Returns the cached histogram of the source's current data, or NULL.
+  vtkTable* histogram(DataSource* source, int numberOfBins = DefaultNumberOfBins);
+
+  /// Get the scalar range of the source's current data from any cached
+  /// histogram of it. Returns false if there is none.
+  bool cachedRange(DataSource* source, double range[2]) const;
+
+  /// Get the statistics (range, mean, variance, percentiles) of the source's
+  /// current data, computed along with its histogram. Returns false if no
+  /// histogram of the current data is cached, request() one first.
+  bool statistics(DataSource* source, ScalarStatistics& stats) const;
+
+  /// Request the joint histogram of the current data of two sources with the
+  /// same extent, pairing their voxels by index. It is an image of
+  /// numberOfBins x numberOfBins counts ("joint_pops") with the first source's
+  /// values along x and the second's along y, whose origin is the center of
+  /// the first bins and spacing the bin widths. This does nothing if it is
+  /// already cached or being computed, or the extents differ.
+  void requestJoint(DataSource* first, DataSource* second,
+                    int numberOfBins = DefaultJointNumberOfBins);
+
+  /// Returns the cached joint histogram of the sources' current data, or
+  /// NULL.
+  vtkImageData* jointHistogram(DataSource* first, DataSource* second,
+                               int numberOfBins = DefaultJointNumberOfBins);
+
+  /// The maximum number of histograms, and of joint histograms, kept in the
+  /// cache, 32 by default.
+  void setMaximumCacheSize(int count);
+  int maximumCacheSize() const;
+
+  /// Drop all cached histograms and joint histograms.
+  void clearCache();
+
+  /// The pool the histogram jobs run on.
+  QThreadPool* threadPool() const;
+
+signals:
+  /// An estimate of the source's histogram, from a sample of the voxels or
+  /// from the part of the volume binned so far.
+  void histogramProgress(DataSource* source, vtkTable* histogram);
+
+  /// The final histogram of the source's data. Keep a reference to the table
+  /// to use it after the signal returns.
+  void histogramReady(DataSource* source, vtkTable* histogram);
+
+  /// The final joint histogram of two sources' data.
+  void jointHistogramReady(DataSource* first, DataSource* second,
+                           vtkImageData* histogram);
+
+private slots:
+  void jobProgress();
+  void jobFinished();
+  void jointJobFinished();
+  void dataSourceChanged();
+  void dataSourceDestroyed(QObject* source);
+
+private:
+  Q_DISABLE_COPY(HistogramScheduler)
+  HistogramScheduler(QObject* parent=NULL);
+  ~HistogramScheduler();
+
+  /// Get the range of the source's data without a pass over it, if known.
+  bool dataRange(DataSource* source, double range[2]) const;
+
+  class HSInternals;
+  const QScopedPointer<HSInternals> Internals;
+};
+
+}
+
+#endif
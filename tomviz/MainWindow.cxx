@@ -31,7 +31,9 @@
 #include "tomvizConfig.h"
 #include "ActiveObjects.h"
 #include "AddAlignReaction.h"
+#include "AddBackgroundSubtractReaction.h"
 #include "AddExpressionReaction.h"
+#include "AddFFTReaction.h"
 #include "AddPythonTransformReaction.h"
 #include "AddResampleReaction.h"
 #include "Behaviors.h"
@@ -52,10 +54,7 @@
 #include "Align_Images.h"
 #include "Recon_DFT.h"
 #include "Crop_Data.h"
-#include "FFT_AbsLog.h"
 #include "Shift_Stack_Uniformly.h"
-#include "Square_Root_Data.h"
-#include "Subtract_TiltSer_Background.h"
 #include "MisalignImgs_Gaussian.h"
 
 #include <QFileInfo>
@@ -124,7 +123,7 @@ MainWindow::MainWindow(QWidget* _parent, Qt::WindowFlags _flags)
    * Data Transforms
    *
    * Crop - Crop_Data.py
-   * Background subtraction - Subtract_TiltSer_Background.py
+   * Background subtraction - BackgroundSubtractOperator
    * ---
    * Manual Align
    * Auto Align (XCORR) - Align_Images.py
@@ -134,8 +133,8 @@ MainWindow::MainWindow(QWidget* _parent, Qt::WindowFlags _flags)
    * ---
    * Reconstruct (Direct Fourier) - Recon_DFT.py
    * ---
-   * Square Root Data - Square_Root_Data.py
-   * FFT (ABS LOG) - FFT_AbsLog.py
+   * Square Root Data - ExpressionOperator sqrt(x)
+   * FFT (ABS LOG) - FFTOperator
    * ---
    * Clone
    * Delete
@@ -148,7 +147,7 @@ MainWindow::MainWindow(QWidget* _parent, Qt::WindowFlags _flags)
 
   QAction *customPythonAction = new QAction("Custom Transform", this);
   QAction *cropDataAction = new QAction("Crop", this);
-  //QAction *backgroundSubtractAction = new QAction("Background Subtraction", this);
+  QAction *backgroundSubtractAction = new QAction("Background Subtraction", this);
   QAction *autoAlignAction = new QAction("Auto Align (xcorr)", this);
   QAction *shiftUniformAction = new QAction("Shift Uniformly", this);
   //QAction *misalignUniformAction = new QAction("Misalign (Uniform)", this);
@@ -160,7 +159,7 @@ MainWindow::MainWindow(QWidget* _parent, Qt::WindowFlags _flags)
   ui.menuData->insertAction(ui.actionAlign, customPythonAction);
   ui.menuData->insertAction(ui.actionAlign, cropDataAction);
   ui.menuData->insertSeparator(ui.actionAlign);
-  //ui.menuData->insertAction(ui.actionAlign, backgroundSubtractAction);
+  ui.menuData->insertAction(ui.actionAlign, backgroundSubtractAction);
   ui.menuData->insertSeparator(ui.actionAlign);
   ui.menuData->insertAction(ui.actionReconstruct, autoAlignAction);
   ui.menuData->insertAction(ui.actionReconstruct, shiftUniformAction);
@@ -177,9 +176,7 @@ MainWindow::MainWindow(QWidget* _parent, Qt::WindowFlags _flags)
   new AddExpressionReaction(customPythonAction);
   new CropReaction(cropDataAction, this);
   //new AddResampleReaction(resampleDataAction);
-  //new AddPythonTransformReaction(backgroundSubtractAction,
-  //                               "Background Subtraction",
-  //                               Subtract_TiltSer_Background);
+  new AddBackgroundSubtractReaction(backgroundSubtractAction);
   ui.actionAlign->setText("Manual Align");
   new AddPythonTransformReaction(autoAlignAction,
                                  "Auto Align (XCORR)", Align_Images);
@@ -193,10 +190,8 @@ MainWindow::MainWindow(QWidget* _parent, Qt::WindowFlags _flags)
   new AddPythonTransformReaction(ui.actionReconstruct,
                                  "Reconstruct (Direct Fourier)",
                                  Recon_DFT);
-  new AddPythonTransformReaction(squareRootAction,
-                                 "Square Root Data", Square_Root_Data);
-  new AddPythonTransformReaction(fftAbsLogAction,
-                                 "FFT (ABS LOG)", FFT_AbsLog);
+  new AddExpressionReaction(squareRootAction, "Square Root Data", "sqrt(x)");
+  new AddFFTReaction(fftAbsLogAction);
 
   new ModuleMenu(ui.modulesToolbar, ui.menuModules, this);
   new RecentFilesMenu(*ui.menuRecentlyOpened, ui.menuRecentlyOpened);
@@ -17,6 +17,7 @@
 
 #include "ActiveObjects.h"
 #include "DataSource.h"
+#include "HistogramScheduler.h"
 #include "pqProxiesWidget.h"
 #include "pqView.h"
 #include "Utilities.h"
@@ -68,8 +69,12 @@ public:
 //-----------------------------------------------------------------------------
 Module::Module(QObject* parentObject) : Superclass(parentObject),
   UseDetachedColorMap(false),
+  UsePercentileColorMapRange(false),
   Internals(new Module::MInternals())
 {
+  this->connect(&HistogramScheduler::instance(),
+                SIGNAL(histogramReady(DataSource*, vtkTable*)),
+                SLOT(histogramReady(DataSource*)));
 }
 
 //-----------------------------------------------------------------------------
@@ -87,6 +92,8 @@ bool Module::initialize(DataSource* dataSource, vtkSMViewProxy* view)
     // FIXME: we're connecting this too many times. Fix it.
     tomviz::convert<pqView*>(view)->connect(
       this->ADataSource, SIGNAL(dataChanged()), SLOT(render()));
+    tomviz::convert<pqView*>(view)->connect(
+      this->ADataSource, SIGNAL(colorMapRescaled()), SLOT(render()));
     }
   return (this->View && this->ADataSource);
 }
@@ -135,7 +142,7 @@ void Module::setUseDetachedColorMap(bool val)
     this->Internals->ColorMap = this->Internals->detachedColorMap();
     this->Internals->OpacityMap = this->Internals->detachedOpacityMap();
 
-    tomviz::rescaleColorMap(this->Internals->ColorMap, this->dataSource());
+    this->rescaleDetachedColorMap();
     }
   else
     {
@@ -145,6 +152,40 @@ void Module::setUseDetachedColorMap(bool val)
   this->updateColorMap();
 }
 
+//-----------------------------------------------------------------------------
+void Module::setUsePercentileColorMapRange(bool val)
+{
+  if (this->UsePercentileColorMapRange != val)
+    {
+    this->UsePercentileColorMapRange = val;
+    this->rescaleDetachedColorMap();
+    }
+}
+
+//-----------------------------------------------------------------------------
+bool Module::rescaleDetachedColorMap()
+{
+  if (!this->UseDetachedColorMap || !this->Internals->ColorMap ||
+      !this->dataSource())
+    {
+    return false;
+    }
+  // the data source's percentiles apply to detached color maps too.
+  return tomviz::rescaleColorMap(this->Internals->ColorMap, this->dataSource(),
+    this->UsePercentileColorMapRange?
+    this->dataSource()->colorMapPercentiles() : NULL);
+}
+
+//-----------------------------------------------------------------------------
+void Module::histogramReady(DataSource* source)
+{
+  if (source == this->dataSource() && this->UsePercentileColorMapRange &&
+      this->rescaleDetachedColorMap())
+    {
+    tomviz::convert<pqView*>(this->view())->render();
+    }
+}
+
 //-----------------------------------------------------------------------------
 vtkSMProxy* Module::colorMap() const
 {
@@ -166,6 +207,8 @@ bool Module::serialize(pugi::xml_node& ns) const
   if (this->isColorMapNeeded())
     {
     ns.append_attribute("use_detached_colormap").set_value(this->UseDetachedColorMap? 1 : 0);
+    ns.append_attribute("use_percentile_range").set_value(
+      this->UsePercentileColorMapRange? 1 : 0);
     if (this->UseDetachedColorMap)
       {
       pugi::xml_node nodeL = ns.append_child("ColorMap");
@@ -188,6 +231,8 @@ bool Module::deserialize(const pugi::xml_node& ns)
   if (this->isColorMapNeeded())
     {
     bool dcm = ns.attribute("use_detached_colormap").as_int(0) == 1;
+    this->UsePercentileColorMapRange =
+      ns.attribute("use_percentile_range").as_int(0) == 1;
     if (dcm && ns.child("ColorMap"))
       {
       if (!tomviz::deserialize(this->Internals->detachedColorMap(), ns.child("ColorMap")))
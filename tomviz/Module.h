@@ -76,6 +76,13 @@ public:
   void setUseDetachedColorMap(bool);
   bool useDetachedColorMap() const { return this->UseDetachedColorMap; }
 
+  /// Flag indicating whether the detached color map is rescaled to the
+  /// 0.1-99.9 percentiles of the data, estimated from its cached histogram,
+  /// rather than to its full range. See DataSource::colorMapPercentiles().
+  void setUsePercentileColorMapRange(bool);
+  bool usePercentileColorMapRange() const
+    { return this->UsePercentileColorMapRange; }
+
 public slots:
   /// Set the visibility for this module. Subclasses should override this method
   /// show/hide all representations created for this module.
@@ -104,11 +111,18 @@ protected:
   vtkSMProxy* colorMap() const;
   vtkSMProxy* opacityMap() const;
 
+private slots:
+  /// re-apply the percentile range once the data's histogram is computed.
+  void histogramReady(DataSource* source);
+
 private:
+  bool rescaleDetachedColorMap();
+
   Q_DISABLE_COPY(Module)
   QPointer<DataSource> ADataSource;
   vtkWeakPointer<vtkSMViewProxy> View;
   bool UseDetachedColorMap;
+  bool UsePercentileColorMapRange;
 
   class MInternals;
   const QScopedPointer<MInternals> Internals;
@@ -79,6 +79,12 @@ bool ModuleContour::initialize(DataSource* dataSource, vtkSMViewProxy* view)
   Q_ASSERT(this->ContourRepresentation);
   vtkSMPropertyHelper(this->ContourRepresentation, "Representation").Set("Surface");
 
+  double value;
+  if (tomviz::initialContourValue(dataSource, value))
+    {
+    this->setIsoValue(value);
+    }
+
   // use proper color map.
   this->updateColorMap();
 
@@ -106,6 +106,20 @@ void ModuleManager::removeAllDataSources()
   this->Internals->DataSources.clear();
 }
 
+//-----------------------------------------------------------------------------
+QList<DataSource*> ModuleManager::dataSources() const
+{
+  QList<DataSource*> sources;
+  foreach (DataSource* dataSource, this->Internals->DataSources)
+    {
+    if (dataSource)
+      {
+      sources.push_back(dataSource);
+      }
+    }
+  return sources;
+}
+
 //-----------------------------------------------------------------------------
 void ModuleManager::addModule(Module* module)
 {
@@ -57,6 +57,9 @@ public:
     return modulesT;
     }
 
+  /// Returns the registered data sources.
+  QList<DataSource*> dataSources() const;
+
   /// save the application state as xml.
   bool serialize(pugi::xml_node& ns) const;
   bool deserialize(const pugi::xml_node& ns);
@@ -58,6 +58,8 @@ ModulePropertiesPanel::ModulePropertiesPanel(QWidget* parentObject)
 
   this->connect(ui.DetachColorMap, SIGNAL(clicked(bool)),
                 SLOT(detachColorMap(bool)));
+  this->connect(ui.PercentileColorMapRange, SIGNAL(clicked(bool)),
+                SLOT(usePercentileColorMapRange(bool)));
 }
 
 //-----------------------------------------------------------------------------
@@ -72,6 +74,7 @@ void ModulePropertiesPanel::setModule(Module* module)
   Ui::ModulePropertiesPanel& ui = this->Internals->Ui;
   ui.ProxiesWidget->clear();
   ui.DetachColorMap->setVisible(false);
+  ui.PercentileColorMapRange->setVisible(false);
   if (module)
     {
     module->addToPanel(ui.ProxiesWidget);
@@ -79,6 +82,9 @@ void ModulePropertiesPanel::setModule(Module* module)
       {
       ui.DetachColorMap->setVisible(true);
       ui.DetachColorMap->setChecked(module->useDetachedColorMap());
+      ui.PercentileColorMapRange->setVisible(module->useDetachedColorMap());
+      ui.PercentileColorMapRange->setChecked(
+        module->usePercentileColorMapRange());
       }
     }
   ui.ProxiesWidget->updateLayout();
@@ -130,4 +136,15 @@ void ModulePropertiesPanel::detachColorMap(bool val)
     }
 }
 
+//-----------------------------------------------------------------------------
+void ModulePropertiesPanel::usePercentileColorMapRange(bool val)
+{
+  Module* module = this->Internals->ActiveModule;
+  if (module)
+    {
+    module->setUsePercentileColorMapRange(val);
+    this->render();
+    }
+}
+
 }
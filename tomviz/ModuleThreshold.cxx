@@ -138,6 +138,14 @@ bool ModuleThreshold::visibility() const
                              "Visibility").GetAsInt() != 0;
 }
 
+//-----------------------------------------------------------------------------
+void ModuleThreshold::setThresholdRange(const double range[2])
+{
+  Q_ASSERT(this->ThresholdFilter);
+  vtkSMPropertyHelper(this->ThresholdFilter, "ThresholdBetween").Set(range, 2);
+  this->ThresholdFilter->UpdateVTKObjects();
+}
+
 //-----------------------------------------------------------------------------
 void ModuleThreshold::addToPanel(pqProxiesWidget* panel)
 {
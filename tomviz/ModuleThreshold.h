@@ -45,6 +45,9 @@ public:
   virtual bool deserialize(const pugi::xml_node& ns);
   virtual bool isColorMapNeeded() const { return true; }
 
+  /// Set the range of values to keep.
+  void setThresholdRange(const double range[2]);
+
 protected:
   virtual void updateColorMap();
 
@@ -43,6 +43,12 @@ public:
   /// Method to transform a dataset in-place.
   virtual bool transform(vtkDataObject* data)=0;
 
+  /// Operators that modify only part of the data should return the extent of
+  /// the voxels changed by the last transform(), so that data derived from
+  /// it, such as histograms, is only updated there. The default returns
+  /// false, i.e. all of the data may have changed.
+  virtual bool modifiedExtent(int* /*extent*/) const { return false; }
+
   /// Return a new clone.
   virtual Operator* clone() const = 0;
 
@@ -0,0 +1,105 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "OperatorFactory.h"
+
+#include "BackgroundSubtractOperator.h"
+#include "ExpressionOperator.h"
+#include "FFTOperator.h"
+#include "OperatorPython.h"
+#include "TranslateAlignOperator.h"
+
+namespace tomviz
+{
+
+//-----------------------------------------------------------------------------
+OperatorFactory::OperatorFactory()
+{
+}
+
+//-----------------------------------------------------------------------------
+OperatorFactory::~OperatorFactory()
+{
+}
+
+//-----------------------------------------------------------------------------
+QList<QString> OperatorFactory::operatorTypes()
+{
+  QList<QString> reply;
+  reply << "Python"
+    << "TranslateAlign"
+    << "FFT"
+    << "BackgroundSubtract"
+    << "Expression";
+  return reply;
+}
+
+//-----------------------------------------------------------------------------
+Operator* OperatorFactory::createOperator(const QString& type)
+{
+  Operator* op = NULL;
+  if (type == "Python")
+    {
+    op = new OperatorPython();
+    }
+  else if (type == "TranslateAlign")
+    {
+    op = new TranslateAlignOperator();
+    }
+  else if (type == "FFT")
+    {
+    op = new FFTOperator();
+    }
+  else if (type == "BackgroundSubtract")
+    {
+    op = new BackgroundSubtractOperator();
+    }
+  else if (type == "Expression")
+    {
+    op = new ExpressionOperator();
+    }
+
+  // sanity check.
+  Q_ASSERT(op == NULL || type == operatorType(op));
+  return op;
+}
+
+//-----------------------------------------------------------------------------
+const char* OperatorFactory::operatorType(Operator* op)
+{
+  if (qobject_cast<OperatorPython*>(op))
+    {
+    return "Python";
+    }
+  if (qobject_cast<TranslateAlignOperator*>(op))
+    {
+    return "TranslateAlign";
+    }
+  if (qobject_cast<FFTOperator*>(op))
+    {
+    return "FFT";
+    }
+  if (qobject_cast<BackgroundSubtractOperator*>(op))
+    {
+    return "BackgroundSubtract";
+    }
+  if (qobject_cast<ExpressionOperator*>(op))
+    {
+    return "Expression";
+    }
+  return NULL;
+}
+
+} // end of namespace tomviz
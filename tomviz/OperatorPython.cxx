@@ -16,6 +16,9 @@
 #include "vtkPython.h"
 #include "OperatorPython.h"
 
+#include "FFTServicePython.h"
+#include "ScalarStatisticsPython.h"
+
 #include <QtDebug>
 
 #include "vtkDataObject.h"
@@ -107,6 +110,8 @@ OperatorPython::OperatorPython(QObject* parentObject) :
   Label("Python Operator")
 {
   vtkPythonInterpreter::Initialize();
+  initializeFFTPythonModule();
+  initializeStatisticsPythonModule();
   this->Internals->OperatorModule.TakeReference(PyImport_ImportModule("tomviz.utils"));
   if (!this->Internals->OperatorModule)
     {
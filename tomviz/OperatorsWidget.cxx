@@ -103,6 +103,12 @@ void OperatorsWidget::itemDoubleClicked(QTreeWidgetItem* item)
   QSharedPointer<Operator> op = this->Internals->ItemMap[item];
   Q_ASSERT(op);
 
+  // Only Python operators have an editable script.
+  if (!qobject_cast<OperatorPython*>(op.data()))
+    {
+    return;
+    }
+
   // Create a non-modal dialog, delete it once it has been closed.
   EditPythonOperatorDialog *dialog =
       new EditPythonOperatorDialog(op, pqCoreUtilities::mainWidget());
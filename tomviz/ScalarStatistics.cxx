@@ -0,0 +1,141 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "ScalarStatistics.h"
+
+#include "ComputeHistogram.h"
+
+#include <vtkDataArray.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+template<typename T>
+void computeStatistics(T* values, vtkIdType n, int numberOfBins,
+                       tomviz::ScalarStatistics& statistics)
+{
+  double range[2] = { 0.0, 0.0 };
+  tomviz::GetScalarRange(values, n, range);
+  double binsRange[2] = { range[0], range[1] };
+  if (binsRange[0] == binsRange[1])
+    {
+    binsRange[1] = binsRange[0] + 1.0;
+    }
+  std::vector<vtkIdType> pops(numberOfBins, 0);
+  double moments[3] = { 0.0, 0.0, 0.0 };
+  tomviz::CalculateHistogram(values, n, binsRange[0], &pops[0],
+                             (binsRange[1] - binsRange[0]) / numberOfBins,
+                             numberOfBins, moments);
+  statistics.set(range, binsRange, &pops[0], numberOfBins, moments);
+}
+
+}
+
+namespace tomviz
+{
+
+//-----------------------------------------------------------------------------
+ScalarStatistics::ScalarStatistics()
+  : Count(0), Mean(0.0), Variance(0.0)
+{
+  this->Range[0] = this->Range[1] = 0.0;
+  this->BinsRange[0] = this->BinsRange[1] = 0.0;
+}
+
+//-----------------------------------------------------------------------------
+double ScalarStatistics::standardDeviation() const
+{
+  return std::sqrt(this->Variance);
+}
+
+//-----------------------------------------------------------------------------
+double ScalarStatistics::percentile(double fraction) const
+{
+  vtkIdType total = 0;
+  for (size_t i = 0; i < this->Populations.size(); ++i)
+    {
+    total += this->Populations[i];
+    }
+  if (total == 0 || this->Range[0] == this->Range[1])
+    {
+    return this->Range[0];
+    }
+
+  const double target = std::min(1.0, std::max(0.0, fraction)) * total;
+  const double inc = (this->BinsRange[1] - this->BinsRange[0]) /
+                     this->Populations.size();
+  double cumulative = 0.0;
+  double value = this->Range[1];
+  for (size_t i = 0; i < this->Populations.size(); ++i)
+    {
+    const double pop = static_cast<double>(this->Populations[i]);
+    if (pop > 0 && cumulative + pop >= target)
+      {
+      value = this->BinsRange[0] + (i + (target - cumulative) / pop) * inc;
+      break;
+      }
+    cumulative += pop;
+    }
+  return std::min(this->Range[1], std::max(this->Range[0], value));
+}
+
+//-----------------------------------------------------------------------------
+void ScalarStatistics::set(const double range[2], const double binsRange[2],
+                           const vtkIdType* pops, int numberOfBins,
+                           const double moments[3])
+{
+  this->Range[0] = range[0];
+  this->Range[1] = range[1];
+  this->BinsRange[0] = binsRange[0];
+  this->BinsRange[1] = binsRange[1];
+  this->Populations.assign(pops, pops + numberOfBins);
+  this->Count = static_cast<vtkIdType>(moments[2]);
+  if (this->Count > 0)
+    {
+    const double shiftedMean = moments[0] / moments[2];
+    this->Mean = binsRange[0] + shiftedMean;
+    this->Variance = std::max(0.0, moments[1] / moments[2] -
+                                   shiftedMean * shiftedMean);
+    }
+  else
+    {
+    this->Mean = this->Variance = 0.0;
+    }
+}
+
+//-----------------------------------------------------------------------------
+bool ScalarStatistics::compute(vtkDataArray* scalars, int numberOfBins,
+                               ScalarStatistics& statistics)
+{
+  if (!scalars || scalars->GetNumberOfComponents() != 1 || numberOfBins < 1)
+    {
+    return false;
+    }
+  switch (scalars->GetDataType())
+    {
+    vtkTemplateMacro(
+      computeStatistics(static_cast<VTK_TT*>(scalars->GetVoidPointer(0)),
+                        scalars->GetNumberOfTuples(), numberOfBins,
+                        statistics));
+    default:
+      return false;
+    }
+  return true;
+}
+
+}
@@ -0,0 +1,79 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizScalarStatistics_h
+#define tomvizScalarStatistics_h
+
+#include <vtkType.h>
+
+#include <vector>
+
+class vtkDataArray;
+
+namespace tomviz
+{
+
+/// Summary statistics of the scalars of a volume: the range, mean, variance
+/// and a histogram from which percentiles are estimated. The mean and
+/// variance are accumulated in the same pass that bins the data.
+class ScalarStatistics
+{
+public:
+  ScalarStatistics();
+
+  /// Returns true once the statistics have been set.
+  bool isValid() const { return !this->Populations.empty(); }
+
+  /// Number of values, NaNs excluded.
+  vtkIdType count() const { return this->Count; }
+
+  double minimum() const { return this->Range[0]; }
+  double maximum() const { return this->Range[1]; }
+  double mean() const { return this->Mean; }
+  double variance() const { return this->Variance; }
+  double standardDeviation() const;
+
+  /// The histogram bins, evenly spanning histogramRange().
+  const std::vector<vtkIdType>& histogram() const { return this->Populations; }
+  const double* histogramRange() const { return this->BinsRange; }
+
+  /// Estimate the value below which the given fraction (0 to 1) of the values
+  /// lie, interpolating linearly within the histogram bins.
+  double percentile(double fraction) const;
+
+  /// Set the statistics from the result of CalculateHistogram() over all the
+  /// data. range is the exact range of the values, binsRange the range the
+  /// bins span and moments the moments accumulated relative to binsRange[0].
+  void set(const double range[2], const double binsRange[2],
+           const vtkIdType* pops, int numberOfBins, const double moments[3]);
+
+  /// Compute the statistics of a single component array, with one pass for
+  /// the range and one to bin the values. Returns false for unsupported
+  /// arrays.
+  static bool compute(vtkDataArray* scalars, int numberOfBins,
+                      ScalarStatistics& statistics);
+
+private:
+  vtkIdType Count;
+  double Range[2];
+  double Mean;
+  double Variance;
+  double BinsRange[2];
+  std::vector<vtkIdType> Populations;
+};
+
+}
+
+#endif
@@ -0,0 +1,157 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "vtkPython.h"
+#include "ScalarStatisticsPython.h"
+
+#include "DataSource.h"
+#include "HistogramScheduler.h"
+#include "ModuleManager.h"
+#include "ScalarStatistics.h"
+
+#include <vtkAlgorithm.h>
+#include <vtkDataArray.h>
+#include <vtkDataObject.h>
+#include <vtkPythonUtil.h>
+#include <vtkSMSourceProxy.h>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+PyObject* toDict(const tomviz::ScalarStatistics& stats)
+{
+  const int numberOfBins = static_cast<int>(stats.histogram().size());
+  PyObject* histogram = PyList_New(numberOfBins);
+  if (!histogram)
+    {
+    return NULL;
+    }
+  for (int i = 0; i < numberOfBins; ++i)
+    {
+    PyList_SET_ITEM(histogram, i,
+                    PyLong_FromLongLong(stats.histogram()[i]));
+    }
+  return Py_BuildValue("{s:L,s:d,s:d,s:d,s:d,s:N,s:(dd)}",
+                       "count", static_cast<PY_LONG_LONG>(stats.count()),
+                       "minimum", stats.minimum(),
+                       "maximum", stats.maximum(),
+                       "mean", stats.mean(),
+                       "variance", stats.variance(),
+                       "histogram", histogram,
+                       "histogram_range", stats.histogramRange()[0],
+                       stats.histogramRange()[1]);
+}
+
+//----------------------------------------------------------------------------
+PyObject* compute(PyObject*, PyObject* args)
+{
+  PyObject* object = NULL;
+  int numberOfBins = 256;
+  if (!PyArg_ParseTuple(args, "O|i:compute", &object, &numberOfBins))
+    {
+    return NULL;
+    }
+  vtkDataArray* scalars = vtkDataArray::SafeDownCast(
+    vtkPythonUtil::GetPointerFromObject(object, "vtkDataArray"));
+  if (!scalars)
+    {
+    PyErr_SetString(PyExc_TypeError, "expected a vtkDataArray");
+    return NULL;
+    }
+  if (numberOfBins < 1)
+    {
+    PyErr_SetString(PyExc_ValueError, "the number of bins must be positive");
+    return NULL;
+    }
+
+  tomviz::ScalarStatistics stats;
+  bool computed;
+  Py_BEGIN_ALLOW_THREADS
+  computed = tomviz::ScalarStatistics::compute(scalars, numberOfBins, stats);
+  Py_END_ALLOW_THREADS
+  if (!computed)
+    {
+    PyErr_SetString(PyExc_TypeError,
+                    "expected a single component array of a numeric type");
+    return NULL;
+    }
+
+  return toDict(stats);
+}
+
+//----------------------------------------------------------------------------
+PyObject* cached(PyObject*, PyObject* args)
+{
+  PyObject* object = NULL;
+  if (!PyArg_ParseTuple(args, "O:cached", &object))
+    {
+    return NULL;
+    }
+  vtkDataObject* data = vtkDataObject::SafeDownCast(
+    vtkPythonUtil::GetPointerFromObject(object, "vtkDataObject"));
+  if (!data)
+    {
+    PyErr_SetString(PyExc_TypeError, "expected a vtkDataObject");
+    return NULL;
+    }
+
+  // The statistics the histogram scheduler computed along with the
+  // histogram of the DataSource holding this data, if they are of its
+  // current version.
+  foreach (tomviz::DataSource* source,
+           tomviz::ModuleManager::instance().dataSources())
+    {
+    vtkAlgorithm* producer = vtkAlgorithm::SafeDownCast(
+      source->producer()->GetClientSideObject());
+    tomviz::ScalarStatistics stats;
+    if (producer && producer->GetOutputDataObject(0) == data &&
+        tomviz::HistogramScheduler::instance().statistics(source, stats))
+      {
+      return toDict(stats);
+      }
+    }
+  Py_RETURN_NONE;
+}
+
+PyMethodDef methods[] = {
+  { "compute", compute, METH_VARARGS,
+    "compute(array, bins=256)\n"
+    "Range, mean, variance and histogram of a single component vtkDataArray, "
+    "computed in parallel. Returns a dict." },
+  { "cached", cached, METH_VARARGS,
+    "cached(data)\n"
+    "The statistics cached for the current version of the data of a "
+    "DataSource, as a dict like compute() returns, or None." },
+  { NULL, NULL, 0, NULL }
+};
+
+}
+
+namespace tomviz
+{
+
+//----------------------------------------------------------------------------
+void initializeStatisticsPythonModule()
+{
+  static bool initialized = false;
+  if (initialized)
+    {
+    return;
+    }
+  initialized = Py_InitModule("_tomviz_statistics", methods) != NULL;
+}
+
+}
@@ -0,0 +1,279 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "TranslateAlignOperator.h"
+
+#include <vtkDataArray.h>
+#include <vtkDataObject.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+
+// Applies the offsets one slice at a time. Each output row is written exactly
+// once: a contiguous span is moved from the (shifted) input row, and only the
+// columns/rows exposed by the shift are zeroed. When input and output are the
+// same buffer the rows are visited in an order that never reads a row that was
+// already overwritten, so this is safe to run in-place.
+template<typename T>
+class ApplyOffsetsFunctor
+{
+public:
+  ApplyOffsetsFunctor(T* in, T* out, const int dims[3],
+                      const QVector<vtkVector2i>& offsets)
+    : In(in), Out(out), Offsets(offsets)
+  {
+    this->Dims[0] = dims[0];
+    this->Dims[1] = dims[1];
+    this->Dims[2] = dims[2];
+  }
+
+  void operator()(vtkIdType begin, vtkIdType end)
+  {
+    for (vtkIdType z = begin; z < end; ++z)
+      {
+      this->applySlice(z);
+      }
+  }
+
+private:
+  void applySlice(vtkIdType z)
+  {
+    const vtkIdType nx = this->Dims[0];
+    const vtkIdType ny = this->Dims[1];
+    const vtkIdType sliceSize = nx * ny;
+    T* in = this->In + z * sliceSize;
+    T* out = this->Out + z * sliceSize;
+
+    vtkVector2i offset(0, 0);
+    if (z < this->Offsets.size())
+      {
+      offset = this->Offsets[z];
+      }
+    const vtkIdType dx = offset[0];
+    const vtkIdType dy = offset[1];
+
+    if (dx == 0 && dy == 0)
+      {
+      if (in != out)
+        {
+        memcpy(out, in, sliceSize * sizeof(T));
+        }
+      return;
+      }
+
+    // The span of output columns that receive input pixels.
+    const vtkIdType xBegin = std::max<vtkIdType>(0, dx);
+    const vtkIdType xEnd = std::min<vtkIdType>(nx, nx + dx);
+    const vtkIdType span = xEnd - xBegin;
+
+    // Visit rows so that in-place shifts read source rows before they are
+    // overwritten: top-down when shifting up, bottom-up otherwise.
+    const bool descending = dy > 0;
+    for (vtkIdType i = 0; i < ny; ++i)
+      {
+      const vtkIdType y = descending ? ny - 1 - i : i;
+      const vtkIdType sourceY = y - dy;
+      T* outRow = out + y * nx;
+      if (sourceY < 0 || sourceY >= ny || span <= 0)
+        {
+        memset(outRow, 0, nx * sizeof(T));
+        continue;
+        }
+      const T* inRow = in + sourceY * nx;
+      // memmove, as the spans overlap when shifting in-place along x only.
+      memmove(outRow + xBegin, inRow + xBegin - dx, span * sizeof(T));
+      if (xBegin > 0)
+        {
+        memset(outRow, 0, xBegin * sizeof(T));
+        }
+      if (xEnd < nx)
+        {
+        memset(outRow + xEnd, 0, (nx - xEnd) * sizeof(T));
+        }
+      }
+  }
+
+  T* In;
+  T* Out;
+  vtkIdType Dims[3];
+  const QVector<vtkVector2i>& Offsets;
+};
+
+inline bool isZero(const vtkVector2i& offset)
+{
+  return offset[0] == 0 && offset[1] == 0;
+}
+
+template<typename T>
+void applyOffsets(T* in, T* out, const int dims[3],
+                  const QVector<vtkVector2i>& offsets)
+{
+  ApplyOffsetsFunctor<T> functor(in, out, dims, offsets);
+  vtkSMPTools::For(0, dims[2], functor);
+}
+
+}
+
+namespace tomviz
+{
+
+//-----------------------------------------------------------------------------
+TranslateAlignOperator::TranslateAlignOperator(QObject* parentObject)
+  : Superclass(parentObject), HasModifiedExtent(false)
+{
+}
+
+//-----------------------------------------------------------------------------
+TranslateAlignOperator::~TranslateAlignOperator()
+{
+}
+
+//-----------------------------------------------------------------------------
+QIcon TranslateAlignOperator::icon() const
+{
+  return QIcon(":/pqWidgets/Icons/pqTransform24.png");
+}
+
+//-----------------------------------------------------------------------------
+void TranslateAlignOperator::setOffsets(const QVector<vtkVector2i>& newOffsets)
+{
+  this->Offsets = newOffsets;
+  emit this->transformModified();
+}
+
+//-----------------------------------------------------------------------------
+bool TranslateAlignOperator::transform(vtkDataObject* data)
+{
+  this->HasModifiedExtent = false;
+  vtkImageData* image = vtkImageData::SafeDownCast(data);
+  if (!image ||
+      !TranslateAlignOperator::applyImageOffsets(image, image, this->Offsets))
+    {
+    return false;
+    }
+
+  // Slices without an offset are left as they were, so the change is limited
+  // to the slices between the first and last non-zero offsets.
+  int extent[6];
+  image->GetExtent(extent);
+  const int slices = std::min(extent[5] - extent[4] + 1,
+                              static_cast<int>(this->Offsets.size()));
+  int first = 0;
+  while (first < slices && isZero(this->Offsets[first]))
+    {
+    ++first;
+    }
+  int last = slices - 1;
+  while (last > first && isZero(this->Offsets[last]))
+    {
+    --last;
+    }
+  std::copy(extent, extent + 6, this->ModifiedExtent);
+  this->ModifiedExtent[4] = extent[4] + first;
+  this->ModifiedExtent[5] = extent[4] + last;
+  this->HasModifiedExtent = true;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool TranslateAlignOperator::modifiedExtent(int* extent) const
+{
+  if (!this->HasModifiedExtent)
+    {
+    return false;
+    }
+  std::copy(this->ModifiedExtent, this->ModifiedExtent + 6, extent);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool TranslateAlignOperator::applyImageOffsets(vtkImageData* input,
+                                               vtkImageData* output,
+                                               const QVector<vtkVector2i>& offs)
+{
+  vtkDataArray* inScalars = input ? input->GetPointData()->GetScalars() : NULL;
+  vtkDataArray* outScalars = output ? output->GetPointData()->GetScalars() : NULL;
+  if (!inScalars || !outScalars ||
+      inScalars->GetDataType() != outScalars->GetDataType() ||
+      inScalars->GetNumberOfTuples() != outScalars->GetNumberOfTuples() ||
+      inScalars->GetNumberOfComponents() != 1)
+    {
+    return false;
+    }
+
+  // We are assuming an image that begins at 0, 0, 0 in memory, the extent is
+  // only used for the dimensions.
+  int dims[3];
+  input->GetDimensions(dims);
+
+  switch (inScalars->GetDataType())
+    {
+    vtkTemplateMacro(
+      applyOffsets(static_cast<VTK_TT*>(inScalars->GetVoidPointer(0)),
+                   static_cast<VTK_TT*>(outScalars->GetVoidPointer(0)),
+                   dims, offs));
+    default:
+      return false;
+    }
+  outScalars->Modified();
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+Operator* TranslateAlignOperator::clone() const
+{
+  TranslateAlignOperator* newClone = new TranslateAlignOperator();
+  newClone->setOffsets(this->Offsets);
+  return newClone;
+}
+
+//-----------------------------------------------------------------------------
+bool TranslateAlignOperator::serialize(pugi::xml_node& ns) const
+{
+  ns.append_attribute("number_of_offsets").set_value(this->Offsets.size());
+  foreach (const vtkVector2i& offset, this->Offsets)
+    {
+    pugi::xml_node node = ns.append_child("Offset");
+    node.append_attribute("x").set_value(offset[0]);
+    node.append_attribute("y").set_value(offset[1]);
+    }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+bool TranslateAlignOperator::deserialize(const pugi::xml_node& ns)
+{
+  QVector<vtkVector2i> newOffsets;
+  for (pugi::xml_node node = ns.child("Offset"); node;
+       node = node.next_sibling("Offset"))
+    {
+    newOffsets.push_back(vtkVector2i(node.attribute("x").as_int(0),
+                                     node.attribute("y").as_int(0)));
+    }
+  if (newOffsets.size() != ns.attribute("number_of_offsets").as_int(-1))
+    {
+    return false;
+    }
+  this->setOffsets(newOffsets);
+  return true;
+}
+
+}
@@ -0,0 +1,81 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizTranslateAlignOperator_h
+#define tomvizTranslateAlignOperator_h
+
+#include "Operator.h"
+
+#include <QVector>
+#include <vtkVector.h>
+
+class vtkImageData;
+
+namespace tomviz
+{
+
+/// Operator that applies a per-slice (x, y) integer translation to an image
+/// stack, as produced by the manual alignment widget. Pixels shifted in from
+/// outside the image are set to zero.
+class TranslateAlignOperator : public Operator
+{
+  Q_OBJECT
+  typedef Operator Superclass;
+
+public:
+  TranslateAlignOperator(QObject* parent=NULL);
+  virtual ~TranslateAlignOperator();
+
+  virtual QString label() const { return "Translate Align"; }
+
+  /// Returns an icon to use for this operator.
+  virtual QIcon icon() const;
+
+  /// Method to transform a dataset in-place.
+  virtual bool transform(vtkDataObject* data);
+
+  /// Only the slices with a non-zero offset are changed, so this returns the
+  /// extent spanning them (empty when all offsets are zero).
+  virtual bool modifiedExtent(int* extent) const;
+
+  /// return a new clone.
+  virtual Operator* clone() const;
+
+  virtual bool serialize(pugi::xml_node& in) const;
+  virtual bool deserialize(const pugi::xml_node& ns);
+
+  /// Set the offsets, one per slice along the z axis.
+  void setOffsets(const QVector<vtkVector2i>& offsets);
+  const QVector<vtkVector2i>& offsets() const { return this->Offsets; }
+
+  /// Apply the offsets from the input image into the output image. The images
+  /// must have the same extent and scalar type, and may be the same image in
+  /// which case the offsets are applied in-place. Slices are processed in
+  /// parallel, rows are copied as contiguous spans and only the exposed
+  /// borders are zeroed.
+  static bool applyImageOffsets(vtkImageData* input, vtkImageData* output,
+                                const QVector<vtkVector2i>& offsets);
+
+private:
+  Q_DISABLE_COPY(TranslateAlignOperator)
+
+  QVector<vtkVector2i> Offsets;
+  int ModifiedExtent[6];
+  bool HasModifiedExtent;
+};
+
+}
+
+#endif
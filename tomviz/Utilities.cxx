@@ -16,6 +16,8 @@
 #include "Utilities.h"
 
 #include "DataSource.h"
+#include "HistogramScheduler.h"
+#include "ScalarStatistics.h"
 #include "vtkNew.h"
 #include "vtkPVArrayInformation.h"
 #include "vtkPVDataInformation.h"
@@ -112,21 +114,64 @@ vtkPVArrayInformation* scalarArrayInformation(vtkSMSourceProxy* proxy)
 
 
 //---------------------------------------------------------------------------
-bool rescaleColorMap(vtkSMProxy* colorMap, DataSource* dataSource)
+bool rescaleColorMap(vtkSMProxy* colorMap, DataSource* dataSource,
+                     const double* percentiles)
 {
   // rescale the color/opacity maps for the data source.
   vtkSMProxy* cmap = colorMap;
   vtkSMProxy* omap = vtkSMPropertyHelper(cmap, "ScalarOpacityFunction").GetAsProxy();
-  vtkPVArrayInformation* ainfo = tomviz::scalarArrayInformation(dataSource->producer());
-  if (ainfo != NULL && vtkSMPropertyHelper(cmap, "LockScalarRange").GetAsInt() == 0)
+  if (vtkSMPropertyHelper(cmap, "LockScalarRange").GetAsInt() != 0)
     {
+    return false;
+    }
+
+  // A cached histogram of the current data has the exact range and the
+  // percentiles, and saves gathering the data information.
+  HistogramScheduler& scheduler = HistogramScheduler::instance();
+  double range[2];
+  bool haveRange = false;
+  if (percentiles)
+    {
+    ScalarStatistics stats;
+    if (scheduler.statistics(dataSource, stats))
+      {
+      range[0] = stats.percentile(percentiles[0] / 100.0);
+      range[1] = stats.percentile(percentiles[1] / 100.0);
+      // nearly constant data has no useful percentile range.
+      haveRange = range[0] < range[1];
+      }
+    else
+      {
+      scheduler.request(dataSource);
+      }
+    }
+  if (!haveRange && !scheduler.cachedRange(dataSource, range))
+    {
+    vtkPVArrayInformation* ainfo =
+      tomviz::scalarArrayInformation(dataSource->producer());
+    if (ainfo == NULL)
+      {
+      return false;
+      }
     // assuming single component arrays.
     Q_ASSERT(ainfo->GetNumberOfComponents() == 1);
-    vtkSMTransferFunctionProxy::RescaleTransferFunction(cmap, ainfo->GetComponentRange(0));
-    vtkSMTransferFunctionProxy::RescaleTransferFunction(omap, ainfo->GetComponentRange(0));
-    return true;
+    ainfo->GetComponentRange(0, range);
     }
-  return false;
+  vtkSMTransferFunctionProxy::RescaleTransferFunction(cmap, range);
+  vtkSMTransferFunctionProxy::RescaleTransferFunction(omap, range);
+  return true;
+}
+
+//---------------------------------------------------------------------------
+bool initialContourValue(DataSource* dataSource, double& value)
+{
+  ScalarStatistics stats;
+  if (!HistogramScheduler::instance().statistics(dataSource, stats))
+    {
+    return false;
+    }
+  value = 0.5 * (stats.percentile(0.01) + stats.percentile(0.99));
+  return true;
 }
 
 
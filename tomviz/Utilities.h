@@ -129,7 +129,19 @@ vtkPVArrayInformation* scalarArrayInformation(vtkSMSourceProxy* proxy);
 /// Rescales the colorMap (and associated opacityMap) using the transformed data
 /// range from the data source. This will respect the "LockScalarRange" property
 /// on the colorMap i.e. if user locked the scalar range, it won't be rescaled.
-bool rescaleColorMap(vtkSMProxy* colorMap, DataSource* dataSource);
+/// If percentiles (lower and upper, 0 to 100) are given, the maps are rescaled
+/// to those percentiles of the data, estimated from its cached histogram so
+/// that outliers don't stretch the maps. Until the histogram is available the
+/// full range is used and the histogram is requested.
+bool rescaleColorMap(vtkSMProxy* colorMap, DataSource* dataSource,
+                     const double* percentiles=NULL);
+
+//---------------------------------------------------------------------------
+/// Get a value to start contouring the data source at: the middle of the bulk
+/// of its values, between the 1st and 99th percentiles, rather than the middle
+/// of the full range which outliers skew. Returns false if no statistics of
+/// its current data are cached.
+bool initialContourValue(DataSource* dataSource, double& value);
 
 }
 
@@ -83,12 +83,48 @@ bool ModuleStreamingContour::initialize(DataSource* dataSource, vtkSMViewProxy*
                                                 propertyName,
                                                 vtkDataObject::POINT );
 
+  double value;
+  if (tomviz::initialContourValue(dataSource, value))
+    {
+    this->setIsoValue(value);
+    }
+
   this->updateColorMap();
   this->ContourRepresentation->UpdateVTKObjects();
 
+  this->connect(dataSource, SIGNAL(dataChanged()), SLOT(dataSourceChanged()));
   return true;
 }
 
+//-----------------------------------------------------------------------------
+void ModuleStreamingContour::dataSourceChanged()
+{
+  DataSource* source = this->dataSource();
+  if (!source || !this->ContourRepresentation)
+    {
+    return;
+    }
+
+  // A version of 0 never matches the one the worker built from, so an
+  // unknown change rebuilds everything.
+  unsigned long previousVersion = 0;
+  int extent[6] = { 0, -1, 0, -1, 0, -1 };
+  vtkIdType region[8] = { 0, 0, 0, -1, 0, -1, 0, -1 };
+  if (source->lastModification(previousVersion, extent))
+    {
+    region[0] = static_cast<vtkIdType>(previousVersion);
+    region[1] = static_cast<vtkIdType>(source->dataVersion());
+    for (int i = 0; i < 6; ++i)
+      {
+      region[2 + i] = extent[i];
+      }
+    }
+
+  vtkSMPropertyHelper(this->ContourRepresentation,
+                      "ModifiedRegion").Set(region, 8);
+  this->ContourRepresentation->UpdateVTKObjects();
+}
+
 //-----------------------------------------------------------------------------
 void ModuleStreamingContour::updateColorMap()
 {
@@ -126,14 +162,13 @@ bool ModuleStreamingContour::visibility() const
 //-----------------------------------------------------------------------------
 void ModuleStreamingContour::setIsoValues(const QList<double>& values)
 {
-  double vectorValue(1);
-  if(values.size() > 0)
-    {
-    vectorValue = values[0];
-    }
+  // All the values are streamed in the same pass over the volume.
+  std::vector<double> vectorValues(values.size());
+  std::copy(values.begin(), values.end(), vectorValues.begin());
+  vectorValues.push_back(0); // to avoid having to check for 0 size on Windows.
 
   vtkSMPropertyHelper(this->ContourRepresentation,"ContourValue").Set(
-                                                                vectorValue);
+    &vectorValues[0], values.size());
   this->ContourRepresentation->UpdateVTKObjects();
 }
 
@@ -43,9 +43,8 @@ public:
   virtual bool serialize(pugi::xml_node& ns) const;
   virtual bool deserialize(const pugi::xml_node& ns);
 
-  // FIXME: return true once ModuleStreamingContour can produce scalars to color
-  // with.
-  virtual bool isColorMapNeeded() const { return false; }
+  // The streamed surfaces have the value they are for as scalars.
+  virtual bool isColorMapNeeded() const { return true; }
 
   void setIsoValues(const QList<double>& values);
   void setIsoValue(double value)
@@ -58,6 +57,11 @@ public:
 protected:
   virtual void updateColorMap();
 
+private slots:
+  /// Passes the region of the data that changed on to the representation, so
+  /// that it only rebuilds the affected part of its search structure.
+  void dataSourceChanged();
+
 private:
   Q_DISABLE_COPY(ModuleStreamingContour)
   vtkWeakPointer<vtkSMProxy> ContourRepresentation;
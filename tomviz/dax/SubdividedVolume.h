@@ -32,49 +32,123 @@ namespace tomviz
 {
 namespace accel
 {
+  //the output of a sub grid, with the value of the input at each of its
+  //points, which is the iso value of the surface the point is on, and for
+  //contours the normal of the surface there
+  template<typename GridT>
+  struct SubGridOutput
+  {
+  typedef GridT GridType;
+
+  GridType Grid;
+  dax::cont::ArrayHandle<dax::Scalar> PointValues;
+  dax::cont::ArrayHandle<dax::Vector3> PointNormals;
+  };
+
   class SubdividedVolume
   {
-  typedef dax::cont::UnstructuredGrid< dax::CellTagTriangle >
+  typedef SubGridOutput< dax::cont::UnstructuredGrid< dax::CellTagTriangle > >
           ContourGridReturnType;
 
   typedef dax::cont::ArrayContainerControlTagImplicit<
       dax::cont::internal::ArrayPortalCounting<dax::Id> > CountingIdContainerType;
-  typedef dax::cont::UnstructuredGrid< dax::CellTagVertex,
-                                       CountingIdContainerType>
+  typedef SubGridOutput< dax::cont::UnstructuredGrid< dax::CellTagVertex,
+                                                      CountingIdContainerType> >
           PointCloudSubGridReturnType;
 
 public:
 
+  //the sizes ChooseSubGridsPerDim aims for
+  enum
+    {
+    //bytes of values per subgrid, so a subgrid stays resident in L2
+    TargetSubGridBytes = 1024 * 1024,
+    //subgrids per thread, so the threads stay balanced
+    SubGridsPerThread = 4,
+    //cells per subgrid edge, below which the per subgrid overhead dominates
+    MinCellsPerSubGrid = 16
+    };
+
   SubdividedVolume();
 
   template< typename ImageDataType, typename LoggerType >
-  inline SubdividedVolume( std::size_t subGridsPerDim,
+  inline SubdividedVolume( dax::Id3 subGridsPerDim,
                            ImageDataType* data,
                            LoggerType& logger );
 
+  //choose the number of subgrids along each dimension of the extent from the
+  //size of the values and the number of threads: subgrids small enough to
+  //fit in cache, but large enough that there are not many more than needed
+  //to keep all threads busy
+  static inline dax::Id3 ChooseSubGridsPerDim(const int extent[6],
+                                              std::size_t valueSize,
+                                              std::size_t numThreads);
+
   SubdividedVolume( const SubdividedVolume& other);
 
   ~SubdividedVolume();
   SubdividedVolume& operator= (SubdividedVolume other);
 
+  //the sub grids read the values in place, so the volume keeps a reference
+  //to them
   template<typename IteratorType, typename LoggerType>
-  inline void ComputeHighLows(IteratorType begin, IteratorType end, LoggerType& logger);
-
-  inline bool isValidSubGrid(std::size_t index, dax::Scalar value);
-
+  inline void ComputeHighLows(vtkDataArray* values,
+                              IteratorType begin,
+                              IteratorType end,
+                              LoggerType& logger);
+
+  //recomputes the low/high of the given sub grids only, after the values in
+  //them changed or were replaced by values of the same extent, and updates
+  //the low/high tree
+  template<typename IteratorType, typename LoggerType>
+  inline void UpdateHighLows(vtkDataArray* values,
+                             IteratorType begin,
+                             const std::vector<std::size_t>& subGrids,
+                             LoggerType& logger);
+
+  //returns true if the image has the origin, spacing and extent the volume
+  //was subdivided from, i.e. the sub grids are still valid for it
+  template<typename ImageDataType>
+  inline bool hasGeometryOf(ImageDataType* data) const;
+
+  //fills indices with the sub grids that have points in the given extent, in
+  //increasing order
+  inline void subGridsIntersecting(const int extent[6],
+                                   std::vector<std::size_t>& indices) const;
+
+  inline bool isValidSubGrid(std::size_t index, dax::Scalar value) const;
+
+  //fills indices with the subgrids whose low/high range contains any of the
+  //values, in increasing order, by descending the low/high tree once for all
+  //of them
+  inline void validSubGrids(const std::vector<dax::Scalar>& values,
+                            std::vector<std::size_t>& indices) const;
+
+  //fills subGridValues with the values in the low/high range of a sub grid,
+  //in the order of values
+  inline void validValues(std::size_t index,
+                          const std::vector<dax::Scalar>& values,
+                          std::vector<dax::Scalar>& subGridValues) const;
+
+  //the surfaces of all the iso values, from a single pass over the sub grid
   template<typename ValueType, typename LoggerType>
   ContourGridReturnType
-  ContourSubGrid(dax::Scalar isoValue, std::size_t index, ValueType, LoggerType& logger);
+  ContourSubGrid(const std::vector<dax::Scalar>& isoValues, std::size_t index,
+                 ValueType, LoggerType& logger);
 
   template<typename ValueType, typename LoggerType>
   PointCloudSubGridReturnType
-  PointCloudSubGrid(dax::Scalar isoValue, std::size_t index, ValueType, LoggerType& logger);
+  PointCloudSubGrid(const std::vector<dax::Scalar>& isoValues, std::size_t index,
+                    ValueType, LoggerType& logger);
 
   const dax::cont::UniformGrid< >& subGrid( std::size_t index ) const
     { return SubGrids[index]; }
 
-  vtkDataArray* subGridValues( std::size_t index ) const
-    { return PerSubGridValues[index]; }
+  vtkDataArray* values() const
+    { return Values; }
+
+  //the bounds of a sub grid in world coordinates
+  inline void subGridBounds( std::size_t index, double bounds[6] ) const;
 
 
   std::size_t numSubGrids() const { return SubGrids.size(); }
@@ -84,17 +158,28 @@ public:
   dax::Extent3 getExtent() const { return Extent; }
 
 private:
-  template<typename IteratorType, typename LoggerType>
-  void ComputePerSubGridValues(IteratorType begin, IteratorType end, LoggerType& logger);
+  template<typename LoggerType>
+  void ComputeLowHighTree(LoggerType& logger);
+
+  inline void CollectValidSubGrids(std::size_t level,
+                                   const dax::Id3& ijk,
+                                   const std::vector<dax::Scalar>& values,
+                                   std::vector<std::size_t>& indices) const;
+
+  const dax::Id3& levelDims(std::size_t level) const
+    { return level == 0 ? SubGridsPerDim : LowHighLevelDims[level-1]; }
 
   template<typename ValueType, typename LoggerType>
-  inline dax::cont::UnstructuredGrid<dax::CellTagTriangle>
-  ComputeSubGridContour(dax::Scalar isoValue, std::size_t index, ValueType, LoggerType& logger);
+  inline ContourGridReturnType
+  ComputeSubGridContour(const std::vector<dax::Scalar>& isoValues,
+                        std::size_t index, bool computeNormals,
+                        ValueType, LoggerType& logger);
 
   dax::Vector3 Origin;
   dax::Vector3 Spacing;
   dax::Extent3 Extent;
 
+  dax::Id3 SubGridsPerDim;
   std::vector< dax::cont::UniformGrid< > > SubGrids;
   std::vector< dax::Id3 > SubGridCellIJKOffset; //offsets
 
@@ -102,23 +187,30 @@ private:
   //that we support
   std::vector< dax::Vector2 > PerSubGridLowHighs;
 
-  //store the sub grids cached values as vtkDataArray, and uses the
-  //ValueType of the method for quick casting of all the vtkDataArray's
-  //to the correct type
-  std::vector< vtkDataArray* > PerSubGridValues;
+  //the levels of the min/max tree above the subgrids, each node holding the
+  //low/high of (up to) 2x2x2 nodes of the level below, up to a single root
+  std::vector< std::vector< dax::Vector2 > > LowHighLevels;
+  std::vector< dax::Id3 > LowHighLevelDims;
+
+  //the values of the full grid, the sub grids view them in place through
+  //implicit array handles and uses the ValueType of the method for quick
+  //casting to the correct type
+  vtkSmartPointer<vtkDataArray> Values;
   };
 
 //helper functors to generalize calling Contour or Threshold based on
 //already having a SubdividedVolume
 struct ContourFunctor
 {
-  typedef dax::cont::UnstructuredGrid< dax::CellTagTriangle > ReturnType;
+  typedef SubGridOutput< dax::cont::UnstructuredGrid< dax::CellTagTriangle > >
+          ReturnType;
 
 
   ContourFunctor(tomviz::accel::SubdividedVolume& v):Volume(v){}
 
   template<typename ValueType, typename LoggerType>
-  ReturnType operator()(double v, std::size_t i, ValueType, LoggerType& logger)
+  ReturnType operator()(const std::vector<dax::Scalar>& v, std::size_t i,
+                        ValueType, LoggerType& logger)
   {
     return this->Volume.ContourSubGrid(v,i,ValueType(),logger);
   }
@@ -130,14 +222,16 @@ struct PointCloudFunctor
 {
   typedef dax::cont::ArrayContainerControlTagImplicit<
       dax::cont::internal::ArrayPortalCounting<dax::Id> > CountingIdContainerType;
-  typedef dax::cont::UnstructuredGrid< dax::CellTagVertex,
-                                       CountingIdContainerType> ReturnType;
+  typedef SubGridOutput< dax::cont::UnstructuredGrid< dax::CellTagVertex,
+                                                      CountingIdContainerType> >
+          ReturnType;
 
 
   PointCloudFunctor(tomviz::accel::SubdividedVolume& v):Volume(v){}
 
   template<typename ValueType, typename LoggerType>
-  ReturnType operator()(double v, std::size_t i, ValueType, LoggerType& logger)
+  ReturnType operator()(const std::vector<dax::Scalar>& v, std::size_t i,
+                        ValueType, LoggerType& logger)
   {
     return this->Volume.PointCloudSubGrid(v,i,ValueType(),logger);
   }
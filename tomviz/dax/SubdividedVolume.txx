@@ -30,6 +30,7 @@
 
 //for std::swap (c++98 / c++11 have different locations for swap)
 #include <algorithm>
+#include <cmath>
 #include <utility>
 
 
@@ -42,17 +43,20 @@ SubdividedVolume::SubdividedVolume( ):
   Origin(),
   Spacing(),
   Extent(),
+  SubGridsPerDim(0,0,0),
   SubGrids(),
   SubGridCellIJKOffset(),
   PerSubGridLowHighs(),
-  PerSubGridValues()
+  LowHighLevels(),
+  LowHighLevelDims(),
+  Values()
 {
 
 }
 
 //----------------------------------------------------------------------------
 template< typename ImageDataType, typename LoggerType >
-SubdividedVolume::SubdividedVolume( std::size_t desiredSubGridsPerDim,
+SubdividedVolume::SubdividedVolume( dax::Id3 desiredSubGridsPerDim,
                                     ImageDataType* data,
                                     LoggerType& logger )
 {
@@ -72,9 +76,13 @@ SubdividedVolume::SubdividedVolume( std::size_t desiredSubGridsPerDim,
   dax::Id3 subGridsPerDim;
   for(std::size_t i=0; i < 3; ++i)
     {
-    subGridsPerDim[i] =( (desiredSubGridsPerDim < cellDims[i]) ? desiredSubGridsPerDim : 1);
+    subGridsPerDim[i] =( (desiredSubGridsPerDim[i] > 0 &&
+                          desiredSubGridsPerDim[i] < cellDims[i]) ?
+                         desiredSubGridsPerDim[i] : 1);
     }
 
+  this->SubGridsPerDim = subGridsPerDim;
+
   dax::Id3 cellsPerSubGrid = cellDims / subGridsPerDim;
   dax::Id3 remainderCellsPerSubGrids;
   for(std::size_t i=0; i < 3; ++i)
@@ -130,22 +138,61 @@ SubdividedVolume::SubdividedVolume( std::size_t desiredSubGridsPerDim,
 
   //now create the rest of the vectors to the same size as the subgrids
   this->PerSubGridLowHighs.resize( this->SubGrids.size() );
-  this->PerSubGridValues.resize( this->SubGrids.size(), NULL );
 
   logger << "Computed Sub Grids: " << timer.GetElapsedTime()
-         << " sec ( " << data->GetNumberOfPoints() << " points )"
+         << " sec ( " << data->GetNumberOfPoints() << " points, "
+         << subGridsPerDim[0] << "x" << subGridsPerDim[1] << "x"
+         << subGridsPerDim[2] << " sub grids )"
          << std::endl;
 }
 
+//----------------------------------------------------------------------------
+dax::Id3 SubdividedVolume::ChooseSubGridsPerDim(const int extent[6],
+                                                std::size_t valueSize,
+                                                std::size_t numThreads)
+{
+  dax::Id3 cellDims;
+  double numCells = 1;
+  for(std::size_t i=0; i < 3; ++i)
+    {
+    cellDims[i] = std::max(extent[2*i+1] - extent[2*i], 1);
+    numCells *= static_cast<double>(cellDims[i]);
+    }
+
+  //edge of the largest cubic subgrid whose values fit in the cache
+  const double cacheEdge = std::pow(
+    TargetSubGridBytes / static_cast<double>(std::max<std::size_t>(valueSize, 1)),
+    1.0 / 3.0);
+
+  //edge of the cubic subgrids that give each thread a few of them
+  const double threadsEdge = std::pow(
+    numCells / (SubGridsPerThread * std::max<std::size_t>(numThreads, 1)),
+    1.0 / 3.0);
+
+  const double edge = std::max(std::min(cacheEdge, threadsEdge),
+                               static_cast<double>(MinCellsPerSubGrid));
+
+  dax::Id3 subGridsPerDim;
+  for(std::size_t i=0; i < 3; ++i)
+    {
+    subGridsPerDim[i] = std::max<dax::Id>(
+      static_cast<dax::Id>(cellDims[i] / edge + 0.5), 1);
+    }
+  return subGridsPerDim;
+}
+
 //----------------------------------------------------------------------------
 SubdividedVolume::SubdividedVolume( const SubdividedVolume& other ):
   Origin(other.Origin),
   Spacing(other.Spacing),
   Extent(other.Extent),
+  SubGridsPerDim(other.SubGridsPerDim),
   SubGrids(other.SubGrids),
   SubGridCellIJKOffset(other.SubGridCellIJKOffset),
   PerSubGridLowHighs(other.PerSubGridLowHighs),
-  PerSubGridValues(other.PerSubGridValues)
+  LowHighLevels(other.LowHighLevels),
+  LowHighLevelDims(other.LowHighLevelDims),
+  Values(other.Values)
 {
 
 }
@@ -153,48 +200,45 @@ SubdividedVolume::SubdividedVolume( const SubdividedVolume& other ):
 //----------------------------------------------------------------------------
 SubdividedVolume::~SubdividedVolume()
 {
-  //release all the data arrays
-  const std::size_t size = this->numSubGrids();
-  for(std::size_t i=0; i < size; ++i)
-    {
-    vtkDataArray* da = this->subGridValues(i);
-    if(da)
-      {
-      da->Delete();
-      }
-    }
 }
 
-
 //----------------------------------------------------------------------------
 SubdividedVolume& SubdividedVolume::operator= (SubdividedVolume other)
 {
   std::swap(this->Origin,other.Origin);
   std::swap(this->Spacing,other.Spacing);
   std::swap(this->Extent,other.Extent);
+  std::swap(this->SubGridsPerDim,other.SubGridsPerDim);
   std::swap(this->SubGrids,other.SubGrids);
   std::swap(this->SubGridCellIJKOffset,other.SubGridCellIJKOffset);
   std::swap(this->PerSubGridLowHighs,other.PerSubGridLowHighs);
-  std::swap(this->PerSubGridValues,other.PerSubGridValues);
+  std::swap(this->LowHighLevels,other.LowHighLevels);
+  std::swap(this->LowHighLevelDims,other.LowHighLevelDims);
+  std::swap(this->Values,other.Values);
   return *this;
 }
 
 //----------------------------------------------------------------------------
 template<typename IteratorType, typename LoggerType>
-void SubdividedVolume::ComputeHighLows(const IteratorType begin,
-                                       const IteratorType end,
+void SubdividedVolume::ComputeHighLows(vtkDataArray* values,
+                                       const IteratorType begin,
+                                       const IteratorType /*end*/,
                                        LoggerType& logger)
 {
-  this->ComputePerSubGridValues(begin,end,logger);
-
   typedef typename std::iterator_traits<IteratorType>::value_type ValueType;
 
+  //the sub grids read the values in place instead of keeping a copy each
+  this->Values = values;
+
   dax::cont::Timer<> timer;
 
   //we parallelize this operation by stating that each worklet will
   //work on computing the low/high for an entire sub-grid
   typedef ::worklets::ComputeLowHighPerElement<ValueType> LowHighWorkletType;
-  LowHighWorkletType computeLowHigh(this->PerSubGridValues);
+  LowHighWorkletType computeLowHigh(&(*begin),
+                                    this->getExtent(),
+                                    this->SubGrids,
+                                    this->SubGridCellIJKOffset);
 
   dax::cont::ArrayHandleCounting<dax::Id> countingHandle(0,this->numSubGrids());
   dax::cont::ArrayHandle< dax::Vector2 > lowHighResults;
@@ -208,13 +252,78 @@ void SubdividedVolume::ComputeHighLows(const IteratorType begin,
 
   logger << "Computed Low High Field: " << timer.GetElapsedTime()
          << std::endl;
+
+  this->ComputeLowHighTree(logger);
 }
 
 //----------------------------------------------------------------------------
 template<typename IteratorType, typename LoggerType>
-void SubdividedVolume::ComputePerSubGridValues(const IteratorType begin,
-                                               const IteratorType end,
-                                               LoggerType& logger)
+void SubdividedVolume::UpdateHighLows(vtkDataArray* values,
+                                      const IteratorType begin,
+                                      const std::vector<std::size_t>& subGrids,
+                                      LoggerType& logger)
+{
+  typedef typename std::iterator_traits<IteratorType>::value_type ValueType;
+
+  this->Values = values;
+  if(subGrids.empty())
+    {
+    return;
+    }
+
+  dax::cont::Timer<> timer;
+
+  //same as ComputeHighLows, but only over the given sub grids
+  typedef ::worklets::ComputeLowHighPerElement<ValueType> LowHighWorkletType;
+  LowHighWorkletType computeLowHigh(&(*begin),
+                                    this->getExtent(),
+                                    this->SubGrids,
+                                    this->SubGridCellIJKOffset);
+
+  std::vector<dax::Id> indices(subGrids.begin(), subGrids.end());
+  dax::cont::ArrayHandle< dax::Vector2 > lowHighResults;
+
+  dax::cont::DispatcherMapField<LowHighWorkletType> dispatcher(computeLowHigh);
+  dispatcher.Invoke( dax::cont::make_ArrayHandle(indices), lowHighResults );
+
+  std::vector< dax::Vector2 > lowHighs(subGrids.size());
+  lowHighResults.CopyInto(lowHighs.begin());
+  for(std::size_t i=0; i < subGrids.size(); ++i)
+    {
+    this->PerSubGridLowHighs[subGrids[i]] = lowHighs[i];
+    }
+
+  logger << "Updated Low High Field: " << timer.GetElapsedTime()
+         << " sec ( " << subGrids.size() << " of " << this->numSubGrids()
+         << " sub grids )" << std::endl;
+
+  this->ComputeLowHighTree(logger);
+}
+
+//----------------------------------------------------------------------------
+template<typename ImageDataType>
+bool SubdividedVolume::hasGeometryOf(ImageDataType* data) const
+{
+  double vtk_origin[3];  data->GetOrigin(vtk_origin);
+  double vtk_spacing[3]; data->GetSpacing(vtk_spacing);
+  int    vtk_extent[6];  data->GetExtent(vtk_extent);
+
+  for(std::size_t i=0; i < 3; ++i)
+    {
+    if(this->Origin[i] != static_cast<dax::Scalar>(vtk_origin[i]) ||
+       this->Spacing[i] != static_cast<dax::Scalar>(vtk_spacing[i]) ||
+       this->Extent.Min[i] != vtk_extent[2*i] ||
+       this->Extent.Max[i] != vtk_extent[2*i+1])
+      {
+      return false;
+      }
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+template<typename LoggerType>
+void SubdividedVolume::ComputeLowHighTree(LoggerType& logger)
 {
   //find the default device adapter
   typedef DAX_DEFAULT_DEVICE_ADAPTER_TAG AdapterTag;
@@ -224,135 +333,283 @@ void SubdividedVolume::ComputePerSubGridValues(const IteratorType begin,
 
   dax::cont::Timer<> timer;
 
-  typedef typename std::iterator_traits<IteratorType>::value_type ValueType;
-  typedef std::vector< dax::cont::UniformGrid< > >::const_iterator gridIt;
-
-  std::vector< vtkDataArray* >::iterator subGridValues = this->PerSubGridValues.begin();
-  std::vector< dax::Id3 >::const_iterator ijkSubOffset = this->SubGridCellIJKOffset.begin();
-
-  dax::cont::ArrayHandle<ValueType> fullGridValues =
-        dax::cont::make_ArrayHandle(begin, std::distance(begin,end) );
+  this->LowHighLevels.clear();
+  this->LowHighLevelDims.clear();
 
-  //abstract out the transform from full space to local space
-  //once and call it to store the subgrid data once
-  for(gridIt grid = this->SubGrids.begin();
-      grid != this->SubGrids.end();
-      ++grid, ++ijkSubOffset, ++subGridValues)
+  //merge 2x2x2 nodes into their parent, one level at a time, until a
+  //single root is left. Each level is merged in parallel
+  dax::Id3 childDims = this->SubGridsPerDim;
+  while(childDims[0] > 1 || childDims[1] > 1 || childDims[2] > 1)
     {
-    //allocate the contiguous space for the sub grid
-    (*subGridValues) = make_vtkDataArray(ValueType());
-    (*subGridValues)->SetNumberOfTuples((*grid).GetNumberOfPoints());
-    (*subGridValues)->SetNumberOfComponents(1);
-
-    //create temporary functor to fill continuous memory vector
-    //so that we don't have to iterate over non continuous memory
-    ::functors::SubGridValues<ValueType> functor(fullGridValues,
-                                                 (*subGridValues),
-                                                 this->getExtent(),
-                                                 (*grid).GetExtent(),
-                                                 (*ijkSubOffset));
-
-    DeviceAdapter::Schedule(functor, (*grid).GetNumberOfPoints() );
+    const dax::Id3 parentDims = dax::make_Id3((childDims[0] + 1) / 2,
+                                              (childDims[1] + 1) / 2,
+                                              (childDims[2] + 1) / 2);
+    const dax::Id numParents = parentDims[0] * parentDims[1] * parentDims[2];
+    this->LowHighLevels.push_back( std::vector< dax::Vector2 >(numParents) );
+    this->LowHighLevelDims.push_back( parentDims );
+
+    //the children are fetched after the push_back, which can move the levels
+    const std::size_t level = this->LowHighLevels.size();
+    const dax::Vector2* children = (level == 1) ?
+      &this->PerSubGridLowHighs[0] : &this->LowHighLevels[level-2][0];
+
+    ::functors::MergeLowHighs functor(children, childDims,
+                                      &this->LowHighLevels.back()[0],
+                                      parentDims);
+    DeviceAdapter::Schedule(functor, numParents);
+
+    childDims = parentDims;
     }
 
-  logger << "Computed Explicit Values Per Sub Grid: " << timer.GetElapsedTime()
+  logger << "Computed Low High Tree: " << timer.GetElapsedTime()
+         << " sec ( " << this->LowHighLevels.size() << " levels )"
          << std::endl;
 }
 
-
 //----------------------------------------------------------------------------
 template<typename ValueType, typename LoggerType>
-dax::cont::UnstructuredGrid< dax::CellTagTriangle >
-SubdividedVolume::ComputeSubGridContour(dax::Scalar isoValue,
+SubdividedVolume::ContourGridReturnType
+SubdividedVolume::ComputeSubGridContour(const std::vector<dax::Scalar>& isoValues,
                                std::size_t index,
+                               bool computeNormals,
                                ValueType,
                                LoggerType& logger)
 {
   typedef  dax::cont::DispatcherGenerateInterpolatedCells<
                   ::worklets::ContourGenerate > InterpolatedDispatcher;
 
-  typedef dax::cont::UnstructuredGrid< dax::CellTagTriangle >
-                                                UnstructuredGridType;
+  ContourGridReturnType output;
+  if(isoValues.empty())
+    {
+    return output;
+    }
 
   const ValueType* raw_values = reinterpret_cast<ValueType*>(
-                            this->subGridValues(index)->GetVoidPointer(0));
-  const dax::Id raw_values_len =
-                            this->PerSubGridValues[index]->GetNumberOfTuples();
-
-  //make an array handle the is read only reference to sub grid values
-  dax::cont::ArrayHandle<ValueType> values =
-    dax::cont::make_ArrayHandle(raw_values, raw_values_len);
-
+                            this->Values->GetVoidPointer(0));
+
+  //make an implicit array handle that is a read only view of the sub grid
+  //values, in place in the full grid values
+  typedef ::functors::SubGridView<ValueType> SubGridViewType;
+  SubGridViewType view(raw_values,
+                       this->getExtent(),
+                       this->subGrid(index).GetExtent(),
+                       this->SubGridCellIJKOffset[index]);
+  dax::cont::ArrayHandleImplicit<ValueType, SubGridViewType> values =
+    dax::cont::make_ArrayHandleImplicit<ValueType>(
+      view, this->subGrid(index).GetNumberOfPoints());
+
+  //classify and generate the cells for all the values at once, so each
+  //cell is only visited once whatever the number of values
+  const dax::Id numIsoValues = static_cast<dax::Id>(isoValues.size());
   dax::cont::ArrayHandle<dax::Id> numTrianglesPerCell;
 
   dax::cont::DispatcherMapCell< ::worklets::ContourCount >
-    classify( ( ::worklets::ContourCount(isoValue)) );
+    classify( ( ::worklets::ContourCount(&isoValues[0], numIsoValues)) );
   classify.Invoke( this->subGrid(index), values, numTrianglesPerCell );
 
-  //run the second step again with point merging
+  //run the second step again with point merging, points are merged by edge
+  //and weight so the surfaces of different values don't share points
   InterpolatedDispatcher interpDispatcher( numTrianglesPerCell,
-                              ::worklets::ContourGenerate(isoValue) );
+                              ::worklets::ContourGenerate(&isoValues[0],
+                                                          numIsoValues) );
   interpDispatcher.SetRemoveDuplicatePoints(true);
-  UnstructuredGridType outGrid;
   interpDispatcher.Invoke(this->subGrid(index),
-                          outGrid,
+                          output.Grid,
                           values);
-  return outGrid;
+
+  //interpolating the values to the points tags each point with the iso
+  //value of its surface
+  typedef ::functors::SubGridView<ValueType, dax::Scalar> ScalarViewType;
+  ScalarViewType scalarView(raw_values,
+                            this->getExtent(),
+                            this->subGrid(index).GetExtent(),
+                            this->SubGridCellIJKOffset[index]);
+  interpDispatcher.CompactPointField(
+    dax::cont::make_ArrayHandleImplicit<dax::Scalar>(
+      scalarView, this->subGrid(index).GetNumberOfPoints()),
+    output.PointValues);
+  if(!computeNormals)
+    {
+    return output;
+    }
+
+  //the normals the same way, from the gradient at the ends of the edges the
+  //points are on. The gradient is only evaluated at those, so this costs no
+  //pass over the sub grid or the triangles
+  typedef ::functors::SubGridNormals<ValueType> NormalsViewType;
+  NormalsViewType normalsView(raw_values,
+                              this->getExtent(),
+                              this->subGrid(index).GetExtent(),
+                              this->SubGridCellIJKOffset[index],
+                              this->getSpacing());
+  interpDispatcher.CompactPointField(
+    dax::cont::make_ArrayHandleImplicit<dax::Vector3>(
+      normalsView, this->subGrid(index).GetNumberOfPoints()),
+    output.PointNormals);
+  return output;
 }
 
 //----------------------------------------------------------------------------
 template<typename ValueType, typename LoggerType>
-dax::cont::UnstructuredGrid< dax::CellTagTriangle >
-SubdividedVolume::ContourSubGrid(dax::Scalar isoValue,
+SubdividedVolume::ContourGridReturnType
+SubdividedVolume::ContourSubGrid(const std::vector<dax::Scalar>& isoValues,
                                std::size_t index,
                                ValueType,
                                LoggerType& logger)
 {
-  return this->ComputeSubGridContour(isoValue,index,ValueType(),logger);
+  return this->ComputeSubGridContour(isoValues,index,true,ValueType(),logger);
 }
 
 //----------------------------------------------------------------------------
 template<typename ValueType, typename LoggerType>
-dax::cont::UnstructuredGrid< dax::CellTagVertex,
-  dax::cont::ArrayContainerControlTagImplicit<
-      dax::cont::internal::ArrayPortalCounting<dax::Id> > >
-SubdividedVolume::PointCloudSubGrid(dax::Scalar isoValue,
+SubdividedVolume::PointCloudSubGridReturnType
+SubdividedVolume::PointCloudSubGrid(const std::vector<dax::Scalar>& isoValues,
                                     std::size_t index,
                                     ValueType,
                                     LoggerType& logger)
 {
-  typedef dax::cont::UnstructuredGrid< dax::CellTagTriangle >
-                                                UnstructuredGridType;
-
-  typedef dax::cont::ArrayContainerControlTagImplicit<
-      dax::cont::internal::ArrayPortalCounting<dax::Id> > CountingIdContainerType;
-  typedef dax::cont::UnstructuredGrid< dax::CellTagVertex,
-                                       CountingIdContainerType> PointCloudGridType;
-
-
-  UnstructuredGridType triangleGrid =
-                                 this->ComputeSubGridContour(isoValue,
-                                                             index,
-                                                             ValueType(),
-                                                             logger);
+  ContourGridReturnType triangles = this->ComputeSubGridContour(isoValues,
+                                                                index,
+                                                                false,
+                                                                ValueType(),
+                                                                logger);
 
   //make an unstructured grid with a virtual topology that start at zero
   //and monotonically increasing to the number of points we have
-  PointCloudGridType outGrid(
+  PointCloudSubGridReturnType output;
+  output.Grid = PointCloudSubGridReturnType::GridType(
     dax::cont::make_ArrayHandleCounting(0,
-          triangleGrid.GetPointCoordinates().GetNumberOfValues()),
-    triangleGrid.GetPointCoordinates());
-
-  return outGrid;
+          triangles.Grid.GetPointCoordinates().GetNumberOfValues()),
+    triangles.Grid.GetPointCoordinates());
+  output.PointValues = triangles.PointValues;
+  return output;
 }
 
 //----------------------------------------------------------------------------
-bool SubdividedVolume::isValidSubGrid(std::size_t index, dax::Scalar value)
+bool SubdividedVolume::isValidSubGrid(std::size_t index, dax::Scalar value) const
 {
   return this->PerSubGridLowHighs[index][0] <= value &&
          this->PerSubGridLowHighs[index][1] >= value;
 }
 
+//----------------------------------------------------------------------------
+void SubdividedVolume::subGridBounds(std::size_t index, double bounds[6]) const
+{
+  const dax::cont::UniformGrid< >& grid = this->SubGrids[index];
+  const dax::Vector3 origin = grid.GetOrigin();
+  const dax::Vector3 spacing = grid.GetSpacing();
+  const dax::Extent3 extent = grid.GetExtent();
+  for(std::size_t i=0; i < 3; ++i)
+    {
+    bounds[2*i] = origin[i] + extent.Min[i] * spacing[i];
+    bounds[2*i+1] = origin[i] + extent.Max[i] * spacing[i];
+    }
+}
+
+//----------------------------------------------------------------------------
+void SubdividedVolume::subGridsIntersecting(const int extent[6],
+                                            std::vector<std::size_t>& indices) const
+{
+  indices.clear();
+  const std::size_t size = this->numSubGrids();
+  for(std::size_t index=0; index < size; ++index)
+    {
+    //the point extent of the sub grid, in the extent of the full grid
+    const dax::Extent3 subExtent = this->SubGrids[index].GetExtent();
+    const dax::Id3& offset = this->SubGridCellIJKOffset[index];
+    bool intersects = true;
+    for(std::size_t i=0; i < 3 && intersects; ++i)
+      {
+      const dax::Id first = this->Extent.Min[i] + offset[i] + subExtent.Min[i];
+      const dax::Id last = this->Extent.Min[i] + offset[i] + subExtent.Max[i];
+      intersects = extent[2*i] <= last && extent[2*i+1] >= first;
+      }
+    if(intersects)
+      {
+      indices.push_back(index);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void SubdividedVolume::validSubGrids(const std::vector<dax::Scalar>& values,
+                                     std::vector<std::size_t>& indices) const
+{
+  indices.clear();
+  if(this->numSubGrids() == 0 || values.empty())
+    {
+    return;
+    }
+
+  //descend from the root, skipping every subtree whose range misses all the
+  //values
+  this->CollectValidSubGrids(this->LowHighLevels.size(),
+                             dax::make_Id3(0,0,0),
+                             values,
+                             indices);
+  std::sort(indices.begin(), indices.end());
+}
+
+//----------------------------------------------------------------------------
+void SubdividedVolume::validValues(std::size_t index,
+                                   const std::vector<dax::Scalar>& values,
+                                   std::vector<dax::Scalar>& subGridValues) const
+{
+  subGridValues.clear();
+  for(std::size_t i=0; i < values.size(); ++i)
+    {
+    if(this->isValidSubGrid(index, values[i]))
+      {
+      subGridValues.push_back(values[i]);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+void SubdividedVolume::CollectValidSubGrids(std::size_t level,
+                                            const dax::Id3& ijk,
+                                            const std::vector<dax::Scalar>& values,
+                                            std::vector<std::size_t>& indices) const
+{
+  const dax::Id3& dims = this->levelDims(level);
+  const dax::Id index = ijk[0] + dims[0]*(ijk[1] + dims[1]*ijk[2]);
+  const dax::Vector2& lh = (level == 0) ?
+    this->PerSubGridLowHighs[index] : this->LowHighLevels[level-1][index];
+
+  //only the values in the range of this node can be in its children
+  std::vector<dax::Scalar> nodeValues;
+  for(std::size_t i=0; i < values.size(); ++i)
+    {
+    if(lh[0] <= values[i] && lh[1] >= values[i])
+      {
+      nodeValues.push_back(values[i]);
+      }
+    }
+  if(nodeValues.empty())
+    {
+    return;
+    }
+  if(level == 0)
+    {
+    indices.push_back(static_cast<std::size_t>(index));
+    return;
+    }
+
+  const dax::Id3& childDims = this->levelDims(level-1);
+  const dax::Id3 first = dax::make_Id3(2 * ijk[0], 2 * ijk[1], 2 * ijk[2]);
+  for(dax::Id k=first[2]; k < std::min(first[2] + 2, childDims[2]); ++k)
+    {
+    for(dax::Id j=first[1]; j < std::min(first[1] + 2, childDims[1]); ++j)
+      {
+      for(dax::Id i=first[0]; i < std::min(first[0] + 2, childDims[0]); ++i)
+        {
+        this->CollectValidSubGrids(level-1, dax::make_Id3(i,j,k), nodeValues,
+                                   indices);
+        }
+      }
+    }
+}
+
 }
 }
 
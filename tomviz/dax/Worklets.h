@@ -19,6 +19,7 @@
 
 #include <dax/cont/arg/ExecutionObject.h>
 #include <dax/cont/ArrayHandle.h>
+#include <dax/cont/UniformGrid.h>
 
 #include <dax/math/Compare.h>
 #include <dax/exec/WorkletMapField.h>
@@ -47,28 +48,36 @@
 
 namespace functors
 {
-  template<typename ValueType>
-  struct SubGridValues
+  //a read only view of the values of a sub grid, straight from the values of
+  //the full grid, used as the functor of an implicit array handle so the sub
+  //grids don't need their own copy of the values. The values are converted
+  //to ResultType
+  template<typename ValueType, typename ResultType = ValueType>
+  struct SubGridView
   {
     DAX_CONT_EXPORT
-    SubGridValues(){}
+    SubGridView():
+    FullValues(NULL),
+    FullDims(),
+    SubGridExtent(),
+    FullGridCellIJKOffset()
+    {
+    }
 
     DAX_CONT_EXPORT
-    SubGridValues(dax::cont::ArrayHandle<ValueType> fullGridContourValues,
-                  vtkDataArray* outputArray,
-                  const dax::Extent3& fullExtent,
-                  const dax::Extent3& subGridExtent,
-                  dax::Id3 subGridsOffsetsInFullGrid):
-    InputPortal(fullGridContourValues.PrepareForInput()),
-    OutputPortal(reinterpret_cast<ValueType*>(outputArray->GetVoidPointer(0))),
-    FullExtent(fullExtent),
+    SubGridView(const ValueType* fullGridValues,
+                const dax::Extent3& fullExtent,
+                const dax::Extent3& subGridExtent,
+                dax::Id3 subGridsOffsetsInFullGrid):
+    FullValues(fullGridValues),
+    FullDims(dax::extentDimensions(fullExtent)),
     SubGridExtent(subGridExtent),
     FullGridCellIJKOffset(subGridsOffsetsInFullGrid)
     {
     }
 
     DAX_EXEC_EXPORT
-    void operator()(dax::Id pointIndex) const
+    ResultType operator()(dax::Id pointIndex) const
     {
       //compute the local point ijk index
       const dax::Id3 local_ijk = dax::flatIndexToIndex3(pointIndex, this->SubGridExtent);
@@ -79,21 +88,142 @@ namespace functors
 
       //we can't use dax here as index3ToFlatIndex doesn't support negative
       //extents
-      const dax::Id3 dims = dax::extentDimensions(this->FullExtent);
-      const dax::Id index = global_ijk[0] + dims[0]*(global_ijk[1] + dims[1]*global_ijk[2]);
+      const dax::Id index = global_ijk[0] + this->FullDims[0]*(global_ijk[1] +
+                                            this->FullDims[1]*global_ijk[2]);
+      return static_cast<ResultType>(this->FullValues[index]);
+    }
 
-      this->OutputPortal[pointIndex] = this->InputPortal.Get( index );
+  const ValueType* FullValues;
+  dax::Id3 FullDims;
+  dax::Extent3 SubGridExtent;
+  dax::Id3 FullGridCellIJKOffset;
+  };
+
+  //the normals of the iso surfaces at the points of a sub grid, the negated
+  //gradient of the values by central differences. Like SubGridView the
+  //values are read in place from the full grid, so the normals of
+  //neighbouring sub grids match on their shared points. On the boundary of
+  //the full grid the differences are one sided
+  template<typename ValueType>
+  struct SubGridNormals
+  {
+    DAX_CONT_EXPORT
+    SubGridNormals():
+    FullValues(NULL),
+    FullDims(),
+    SubGridExtent(),
+    FullGridCellIJKOffset(),
+    Spacing()
+    {
     }
 
     DAX_CONT_EXPORT
-    void SetErrorMessageBuffer(const dax::exec::internal::ErrorMessageBuffer &)
-    {  }
+    SubGridNormals(const ValueType* fullGridValues,
+                   const dax::Extent3& fullExtent,
+                   const dax::Extent3& subGridExtent,
+                   dax::Id3 subGridsOffsetsInFullGrid,
+                   const dax::Vector3& spacing):
+    FullValues(fullGridValues),
+    FullDims(dax::extentDimensions(fullExtent)),
+    SubGridExtent(subGridExtent),
+    FullGridCellIJKOffset(subGridsOffsetsInFullGrid),
+    Spacing(spacing)
+    {
+    }
+
+    DAX_EXEC_EXPORT
+    dax::Vector3 operator()(dax::Id pointIndex) const
+    {
+      const dax::Id3 local_ijk = dax::flatIndexToIndex3(pointIndex, this->SubGridExtent);
+      const dax::Id3 global_ijk = local_ijk + this->FullGridCellIJKOffset;
+
+      dax::Vector3 normal;
+      for(int d=0; d < 3; ++d)
+        {
+        dax::Id3 low = global_ijk;
+        dax::Id3 high = global_ijk;
+        low[d] = std::max(global_ijk[d] - 1, dax::Id(0));
+        high[d] = std::min(global_ijk[d] + 1, this->FullDims[d] - 1);
+        const dax::Scalar distance =
+          static_cast<dax::Scalar>(high[d] - low[d]) * this->Spacing[d];
+        normal[d] = (distance > 0) ?
+          (this->value(low) - this->value(high)) / distance : 0;
+        }
+      return normal;
+    }
+
+  private:
+    DAX_EXEC_EXPORT
+    dax::Scalar value(const dax::Id3& ijk) const
+    {
+      return static_cast<dax::Scalar>(this->FullValues[ijk[0] +
+        this->FullDims[0]*(ijk[1] + this->FullDims[1]*ijk[2])]);
+    }
 
-  typename dax::cont::ArrayHandle<ValueType>::PortalConstExecution InputPortal;
-  ValueType* OutputPortal;
-  dax::Extent3 FullExtent;
+  const ValueType* FullValues;
+  dax::Id3 FullDims;
   dax::Extent3 SubGridExtent;
   dax::Id3 FullGridCellIJKOffset;
+  dax::Vector3 Spacing;
+  };
+
+  //merges the low/highs of the (up to) 2x2x2 children of each node of a level
+  //of the low/high tree
+  struct MergeLowHighs
+  {
+    DAX_CONT_EXPORT
+    MergeLowHighs(const dax::Vector2* children,
+                  const dax::Id3& childDims,
+                  dax::Vector2* parents,
+                  const dax::Id3& parentDims):
+    Children(children),
+    ChildDims(childDims),
+    Parents(parents),
+    ParentDims(parentDims)
+    {
+    }
+
+    DAX_EXEC_EXPORT
+    void operator()(dax::Id parentIndex) const
+    {
+      const dax::Id3 parent_ijk = dax::make_Id3(
+        parentIndex % this->ParentDims[0],
+        (parentIndex / this->ParentDims[0]) % this->ParentDims[1],
+        parentIndex / (this->ParentDims[0] * this->ParentDims[1]));
+      const dax::Id3 first = dax::make_Id3(2 * parent_ijk[0],
+                                           2 * parent_ijk[1],
+                                           2 * parent_ijk[2]);
+      const dax::Id3 last = dax::make_Id3(
+        std::min(first[0] + 2, this->ChildDims[0]),
+        std::min(first[1] + 2, this->ChildDims[1]),
+        std::min(first[2] + 2, this->ChildDims[2]));
+
+      dax::Vector2 lh = this->Children[first[0] + this->ChildDims[0] *
+                                       (first[1] + this->ChildDims[1] * first[2])];
+      for(dax::Id k=first[2]; k < last[2]; ++k)
+        {
+        for(dax::Id j=first[1]; j < last[1]; ++j)
+          {
+          for(dax::Id i=first[0]; i < last[0]; ++i)
+            {
+            const dax::Vector2& child = this->Children[i + this->ChildDims[0] *
+                                                       (j + this->ChildDims[1] * k)];
+            lh[0] = std::min(lh[0],child[0]);
+            lh[1] = std::max(lh[1],child[1]);
+            }
+          }
+        }
+      this->Parents[parentIndex] = lh;
+    }
+
+    DAX_CONT_EXPORT
+    void SetErrorMessageBuffer(const dax::exec::internal::ErrorMessageBuffer &)
+    {  }
+
+  const dax::Vector2* Children;
+  dax::Id3 ChildDims;
+  dax::Vector2* Parents;
+  dax::Id3 ParentDims;
   };
 }
 
@@ -109,40 +239,63 @@ struct ComputeLowHighPerElement : dax::exec::WorkletMapField
   typedef _2 ExecutionSignature(_1);
 
   DAX_CONT_EXPORT
-  ComputeLowHighPerElement(const std::vector< vtkDataArray* >& values):
-    Values(values)
+  ComputeLowHighPerElement(const ValueType* values,
+                           const dax::Extent3& fullExtent,
+                           const std::vector< dax::cont::UniformGrid< > >& subGrids,
+                           const std::vector< dax::Id3 >& subGridOffsets):
+    Values(values),
+    FullDims(dax::extentDimensions(fullExtent)),
+    SubGrids(&subGrids[0]),
+    SubGridOffsets(&subGridOffsets[0])
   {
   }
 
   DAX_EXEC_EXPORT
   dax::Vector2 operator()(dax::Id index) const
   {
-    const dax::Id size = this->Values[index]->GetNumberOfTuples();
-    const ValueType* rawValues = reinterpret_cast<const ValueType*>(
-                                     this->Values[index]->GetVoidPointer(0));
+    //walk the sub grid's points in place, a row at a time
+    const dax::Id3 dims =
+      dax::extentDimensions(this->SubGrids[index].GetExtent());
+    const dax::Id3& offset = this->SubGridOffsets[index];
 
     dax::Tuple<ValueType,2> lh;
-    lh[0] = rawValues[0];
-    lh[1] = rawValues[0];
-    for(dax::Id i=1; i < size; ++i)
+    lh[0] = lh[1] = this->Values[offset[0] + this->FullDims[0]*(offset[1] +
+                                             this->FullDims[1]*offset[2])];
+    for(dax::Id k=0; k < dims[2]; ++k)
       {
-      lh[0] = std::min(lh[0],rawValues[i]);
-      lh[1] = std::max(lh[1],rawValues[i]);
+      for(dax::Id j=0; j < dims[1]; ++j)
+        {
+        const ValueType* row = this->Values + offset[0] +
+          this->FullDims[0]*((offset[1] + j) + this->FullDims[1]*(offset[2] + k));
+        for(dax::Id i=0; i < dims[0]; ++i)
+          {
+          lh[0] = std::min(lh[0],row[i]);
+          lh[1] = std::max(lh[1],row[i]);
+          }
+        }
       }
     return dax::make_Vector2(lh[0],lh[1]);
   }
-  std::vector< vtkDataArray* > Values;
+
+  const ValueType* Values;
+  dax::Id3 FullDims;
+  const dax::cont::UniformGrid< >* SubGrids;
+  const dax::Id3* SubGridOffsets;
 };
 
 // -----------------------------------------------------------------------------
+//counts the triangles of each cell for all the iso values at once, so the
+//values of the cell are only read once. The iso values are read in place,
+//they must outlive the worklet, which makes it CPU only
 class ContourCount : public dax::exec::WorkletMapCell
 {
 public:
   typedef void ControlSignature(TopologyIn, FieldPointIn, FieldCellOut);
   typedef _3 ExecutionSignature(_2);
 
-  DAX_CONT_EXPORT ContourCount(dax::Scalar isoValue)
-    : IsoValue(isoValue) {  }
+  DAX_CONT_EXPORT ContourCount(const dax::Scalar* isoValues,
+                               dax::Id numIsoValues)
+    : IsoValues(isoValues), NumIsoValues(numIsoValues) {  }
 
   template<class CellTag, class ValueType>
   DAX_EXEC_EXPORT
@@ -157,16 +310,23 @@ public:
           typename dax::CellTraits<CellTag>::CanonicalCellTag());
   }
 private:
-  dax::Scalar IsoValue;
+  const dax::Scalar* IsoValues;
+  dax::Id NumIsoValues;
 
   template<class CellTag, class ValueType>
   DAX_EXEC_EXPORT
   dax::Id GetNumFaces(const dax::exec::CellField<ValueType,CellTag> &values,
                       dax::CellTagHexahedron) const
   {
-    const int voxelClass =
-    dax::worklet::internal::marchingcubes::GetHexahedronClassification(IsoValue,values);
-    return dax::worklet::internal::marchingcubes::NumFaces[voxelClass];
+    dax::Id numFaces = 0;
+    for(dax::Id i=0; i < this->NumIsoValues; ++i)
+      {
+      const int voxelClass =
+      dax::worklet::internal::marchingcubes::GetHexahedronClassification(
+                                                  this->IsoValues[i],values);
+      numFaces += dax::worklet::internal::marchingcubes::NumFaces[voxelClass];
+      }
+    return numFaces;
   }
 };
 
@@ -179,8 +339,10 @@ public:
   typedef void ControlSignature(TopologyIn, GeometryOut, FieldPointIn);
   typedef void ExecutionSignature(AsVertices(_1), _2, _3, VisitIndex);
 
-  DAX_CONT_EXPORT ContourGenerate(dax::Scalar isoValue)
-    : IsoValue(isoValue){ }
+  //the iso values must be the ones given to ContourCount, in the same order
+  DAX_CONT_EXPORT ContourGenerate(const dax::Scalar* isoValues,
+                                  dax::Id numIsoValues)
+    : IsoValues(isoValues), NumIsoValues(numIsoValues) { }
 
   template<class CellTag, class ValueType>
   DAX_EXEC_EXPORT void operator()(
@@ -201,7 +363,8 @@ public:
   }
 
 private:
-  dax::Scalar IsoValue;
+  const dax::Scalar* IsoValues;
+  dax::Id NumIsoValues;
 
   template<class CellTag, class ValueType>
   DAX_EXEC_EXPORT void BuildTriangle(
@@ -219,20 +382,36 @@ private:
         {0,4}, {1,5}, {2,6}, {3,7},
       };
 
-    const int voxelClass =
-        dax::worklet::internal::marchingcubes::GetHexahedronClassification(IsoValue,values);
+    //the triangles of a cell are counted value by value, find the value this
+    //one is for and its index among the triangles of that value
+    using dax::worklet::internal::marchingcubes::NumFaces;
+    dax::Id valueIndex = 0;
+    dax::Id visitIndex = inputCellVisitIndex;
+    int voxelClass =
+        dax::worklet::internal::marchingcubes::GetHexahedronClassification(
+                                         this->IsoValues[valueIndex],values);
+    while(visitIndex >= NumFaces[voxelClass] &&
+          valueIndex + 1 < this->NumIsoValues)
+      {
+      visitIndex -= NumFaces[voxelClass];
+      ++valueIndex;
+      voxelClass =
+        dax::worklet::internal::marchingcubes::GetHexahedronClassification(
+                                         this->IsoValues[valueIndex],values);
+      }
+    const dax::Scalar isoValue = this->IsoValues[valueIndex];
 
     //save the point ids and ratio to interpolate the points of the new cell
     for (dax::Id outVertIndex = 0;
          outVertIndex < outCell.NUM_VERTICES;
          ++outVertIndex)
       {
-      const unsigned char edge = TriTable[voxelClass][(inputCellVisitIndex*3)+outVertIndex];
+      const unsigned char edge = TriTable[voxelClass][(visitIndex*3)+outVertIndex];
       const int vertA = voxelVertEdges[edge][0];
       const int vertB = voxelVertEdges[edge][1];
 
       // Find the weight for linear interpolation
-      const dax::Scalar weight = (IsoValue - values[vertA]) /
+      const dax::Scalar weight = (isoValue - values[vertA]) /
                                 (values[vertB]-values[vertA]);
 
       outCell.SetInterpolationPoint(outVertIndex,
@@ -18,10 +18,12 @@
 #include "vtkAlgorithmOutput.h"
 #include "vtkCompositeDataIterator.h"
 #include "vtkCompositeDataPipeline.h"
+#include "vtkCompositePolyDataMapper2.h"
 #include "vtkGeometryRepresentation.h"
 #include "vtkImageData.h"
 #include "vtkInformation.h"
 #include "vtkInformationVector.h"
+#include "vtkMultiBlockDataSet.h"
 #include "vtkNew.h"
 #include "vtkObjectFactory.h"
 #include "vtkPolyData.h"
@@ -43,12 +45,16 @@ vtkStandardNewMacro(vtkStreamingContourRepresentation);
 //----------------------------------------------------------------------------
 vtkStreamingContourRepresentation::vtkStreamingContourRepresentation()
 {
-  this->ContourValue = 90;
+  this->ContourValues.push_back(90);
+  this->NumberOfSubGridsPerDimension = 0;
+  this->ModifiedVersions[0] = this->ModifiedVersions[1] = 0;
+  this->ModifiedExtent[0] = this->ModifiedExtent[2] = this->ModifiedExtent[4] = 0;
+  this->ModifiedExtent[1] = this->ModifiedExtent[3] = this->ModifiedExtent[5] = -1;
   this->StreamingCapablePipeline = false;
   this->InStreamingUpdate = false;
 
   this->Worker = vtkSmartPointer<vtkStreamingWorker>::New();
-  this->Mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+  this->Mapper = vtkSmartPointer<vtkCompositePolyDataMapper2>::New();
 
   this->Actor = vtkSmartPointer<vtkPVLODActor>::New();
   this->Actor->SetMapper(this->Mapper);
@@ -138,8 +144,21 @@ int vtkStreamingContourRepresentation::ProcessViewRequest(
     assert (this->RenderedData != NULL);
     vtkStreamingStatusMacro( << this << ": received new piece.");
 
-    this->RenderedData = this->Worker->GetFinishedPieces();
-    this->DataBounds.SetBounds(this->RenderedData->GetBounds());
+    vtkMultiBlockDataSet* pieces = this->Worker->GetFinishedPieces();
+    this->RenderedData = pieces;
+
+    vtkBoundingBox bounds;
+    for (unsigned int i = 0; i < pieces->GetNumberOfBlocks(); ++i)
+      {
+      if (vtkPolyData* piece = vtkPolyData::SafeDownCast(pieces->GetBlock(i)))
+        {
+        bounds.AddBounds(piece->GetBounds());
+        }
+      }
+    if (bounds.IsValid())
+      {
+      this->DataBounds = bounds;
+      }
     this->Mapper->SetInputDataObject(this->RenderedData);
     }
 
@@ -200,7 +219,13 @@ int vtkStreamingContourRepresentation::RequestData(vtkInformation *rqst,
       vtkImageData *inputImage = vtkImageData::GetData(inputVector[0],0);
       vtkDataArray *inScalars = this->GetInputArrayToProcess(0,inputVector);
 
-      this->Worker->StartContour(inputImage,inScalars,this->GetContourValue());
+      this->Worker->SetNumberOfSubGridsPerDimension(
+        this->NumberOfSubGridsPerDimension);
+      this->Worker->SetModifiedRegion(
+        static_cast<unsigned long>(this->ModifiedVersions[0]),
+        static_cast<unsigned long>(this->ModifiedVersions[1]),
+        this->ModifiedExtent);
+      this->Worker->StartContour(inputImage,inScalars,this->ContourValues);
       }
     }
 
@@ -249,6 +274,10 @@ bool vtkStreamingContourRepresentation::StreamingUpdate(const double view_planes
 {
   assert(this->InStreamingUpdate == false);
 
+  // Let the worker process the visible parts of the volume first, this also
+  // reorders the remaining parts when the camera moved.
+  this->Worker->SetViewPlanes(view_planes);
+
   if (this->Worker->IsFinished())
     {
     return false;
@@ -312,6 +341,14 @@ void vtkStreamingContourRepresentation::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
   os << indent << "StreamingCapablePipeline: " << this->StreamingCapablePipeline << endl;
+  os << indent << "NumberOfSubGridsPerDimension: "
+     << this->NumberOfSubGridsPerDimension << endl;
+  os << indent << "ContourValues:";
+  for (size_t i = 0; i < this->ContourValues.size(); ++i)
+    {
+    os << " " << this->ContourValues[i];
+    }
+  os << endl;
 }
 
 //----------------------------------------------------------------------------
@@ -346,6 +383,74 @@ void vtkStreamingContourRepresentation::SetInputArrayToProcess(
     }
 }
 
+//----------------------------------------------------------------------------
+void vtkStreamingContourRepresentation::SetModifiedRegion(vtkIdType previousVersion,
+  vtkIdType version, vtkIdType x0, vtkIdType x1, vtkIdType y0,
+  vtkIdType y1, vtkIdType z0, vtkIdType z1)
+{
+  const int extent[6] = {
+    static_cast<int>(x0), static_cast<int>(x1), static_cast<int>(y0),
+    static_cast<int>(y1), static_cast<int>(z0), static_cast<int>(z1) };
+  if (previousVersion == this->ModifiedVersions[0] &&
+      version == this->ModifiedVersions[1] &&
+      std::equal(extent, extent + 6, this->ModifiedExtent))
+    {
+    return;
+    }
+  this->ModifiedVersions[0] = previousVersion;
+  this->ModifiedVersions[1] = version;
+  std::copy(extent, extent + 6, this->ModifiedExtent);
+  // The input changes along with this, which makes the representation
+  // re-execute, so there is no need to mark it modified.
+}
+
+//----------------------------------------------------------------------------
+void vtkStreamingContourRepresentation::SetContourValue(int index, double value)
+{
+  if (index < 0)
+    {
+    return;
+    }
+  if (index >= this->GetNumberOfContourValues())
+    {
+    this->ContourValues.resize(index + 1, value);
+    }
+  else if (this->ContourValues[index] == value)
+    {
+    return;
+    }
+  this->ContourValues[index] = value;
+  this->MarkModified();
+}
+
+//----------------------------------------------------------------------------
+double vtkStreamingContourRepresentation::GetContourValue(int index) const
+{
+  if (index < 0 || index >= this->GetNumberOfContourValues())
+    {
+    return 0.0;
+    }
+  return this->ContourValues[index];
+}
+
+//----------------------------------------------------------------------------
+void vtkStreamingContourRepresentation::SetNumberOfContourValues(int number)
+{
+  number = std::max(number, 0);
+  if (number == this->GetNumberOfContourValues())
+    {
+    return;
+    }
+  this->ContourValues.resize(number, 0.0);
+  this->MarkModified();
+}
+
+//----------------------------------------------------------------------------
+int vtkStreamingContourRepresentation::GetNumberOfContourValues() const
+{
+  return static_cast<int>(this->ContourValues.size());
+}
+
 //----------------------------------------------------------------------------
 void vtkStreamingContourRepresentation::SetLookupTable(vtkScalarsToColors* lut)
 {
@@ -18,10 +18,12 @@
 #include "vtkAlgorithmOutput.h"
 #include "vtkCompositeDataIterator.h"
 #include "vtkCompositeDataPipeline.h"
+#include "vtkCompositePolyDataMapper2.h"
 #include "vtkGeometryRepresentation.h"
 #include "vtkImageData.h"
 #include "vtkInformation.h"
 #include "vtkInformationVector.h"
+#include "vtkMultiBlockDataSet.h"
 #include "vtkNew.h"
 #include "vtkObjectFactory.h"
 #include "vtkPolyData.h"
@@ -43,11 +45,15 @@ vtkStandardNewMacro(vtkStreamingThresholdRepresentation);
 vtkStreamingThresholdRepresentation::vtkStreamingThresholdRepresentation()
 {
   this->ContourValue = 90;
+  this->NumberOfSubGridsPerDimension = 0;
+  this->ModifiedVersions[0] = this->ModifiedVersions[1] = 0;
+  this->ModifiedExtent[0] = this->ModifiedExtent[2] = this->ModifiedExtent[4] = 0;
+  this->ModifiedExtent[1] = this->ModifiedExtent[3] = this->ModifiedExtent[5] = -1;
   this->StreamingCapablePipeline = false;
   this->InStreamingUpdate = false;
 
   this->Worker = vtkSmartPointer<vtkStreamingWorker>::New();
-  this->Mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+  this->Mapper = vtkSmartPointer<vtkCompositePolyDataMapper2>::New();
 
   this->Actor = vtkSmartPointer<vtkPVLODActor>::New();
   this->Actor->SetMapper(this->Mapper);
@@ -197,6 +203,12 @@ int vtkStreamingThresholdRepresentation::RequestData(vtkInformation *rqst,
       // and we should initialize our streaming.
       vtkImageData *input = vtkImageData::GetData(inputVector[0],0);
       vtkDataArray *inScalars = this->GetInputArrayToProcess(0,inputVector);
+      this->Worker->SetNumberOfSubGridsPerDimension(
+        this->NumberOfSubGridsPerDimension);
+      this->Worker->SetModifiedRegion(
+        static_cast<unsigned long>(this->ModifiedVersions[0]),
+        static_cast<unsigned long>(this->ModifiedVersions[1]),
+        this->ModifiedExtent);
       this->Worker->StartThreshold(input,inScalars,this->GetContourValue());
       }
     }
@@ -246,6 +258,10 @@ bool vtkStreamingThresholdRepresentation::StreamingUpdate(const double view_plan
 {
   assert(this->InStreamingUpdate == false);
 
+  // Let the worker process the visible parts of the volume first, this also
+  // reorders the remaining parts when the camera moved.
+  this->Worker->SetViewPlanes(view_planes);
+
   if (this->Worker->IsFinished())
     {
     return false;
@@ -309,6 +325,8 @@ void vtkStreamingThresholdRepresentation::PrintSelf(ostream& os, vtkIndent inden
 {
   this->Superclass::PrintSelf(os, indent);
   os << indent << "StreamingCapablePipeline: " << this->StreamingCapablePipeline << endl;
+  os << indent << "NumberOfSubGridsPerDimension: "
+     << this->NumberOfSubGridsPerDimension << endl;
 }
 
 //----------------------------------------------------------------------------
@@ -343,6 +361,27 @@ void vtkStreamingThresholdRepresentation::SetInputArrayToProcess(
     }
 }
 
+//----------------------------------------------------------------------------
+void vtkStreamingThresholdRepresentation::SetModifiedRegion(vtkIdType previousVersion,
+  vtkIdType version, vtkIdType x0, vtkIdType x1, vtkIdType y0,
+  vtkIdType y1, vtkIdType z0, vtkIdType z1)
+{
+  const int extent[6] = {
+    static_cast<int>(x0), static_cast<int>(x1), static_cast<int>(y0),
+    static_cast<int>(y1), static_cast<int>(z0), static_cast<int>(z1) };
+  if (previousVersion == this->ModifiedVersions[0] &&
+      version == this->ModifiedVersions[1] &&
+      std::equal(extent, extent + 6, this->ModifiedExtent))
+    {
+    return;
+    }
+  this->ModifiedVersions[0] = previousVersion;
+  this->ModifiedVersions[1] = version;
+  std::copy(extent, extent + 6, this->ModifiedExtent);
+  // The input changes along with this, which makes the representation
+  // re-execute, so there is no need to mark it modified.
+}
+
 //----------------------------------------------------------------------------
 void vtkStreamingThresholdRepresentation::SetLookupTable(vtkScalarsToColors* lut)
 {
@@ -84,6 +84,22 @@ public:
   vtkGetMacro(ContourValue,double);
   vtkSetMacro(ContourValue,double);
 
+  // Description:
+  // Get and Set the number of subgrids along each dimension the volume is
+  // streamed in. 0, the default, chooses it from the volume size, the value
+  // type and the number of cores.
+  vtkGetMacro(NumberOfSubGridsPerDimension,int);
+  vtkSetClampMacro(NumberOfSubGridsPerDimension,int,0,VTK_INT_MAX);
+
+  // Description:
+  // Set the region of the last modification of the input: the versions
+  // (modification times) of the input before and after it, and the extent
+  // of the voxels it changed. When the worker's search structure was built
+  // from the version before, only the parts of it in the extent are rebuilt.
+  void SetModifiedRegion(vtkIdType previousVersion, vtkIdType version,
+                         vtkIdType x0, vtkIdType x1, vtkIdType y0,
+                         vtkIdType y1, vtkIdType z0, vtkIdType z1);
+
 //BTX
 protected:
   vtkStreamingThresholdRepresentation();
@@ -161,8 +177,9 @@ protected:
   vtkSmartPointer<vtkDataObject> ProcessedPiece;
 
   // Description:
-  // Helps us keep track of the data being rendered.
-  vtkWeakPointer<vtkPolyData> RenderedData;
+  // Helps us keep track of the data being rendered, a multi-block of the
+  // pieces the worker finished.
+  vtkWeakPointer<vtkDataObject> RenderedData;
 
   // Description:
   // vtkStreamingWorker is a helper class we used to compute the
@@ -170,7 +187,8 @@ protected:
   vtkSmartPointer<vtkStreamingWorker> Worker;
 
   // Description:
-  // Actor used to render the outlines in the view.
+  // Actor used to render the outlines in the view, with a composite mapper
+  // for the multi-block of pieces.
   vtkSmartPointer<vtkPolyDataMapper> Mapper;
   vtkSmartPointer<vtkPVLODActor> Actor;
 
@@ -186,6 +204,15 @@ private:
   // The contour value to operate on
   double ContourValue;
 
+  // Description:
+  // The number of subgrids along each dimension, 0 to choose automatically
+  int NumberOfSubGridsPerDimension;
+
+  // Description:
+  // The last modification of the input, see SetModifiedRegion
+  vtkIdType ModifiedVersions[2];
+  int ModifiedExtent[6];
+
   // Description:
   // This flag is set to true if the input pipeline is streaming capable in
   // RequestInformation(). Note that in client-server mode, this is valid only
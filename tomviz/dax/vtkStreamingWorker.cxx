@@ -19,18 +19,32 @@
 #include "vtkDataArray.h"
 #include "vtkDataObject.h"
 #include "vtkDataSet.h"
+#include "vtkFloatArray.h"
 #include "vtkImageData.h"
 #include "vtkInformation.h"
 #include "vtkInformationVector.h"
+#include "vtkMultiBlockDataSet.h"
 #include "vtkObjectFactory.h"
 #include "vtkNew.h"
+#include "vtkPointData.h"
 
 #include "SubdividedVolume.h"
 
+#include "tbb/atomic.h"
+#include "tbb/blocked_range.h"
+#include "tbb/concurrent_queue.h"
+#include "tbb/parallel_for.h"
 #include "tbb/tbb_thread.h"
 #include "tbb/spin_mutex.h"
+#include "tbb/task_scheduler_init.h"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
 
 namespace
 {
@@ -60,37 +74,52 @@ namespace
       }                                                                    \
     )
 
-template<typename GridType>
-void combine_grids(std::vector<GridType>& grids,
+template<typename OutputType>
+void combine_grids(std::vector<OutputType>& outputs,
                    std::vector<dax::Vector3>& points,
-                   std::vector<dax::Id>& cellConns)
+                   std::vector<dax::Id>& cellConns,
+                   std::vector<dax::Scalar>& pointValues,
+                   std::vector<dax::Vector3>& pointNormals)
 {
-  typedef typename std::vector<GridType>::iterator IteratorType;
+  typedef typename std::vector<OutputType>::iterator IteratorType;
   const std::size_t existingNumPoints = points.size();
   const std::size_t existingNumCellIds = cellConns.size();
 
   std::size_t numNewPoints = 0;
   std::size_t numNewCellIds = 0;
-  for(IteratorType grid = grids.begin(); grid != grids.end(); ++grid)
+  bool hasNormals = !pointNormals.empty();
+  for(IteratorType output = outputs.begin(); output != outputs.end(); ++output)
     {
-    numNewPoints += static_cast<std::size_t>(grid->GetNumberOfPoints());
+    numNewPoints += static_cast<std::size_t>(output->Grid.GetNumberOfPoints());
+    hasNormals = hasNormals || output->PointNormals.GetNumberOfValues() > 0;
     //we need the size of the cell connection array not the num of cells
     numNewCellIds += static_cast<std::size_t>(
-                              grid->GetCellConnections().GetNumberOfValues());
+                      output->Grid.GetCellConnections().GetNumberOfValues());
     }
 
   //resize the vectors
   points.resize( points.size() + numNewPoints );
   cellConns.resize( cellConns.size() + numNewCellIds );
+  pointValues.resize( pointValues.size() + numNewPoints );
+  if(hasNormals)
+    {
+    pointNormals.resize( points.size() );
+    }
 
   std::size_t pointOffset = existingNumPoints;
   std::size_t cellIdOffset = existingNumCellIds;
-  for(IteratorType grid = grids.begin(); grid != grids.end(); ++grid)
+  for(IteratorType output = outputs.begin(); output != outputs.end(); ++output)
     {
-    //copy the points, and than move the offset pointer to account for the
-    //new points we have copied in
-    grid->GetPointCoordinates().CopyInto(points.begin() + pointOffset);
+    const typename OutputType::GridType* grid = &output->Grid;
 
+    //copy the points and their values, and than move the offset pointer to
+    //account for the new points we have copied in
+    grid->GetPointCoordinates().CopyInto(points.begin() + pointOffset);
+    output->PointValues.CopyInto(pointValues.begin() + pointOffset);
+    if(output->PointNormals.GetNumberOfValues() > 0)
+      {
+      output->PointNormals.CopyInto(pointNormals.begin() + pointOffset);
+      }
 
     //copy the cell conns, and than move the offset pointer to account for the
     //new cell conns we have copied in
@@ -112,33 +141,491 @@ void combine_grids(std::vector<GridType>& grids,
     }
 
   //now that the values in grids are in points and cells, we clear grids.
-  grids.clear();
+  outputs.clear();
 }
 
 
+//collects the subgrids in the order the tasks finish them, and appends them
+//to the output in batches. Each batch is converted once, into a polydata
+//appended as a new block of the output, so the blocks are never modified
+//once they are in the output and can be shared with the renderer. The
+//values of the points are named after the input array
+template<typename OutputType>
+class SubGridCollector
+{
+  //need a special temp grid type since the grids can use virtual topology
+  //and we can't use that when we are copying concrete cellConns
+  typedef dax::cont::UnstructuredGrid<
+    typename OutputType::GridType::CellTag > TempGridType;
+
+public:
+  //----------------------------------------------------------------------------
+  SubGridCollector(vtkSmartPointer<vtkMultiBlockDataSet>& outputData,
+                   MutexType* outputDataMutex,
+                   const std::string& valuesName):
+    VTKOutputData(outputData),
+    OutputDataMutex(outputDataMutex),
+    ValuesName(valuesName),
+    Pending(),
+    CollectMutex(),
+    GridsPendingCollection(),
+    ConversionTime(0)
+  {
+    this->NumProcessed = 0;
+  }
+
+  //----------------------------------------------------------------------------
+  //called by the tasks, this is lock free
+  void push(const OutputType& output) { this->Pending.push(output); }
+
+  //----------------------------------------------------------------------------
+  //called by the tasks once per subgrid. Every 50 subgrids the task that
+  //gets there appends the pending grids to the output, unless another task
+  //is already doing so
+  void processed()
+  {
+    if(++this->NumProcessed % 50 == 0)
+      {
+      MutexType::scoped_lock lock;
+      if(lock.try_acquire(this->CollectMutex))
+        {
+        this->collect();
+        }
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  //append all pending grids to the output
+  void collect()
+  {
+    OutputType output;
+    while(this->Pending.try_pop(output))
+      {
+      this->GridsPendingCollection.push_back(output);
+      }
+    if(this->GridsPendingCollection.empty())
+      {
+      return;
+      }
+
+    dax::cont::Timer<> conv_timer;
+    std::vector<dax::Vector3> points;
+    std::vector<dax::Id> cellConns;
+    std::vector<dax::Scalar> pointValues;
+    std::vector<dax::Vector3> pointNormals;
+    combine_grids(this->GridsPendingCollection,points,cellConns,pointValues,
+                  pointNormals);
+
+    //make a dax grid structure around the std vector(s), this is basically
+    //a free operation
+    TempGridType tempGrid( dax::cont::make_ArrayHandle(cellConns),
+                           dax::cont::make_ArrayHandle(points));
+
+    vtkNew<vtkPolyData> piece;
+    convertPoints(tempGrid,piece.GetPointer());
+    convertCells(tempGrid,piece.GetPointer());
+
+    vtkNew<vtkFloatArray> values;
+    values->SetName(this->ValuesName.c_str());
+    values->SetNumberOfTuples(static_cast<vtkIdType>(pointValues.size()));
+    std::copy(pointValues.begin(), pointValues.end(), values->GetPointer(0));
+    piece->GetPointData()->SetScalars(values.GetPointer());
+
+    //the normals are the interpolated gradients, normalize them
+    if(!pointNormals.empty())
+      {
+      vtkNew<vtkFloatArray> normals;
+      normals->SetName("Normals");
+      normals->SetNumberOfComponents(3);
+      normals->SetNumberOfTuples(static_cast<vtkIdType>(pointNormals.size()));
+      float* normal = normals->GetPointer(0);
+      for(std::size_t i=0; i < pointNormals.size(); ++i, normal += 3)
+        {
+        const dax::Vector3& n = pointNormals[i];
+        const double length = std::sqrt(static_cast<double>(
+                                         n[0]*n[0] + n[1]*n[1] + n[2]*n[2]));
+        const double scale = length > 0 ? 1.0 / length : 0.0;
+        for(int j=0; j < 3; ++j)
+          {
+          normal[j] = static_cast<float>(n[j] * scale);
+          }
+        }
+      piece->GetPointData()->SetNormals(normals.GetPointer());
+      }
+
+    //only appending the block is done under the lock
+    MutexType::scoped_lock lock(*this->OutputDataMutex);
+    this->VTKOutputData->SetBlock(this->VTKOutputData->GetNumberOfBlocks(),
+                                  piece.GetPointer());
+    this->ConversionTime += conv_timer.GetElapsedTime();
+  }
+
+  //----------------------------------------------------------------------------
+  double conversionTime() const { return this->ConversionTime; }
+
+private:
+  vtkSmartPointer<vtkMultiBlockDataSet>& VTKOutputData;
+  MutexType* OutputDataMutex;
+  std::string ValuesName;
+
+  tbb::concurrent_queue<OutputType> Pending;
+  tbb::atomic<std::size_t> NumProcessed;
+  MutexType CollectMutex;
+
+  std::vector<OutputType> GridsPendingCollection;
+  double ConversionTime;
+};
+
+//hands out the valid subgrids to the tasks, the visible ones first, front to
+//back, followed by the ones outside the view frustum. Setting new view planes
+//reorders the subgrids that haven't been handed out yet.
+class SubGridQueue
+{
+public:
+  //----------------------------------------------------------------------------
+  SubGridQueue():
+    Mutex(),
+    Volume(NULL),
+    Order(),
+    Next(0),
+    HaveViewPlanes(false)
+  {
+  }
+
+  //----------------------------------------------------------------------------
+  void reset(const tomviz::accel::SubdividedVolume* volume,
+             const std::vector<std::size_t>& subGrids)
+  {
+    MutexType::scoped_lock lock(this->Mutex);
+    this->Volume = volume;
+    this->Order = subGrids;
+    this->Next = 0;
+    this->sortRemaining();
+  }
+
+  //----------------------------------------------------------------------------
+  void clear() { this->reset(NULL, std::vector<std::size_t>()); }
+
+  //----------------------------------------------------------------------------
+  //takes the subgrid with the highest priority, returns false when none is left
+  bool pop(std::size_t& index)
+  {
+    MutexType::scoped_lock lock(this->Mutex);
+    if(this->Next >= this->Order.size())
+      {
+      return false;
+      }
+    index = this->Order[this->Next++];
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  //the 6 planes of the view frustum as given by vtkCamera::GetFrustumPlanes,
+  //with normals pointing inside
+  void setViewPlanes(const double planes[24])
+  {
+    MutexType::scoped_lock lock(this->Mutex);
+    if(this->HaveViewPlanes &&
+       std::equal(planes, planes + 24, this->ViewPlanes))
+      {
+      return;
+      }
+    std::copy(planes, planes + 24, this->ViewPlanes);
+    this->HaveViewPlanes = true;
+    this->sortRemaining();
+  }
+
+private:
+  typedef std::pair<std::pair<bool, double>, std::size_t> PriorityType;
+
+  //----------------------------------------------------------------------------
+  //sorts the subgrids that haven't been handed out yet, must hold the lock
+  void sortRemaining()
+  {
+    if(!this->HaveViewPlanes || !this->Volume ||
+       this->Next >= this->Order.size())
+      {
+      return;
+      }
+
+    std::vector<PriorityType> priorities;
+    priorities.reserve(this->Order.size() - this->Next);
+    for(std::size_t i=this->Next; i < this->Order.size(); ++i)
+      {
+      priorities.push_back(PriorityType(this->priority(this->Order[i]),
+                                        this->Order[i]));
+      }
+    std::sort(priorities.begin(), priorities.end());
+    for(std::size_t i=0; i < priorities.size(); ++i)
+      {
+      this->Order[this->Next + i] = priorities[i].second;
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  //whether the subgrid is outside the frustum, and the distance of its center
+  //from the near plane
+  std::pair<bool, double> priority(std::size_t index) const
+  {
+    double bounds[6];
+    this->Volume->subGridBounds(index, bounds);
+
+    bool outside = false;
+    for(int p=0; p < 6 && !outside; ++p)
+      {
+      //the corner furthest along the normal, if it is outside the plane the
+      //whole box is
+      const double* plane = this->ViewPlanes + 4*p;
+      double distance = plane[3];
+      for(int i=0; i < 3; ++i)
+        {
+        distance += plane[i] * bounds[2*i + (plane[i] > 0 ? 1 : 0)];
+        }
+      outside = distance < 0;
+      }
+
+    const double* nearPlane = this->ViewPlanes + 16;
+    double distance = nearPlane[3];
+    for(int i=0; i < 3; ++i)
+      {
+      distance += nearPlane[i] * 0.5 * (bounds[2*i] + bounds[2*i+1]);
+      }
+    return std::make_pair(outside, distance);
+  }
+
+  MutexType Mutex;
+  const tomviz::accel::SubdividedVolume* Volume;
+  std::vector<std::size_t> Order;
+  std::size_t Next;
+  bool HaveViewPlanes;
+  double ViewPlanes[24];
+};
+
+//keeps the outputs of the most recently used subgrids, keyed by the values
+//in the subgrid and the subgrid, up to a number of bytes. The worker drops
+//the outputs of subgrids whose data changed. The grids share their arrays
+//with the outputs, so a hit costs no copy.
+template<typename OutputType>
+class SubGridCache
+{
+  typedef std::pair<std::vector<dax::Scalar>, std::size_t> KeyType;
+  typedef std::list<KeyType> UseListType;
+
+  struct Entry
+  {
+    Entry(const OutputType& output, std::size_t bytes,
+          typename UseListType::iterator use):
+      Output(output), Bytes(bytes), Use(use) {}
+
+    OutputType Output;
+    std::size_t Bytes;
+    typename UseListType::iterator Use;
+  };
+  typedef std::map<KeyType, Entry> EntriesType;
+
+public:
+  //----------------------------------------------------------------------------
+  SubGridCache(std::size_t maxBytes):
+    Mutex(),
+    MaxBytes(maxBytes),
+    Bytes(0),
+    Entries(),
+    Uses()
+  {
+  }
+
+  //----------------------------------------------------------------------------
+  void clear()
+  {
+    MutexType::scoped_lock lock(this->Mutex);
+    this->clearLocked();
+  }
+
+  //----------------------------------------------------------------------------
+  //drops the outputs of the given subgrids, which must be sorted
+  void erase(const std::vector<std::size_t>& subGrids)
+  {
+    MutexType::scoped_lock lock(this->Mutex);
+    typename EntriesType::iterator entry = this->Entries.begin();
+    while(entry != this->Entries.end())
+      {
+      if(std::binary_search(subGrids.begin(), subGrids.end(),
+                            entry->first.second))
+        {
+        this->Bytes -= entry->second.Bytes;
+        this->Uses.erase(entry->second.Use);
+        this->Entries.erase(entry++);
+        }
+      else
+        {
+        ++entry;
+        }
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  bool find(const std::vector<dax::Scalar>& values, std::size_t subGrid,
+            OutputType& output)
+  {
+    MutexType::scoped_lock lock(this->Mutex);
+    typename EntriesType::iterator entry =
+      this->Entries.find(KeyType(values, subGrid));
+    if(entry == this->Entries.end())
+      {
+      return false;
+      }
+    //mark it as the most recently used
+    this->Uses.splice(this->Uses.begin(), this->Uses, entry->second.Use);
+    output = entry->second.Output;
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  void insert(const std::vector<dax::Scalar>& values, std::size_t subGrid,
+              const OutputType& output)
+  {
+    const std::size_t bytes =
+      static_cast<std::size_t>(output.Grid.GetNumberOfPoints()) *
+      (sizeof(dax::Vector3) + sizeof(dax::Scalar)) +
+      static_cast<std::size_t>(output.PointNormals.GetNumberOfValues()) *
+      sizeof(dax::Vector3) +
+      static_cast<std::size_t>(
+        output.Grid.GetCellConnections().GetNumberOfValues()) * sizeof(dax::Id);
+    if(bytes > this->MaxBytes)
+      {
+      return;
+      }
+
+    MutexType::scoped_lock lock(this->Mutex);
+    const KeyType key(values, subGrid);
+    if(this->Entries.find(key) != this->Entries.end())
+      {
+      return;
+      }
+
+    //evict the least recently used outputs until the new one fits
+    while(!this->Uses.empty() && this->Bytes + bytes > this->MaxBytes)
+      {
+      typename EntriesType::iterator lru = this->Entries.find(this->Uses.back());
+      this->Bytes -= lru->second.Bytes;
+      this->Entries.erase(lru);
+      this->Uses.pop_back();
+      }
+
+    this->Uses.push_front(key);
+    this->Entries.insert(std::make_pair(key,
+                                        Entry(output, bytes, this->Uses.begin())));
+    this->Bytes += bytes;
+  }
+
+private:
+  //----------------------------------------------------------------------------
+  void clearLocked()
+  {
+    this->Entries.clear();
+    this->Uses.clear();
+    this->Bytes = 0;
+  }
+
+  MutexType Mutex;
+  std::size_t MaxBytes;
+  std::size_t Bytes;
+  EntriesType Entries;
+  //the keys, from the most to the least recently used
+  UseListType Uses;
+};
+
+//the tbb::parallel_for body that contours or thresholds the valid subgrids,
+//each iteration processes the next subgrid of the queue for all the values
+//in its range at once, unless its output is in the cache
+template<typename Functor, typename ValueType, typename LoggerType>
+struct SubGridsBody
+{
+  typedef typename Functor::ReturnType OutputGridType;
+
+  Functor Function;
+  const std::vector<dax::Scalar>& Values;
+  SubGridQueue& Queue;
+  SubGridCache<OutputGridType>& Cache;
+  SubGridCollector<OutputGridType>& Collector;
+  tbb::atomic<bool>& ContinueWorking;
+  LoggerType& Logger;
+
+  //----------------------------------------------------------------------------
+  SubGridsBody(Functor functor, const std::vector<dax::Scalar>& v,
+               SubGridQueue& queue,
+               SubGridCache<OutputGridType>& cache,
+               SubGridCollector<OutputGridType>& collector,
+               tbb::atomic<bool>& keepProcessing,
+               LoggerType& logger):
+    Function(functor),
+    Values(v),
+    Queue(queue),
+    Cache(cache),
+    Collector(collector),
+    ContinueWorking(keepProcessing),
+    Logger(logger)
+  {
+  }
+
+  //----------------------------------------------------------------------------
+  void operator()(const tbb::blocked_range<std::size_t>& range) const
+  {
+    Functor functor(this->Function);
+    std::size_t index;
+    std::vector<dax::Scalar> values;
+    for(std::size_t i=range.begin(); i != range.end() && this->ContinueWorking &&
+        this->Queue.pop(index); ++i)
+      {
+      functor.Volume.validValues(index, this->Values, values);
+
+      OutputGridType grid;
+      if(!this->Cache.find(values, index, grid))
+        {
+        grid = functor(values, index, ValueType(), this->Logger);
+        this->Cache.insert(values, index, grid);
+        }
+      this->Collector.push(grid);
+      this->Collector.processed();
+      }
+  }
+};
+
 template<typename LoggerType>
 struct ComputeFunctor
 {
   vtkStreamingWorker::AlgorithmMode Mode;
   tomviz::accel::SubdividedVolume& Volume;
-  vtkSmartPointer<vtkPolyData>& VTKOutputData;
+  SubGridQueue& Queue;
+  SubGridCache<tomviz::accel::ContourFunctor::ReturnType>& ContourCache;
+  SubGridCache<tomviz::accel::PointCloudFunctor::ReturnType>& PointCloudCache;
+  vtkSmartPointer<vtkMultiBlockDataSet>& VTKOutputData;
   MutexType* OutputDataMutex;
+  std::string ValuesName;
   LoggerType& Logger;
-  bool& ContinueWorking;
+  tbb::atomic<bool>& ContinueWorking;
   bool& FinishedWorkingOnData;
 
   //----------------------------------------------------------------------------
   ComputeFunctor(vtkStreamingWorker::AlgorithmMode mode,
                  tomviz::accel::SubdividedVolume& volume,
-                 vtkSmartPointer<vtkPolyData>& outputData,
+                 SubGridQueue& queue,
+                 SubGridCache<tomviz::accel::ContourFunctor::ReturnType>& contourCache,
+                 SubGridCache<tomviz::accel::PointCloudFunctor::ReturnType>& pointCloudCache,
+                 vtkSmartPointer<vtkMultiBlockDataSet>& outputData,
                  MutexType* outputDaxMutex,
-                 bool& keepProcessing,
+                 const std::string& valuesName,
+                 tbb::atomic<bool>& keepProcessing,
                  bool& finishedWorkingOnData,
                  LoggerType& logger):
     Mode(mode),
     Volume(volume),
+    Queue(queue),
+    ContourCache(contourCache),
+    PointCloudCache(pointCloudCache),
     VTKOutputData(outputData),
     OutputDataMutex(outputDaxMutex),
+    ValuesName(valuesName),
     Logger(logger),
     ContinueWorking(keepProcessing),
     FinishedWorkingOnData(finishedWorkingOnData)
@@ -146,91 +633,67 @@ struct ComputeFunctor
   }
 
   //----------------------------------------------------------------------------
+  //the values are sorted and unique
   template<typename ValueType>
-  void operator()(double v, ValueType)
+  void operator()(const std::vector<dax::Scalar>& v, ValueType)
   {
 
   //wrap up this->Volume.method as a function argument
   if(this->Mode == vtkStreamingWorker::CONTOUR)
     {
     tomviz::accel::ContourFunctor functor(this->Volume);
-    this->run(functor, v, ValueType());
+    this->run(functor, this->ContourCache, v, ValueType());
     }
   else if(this->Mode == vtkStreamingWorker::POINTCLOUD)
     {
     tomviz::accel::PointCloudFunctor functor(this->Volume);
-    this->run(functor, v, ValueType());
+    this->run(functor, this->PointCloudCache, v, ValueType());
     }
   }
 
   //----------------------------------------------------------------------------
   template<typename Functor, typename ValueType>
-  void run(Functor functor, double v, ValueType)
+  void run(Functor functor,
+           SubGridCache<typename Functor::ReturnType>& cache,
+           const std::vector<dax::Scalar>& v, ValueType)
   {
   dax::cont::Timer<> timer;
-  dax::cont::Timer<> conv_timer; double dataconv_time = 0;
 
   const std::size_t totalSubGrids = this->Volume.numSubGrids();
   typedef typename Functor::ReturnType OutputGridType;
 
-  //need a special temp grid type since OutputGridType can use virtual topology
-  //and we can't use that when we are copying concrete cellConns
-  typedef dax::cont::UnstructuredGrid< typename OutputGridType::CellTag > TempGridType;
-
-  //lightweight storage of combined points and cells
-  std::vector<OutputGridType> gridsPendingCollection;
-  std::vector<dax::Vector3> points;
-  std::vector<dax::Id> cellConns;
-
-  bool haveMoreData=false;
-  for(std::size_t i=0; i < totalSubGrids && this->ContinueWorking; ++i)
-    {
-    if(this->ContinueWorking && this->Volume.isValidSubGrid(i, v))
-      {
-      OutputGridType outputGrid = functor(v, i, ValueType(), this->Logger );
-      gridsPendingCollection.push_back(outputGrid);
-
-      haveMoreData=true;
-      }
-    if(i%50==0 && haveMoreData && this->ContinueWorking)
-      {
-      conv_timer.Reset();
-      combine_grids(gridsPendingCollection,points,cellConns);
-
-      //make a dax grid structure around the std vector(s), this is basically
-      //a free operation
-      TempGridType tempGrid( dax::cont::make_ArrayHandle(cellConns),
-                             dax::cont::make_ArrayHandle(points));
-
-      MutexType::scoped_lock lock(*this->OutputDataMutex);
-      convertPoints(tempGrid,this->VTKOutputData);
-      convertCells(tempGrid,this->VTKOutputData);
-      dataconv_time += conv_timer.GetElapsedTime();
-
-      haveMoreData = false;
-      }
-    }
+  //find the subgrids that contain any of the values from the low/high tree,
+  //instead of checking them one by one
+  std::vector<std::size_t> validSubGrids;
+  this->Volume.validSubGrids(v, validSubGrids);
+  this->Logger << validSubGrids.size() << " of " << totalSubGrids
+               << " sub grids are valid" << std::endl;
+  this->Queue.reset(&this->Volume, validSubGrids);
+
+  //process the subgrids concurrently, one task per subgrid, as the DAX
+  //parallelism inside a single subgrid doesn't keep all cores busy. The
+  //tasks take the subgrids in the order of the queue, and the finished
+  //subgrids are appended to the output in the order they finish.
+  SubGridCollector<OutputGridType> collector(this->VTKOutputData,
+                                             this->OutputDataMutex,
+                                             this->ValuesName);
+  SubGridsBody<Functor, ValueType, LoggerType> body(functor, v,
+                                                    this->Queue,
+                                                    cache,
+                                                    collector,
+                                                    this->ContinueWorking,
+                                                    this->Logger);
+  tbb::parallel_for(
+    tbb::blocked_range<std::size_t>(0, validSubGrids.size(), 1), body);
 
   //append any remaining subgrids
-  if(haveMoreData && this->ContinueWorking)
+  if(this->ContinueWorking)
     {
-    conv_timer.Reset();
-    combine_grids(gridsPendingCollection,points,cellConns);
-
-    //make a dax grid structure around the std vector(s), this is basically
-    //a free operation
-    TempGridType tempGrid( dax::cont::make_ArrayHandle(cellConns),
-                           dax::cont::make_ArrayHandle(points));
-
-    MutexType::scoped_lock lock(*this->OutputDataMutex);
-    convertPoints(tempGrid,this->VTKOutputData);
-    convertCells(tempGrid,this->VTKOutputData);
-    dataconv_time += conv_timer.GetElapsedTime();
-
-    haveMoreData = false;
+    collector.collect();
     }
 
   double full_time = timer.GetElapsedTime();
+  double dataconv_time = collector.conversionTime();
   double alg_time = full_time - dataconv_time;
   this->Logger << "algorithm time: " << alg_time << std::endl;
   this->Logger << "data conversion time: " << dataconv_time << std::endl;
@@ -247,19 +710,29 @@ vtkStandardNewMacro(vtkStreamingWorker)
 class vtkStreamingWorker::WorkerInternals
 {
 public:
+  //bytes of subgrid outputs kept by each of the contour and threshold caches
+  enum { CacheBytes = 256 * 1024 * 1024 };
+
   //----------------------------------------------------------------------------
   WorkerInternals(std::size_t numSubGridsPerDim):
     Thread(),
-    ContinueWorking(false),
     FinishedWorkingOnData(false),
     CurrentRenderDataFinished(false),
     Volume(),
+    Queue(),
+    ContourCache(CacheBytes),
+    PointCloudCache(CacheBytes),
     ComputedData(),
     CurrentRenderData(),
-    NumSubGridsPerDim(numSubGridsPerDim)
+    NumSubGridsPerDim(numSubGridsPerDim),
+    BuiltVersion(0)
   {
-    this->ComputedData = vtkSmartPointer<vtkPolyData>::New();
-    this->CurrentRenderData = vtkSmartPointer<vtkPolyData>::New();
+    //tbb::atomic has no constructors, so it is set here
+    this->ContinueWorking = false;
+    const int emptyExtent[6] = { 0, -1, 0, -1, 0, -1 };
+    this->SetModifiedRegion(0, 0, emptyExtent);
+    this->ComputedData = vtkSmartPointer<vtkMultiBlockDataSet>::New();
+    this->CurrentRenderData = vtkSmartPointer<vtkMultiBlockDataSet>::New();
   }
 
   //----------------------------------------------------------------------------
@@ -279,9 +752,47 @@ public:
   //----------------------------------------------------------------------------
   bool IsValid() const { return this->Volume.numSubGrids() > 0; }
 
+  //----------------------------------------------------------------------------
+  std::size_t GetNumSubGridsPerDim() const { return this->NumSubGridsPerDim; }
+
+  //----------------------------------------------------------------------------
+  void SetNumSubGridsPerDim(std::size_t numSubGridsPerDim)
+  {
+    if(numSubGridsPerDim == this->NumSubGridsPerDim)
+      {
+      return;
+      }
+
+    //stop the thread before dropping the volume it works on
+    if(this->Thread.joinable())
+      {
+      this->ContinueWorking = false;
+      this->Thread.join();
+      }
+    this->NumSubGridsPerDim = numSubGridsPerDim;
+    this->Queue.clear();
+    this->ContourCache.clear();
+    this->PointCloudCache.clear();
+    this->Volume = tomviz::accel::SubdividedVolume();
+  }
+
   //----------------------------------------------------------------------------
   void StopWork() { this->ContinueWorking = false; }
 
+  //----------------------------------------------------------------------------
+  void SetViewPlanes(const double planes[24])
+    { this->Queue.setViewPlanes(planes); }
+
+  //----------------------------------------------------------------------------
+  void SetModifiedRegion(unsigned long previousVersion,
+                         unsigned long version,
+                         const int extent[6])
+  {
+    this->ModifiedVersions[0] = previousVersion;
+    this->ModifiedVersions[1] = version;
+    std::copy(extent, extent + 6, this->ModifiedExtent);
+  }
+
   //----------------------------------------------------------------------------
   bool IsFinished() const
   {
@@ -299,7 +810,8 @@ public:
   template<class IteratorType, class LoggerType>
   bool Run(vtkStreamingWorker::AlgorithmMode mode,
            vtkImageData* input,
-           double isoValue,
+           vtkDataArray* data,
+           const std::vector<double>& isoValues,
            IteratorType begin,
            IteratorType end,
            LoggerType& logger)
@@ -320,66 +832,151 @@ public:
     this->CurrentRenderDataFinished = false;
 
     //clear the appender
-    this->ComputedData = vtkSmartPointer<vtkPolyData>::New();
+    this->ComputedData = vtkSmartPointer<vtkMultiBlockDataSet>::New();
+
+    //the queue refers to the subgrids of the volume, which may be rebuilt
+    this->Queue.clear();
+
+    //when the data changed, only the subgrids in the modified region need
+    //their low/high and cached outputs updated, provided the modification
+    //is the one from the version the volume was built from to this one and
+    //the geometry didn't change. Otherwise everything is rebuilt, also when
+    //another array is processed.
+    const unsigned long version = input->GetMTime();
+    if(this->Volume.numSubGrids() > 0 &&
+       (version != this->BuiltVersion || this->Volume.values() != data))
+      {
+      std::vector<std::size_t> modifiedSubGrids;
+      if(this->Volume.values() == data &&
+         this->ModifiedVersions[0] == this->BuiltVersion &&
+         this->ModifiedVersions[1] == version &&
+         this->Volume.hasGeometryOf(input))
+        {
+        this->Volume.subGridsIntersecting(this->ModifiedExtent,
+                                          modifiedSubGrids);
+        this->Volume.UpdateHighLows( data, begin, modifiedSubGrids, logger );
+        this->PointCloudCache.erase(modifiedSubGrids);
+
+        //the contour normals are gradients that read one voxel past each
+        //subgrid, so the contours next to the modified region are stale too.
+        //An empty region stays empty.
+        int normalsExtent[6];
+        std::copy(this->ModifiedExtent, this->ModifiedExtent + 6,
+                  normalsExtent);
+        const int* wholeExtent = input->GetExtent();
+        for(int i=0; i < 3 &&
+            this->ModifiedExtent[2*i] <= this->ModifiedExtent[2*i+1]; ++i)
+          {
+          normalsExtent[2*i] = std::max(this->ModifiedExtent[2*i] - 1,
+                                        wholeExtent[2*i]);
+          normalsExtent[2*i+1] = std::min(this->ModifiedExtent[2*i+1] + 1,
+                                          wholeExtent[2*i+1]);
+          }
+        std::vector<std::size_t> contourSubGrids;
+        this->Volume.subGridsIntersecting(normalsExtent, contourSubGrids);
+        this->ContourCache.erase(contourSubGrids);
+        }
+      else
+        {
+        this->Volume = tomviz::accel::SubdividedVolume();
+        }
+      this->BuiltVersion = version;
+      }
 
     if(this->Volume.numSubGrids() == 0)
       {
+      this->ContourCache.clear();
+      this->PointCloudCache.clear();
+      this->BuiltVersion = version;
+
+      //unless told otherwise, size the subgrids to the volume, its value
+      //type and the number of cores
+      const dax::Id n = static_cast<dax::Id>(this->NumSubGridsPerDim);
+      dax::Id3 subGridsPerDim = dax::make_Id3(n,n,n);
+      if(n == 0)
+        {
+        subGridsPerDim = tomviz::accel::SubdividedVolume::ChooseSubGridsPerDim(
+          input->GetExtent(),
+          sizeof(ValueType),
+          tbb::task_scheduler_init::default_num_threads());
+        }
+
       logger << "CreateSearchStructure" << std::endl;
-      this->Volume = tomviz::accel::SubdividedVolume( this->NumSubGridsPerDim,
+      this->Volume = tomviz::accel::SubdividedVolume( subGridsPerDim,
                                                    input,
                                                    logger );
 
       logger << "ComputeHighLows" << std::endl;
-      this->Volume.ComputeHighLows( begin, end, logger );
+      this->Volume.ComputeHighLows( data, begin, end, logger );
       }
 
 
+    //all the values are processed in the same pass over the subgrids, each
+    //only once and in increasing order
+    std::vector<dax::Scalar> values(isoValues.begin(), isoValues.end());
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+
     //now give the thread the volume to contour
     ComputeFunctor<LoggerType> functor(mode,
                                        this->Volume,
+                                       this->Queue,
+                                       this->ContourCache,
+                                       this->PointCloudCache,
                                        this->ComputedData,
                                        &this->ComputedDataMutex,
+                                       data->GetName() ? data->GetName() : "",
                                        this->ContinueWorking,
                                        this->FinishedWorkingOnData,
                                        logger);
-    tbb::tbb_thread t(functor, isoValue, ValueType());
+    tbb::tbb_thread t(functor, values, ValueType());
     this->Thread.swap(t);
 
     return true;
   }
 
 //----------------------------------------------------------------------------
-vtkSmartPointer<vtkPolyData> GetFinishedPieces()
+vtkSmartPointer<vtkMultiBlockDataSet> GetFinishedPieces()
 {
+  //the shallow copy only shares the pieces, which are never modified once
+  //they are in ComputedData
   MutexType::scoped_lock lock(this->ComputedDataMutex);
-  if(this->ComputedData->GetNumberOfCells() > 0 &&
-     this->ComputedData->GetNumberOfPoints() > 0)
+  if(this->ComputedData->GetNumberOfBlocks() > 0)
     {
     CurrentRenderData->ShallowCopy(this->ComputedData);
     }
   this->CurrentRenderDataFinished = this->FinishedWorkingOnData;
-  std::cout << "GetFinishedPieces" << std::endl;
 
   return this->CurrentRenderData;
 }
 
 private:
   tbb::tbb_thread Thread;
-  bool ContinueWorking;
+  //read by the worker tasks while the main thread may clear it
+  tbb::atomic<bool> ContinueWorking;
   bool FinishedWorkingOnData;
   bool CurrentRenderDataFinished;
 
   tomviz::accel::SubdividedVolume Volume;
-  vtkSmartPointer<vtkPolyData> ComputedData;
-  vtkSmartPointer<vtkPolyData> CurrentRenderData;
+  SubGridQueue Queue;
+  SubGridCache<tomviz::accel::ContourFunctor::ReturnType> ContourCache;
+  SubGridCache<tomviz::accel::PointCloudFunctor::ReturnType> PointCloudCache;
+  vtkSmartPointer<vtkMultiBlockDataSet> ComputedData;
+  vtkSmartPointer<vtkMultiBlockDataSet> CurrentRenderData;
   MutexType ComputedDataMutex;
 
   std::size_t NumSubGridsPerDim;
+
+  //the version of the data the volume was built from, and the last region
+  //modified as told by SetModifiedRegion
+  unsigned long BuiltVersion;
+  unsigned long ModifiedVersions[2];
+  int ModifiedExtent[6];
 };
 
 //----------------------------------------------------------------------------
 vtkStreamingWorker::vtkStreamingWorker():
-  Internals( new vtkStreamingWorker::WorkerInternals(8) ),
+  Internals( new vtkStreamingWorker::WorkerInternals(0) ),
   ValidWorkerInput(true)
 {
 }
@@ -393,7 +990,7 @@ vtkStreamingWorker::~vtkStreamingWorker()
 //----------------------------------------------------------------------------
 void vtkStreamingWorker::StartContour(vtkImageData* image,
                                       vtkDataArray* data,
-                                      double isoValue)
+                                      const std::vector<double>& isoValues)
 {
   //bad input abort
   if(!image||!data)
@@ -405,7 +1002,7 @@ void vtkStreamingWorker::StartContour(vtkImageData* image,
   switch (data->GetDataType())
       {
       temDataArrayIteratorMacro( data,
-            this->Internals->Run(CONTOUR, image, isoValue, vtkDABegin, vtkDAEnd, std::cout) );
+            this->Internals->Run(CONTOUR, image, data, isoValues, vtkDABegin, vtkDAEnd, std::cout) );
       default:
         break;
       }
@@ -422,23 +1019,38 @@ void vtkStreamingWorker::StartThreshold(vtkImageData* image,
     this->ValidWorkerInput = false;
     return;
     }
+  const std::vector<double> isoValues(1, isoValue);
   //todo we need to spawn a thread here I believe
   switch (data->GetDataType())
       {
       temDataArrayIteratorMacro( data,
-            this->Internals->Run(POINTCLOUD, image, isoValue, vtkDABegin, vtkDAEnd, std::cout) );
+            this->Internals->Run(POINTCLOUD, image, data, isoValues, vtkDABegin, vtkDAEnd, std::cout) );
       default:
         break;
       }
 }
 
 //----------------------------------------------------------------------------
-vtkSmartPointer<vtkPolyData>
+vtkSmartPointer<vtkMultiBlockDataSet>
 vtkStreamingWorker::GetFinishedPieces()
 {
   return this->Internals->GetFinishedPieces();
 }
 
+//----------------------------------------------------------------------------
+void vtkStreamingWorker::SetViewPlanes(const double planes[24])
+{
+  this->Internals->SetViewPlanes(planes);
+}
+
+//----------------------------------------------------------------------------
+void vtkStreamingWorker::SetModifiedRegion(unsigned long previousVersion,
+                                           unsigned long version,
+                                           const int extent[6])
+{
+  this->Internals->SetModifiedRegion(previousVersion, version, extent);
+}
+
 //----------------------------------------------------------------------------
 void vtkStreamingWorker::StopWork()
 {
@@ -466,6 +1078,19 @@ bool vtkStreamingWorker::AlreadyComputedSearchStructure() const
   return this->Internals->IsValid();
 }
 
+//----------------------------------------------------------------------------
+void vtkStreamingWorker::SetNumberOfSubGridsPerDimension(int number)
+{
+  this->Internals->SetNumSubGridsPerDim(
+    static_cast<std::size_t>(std::max(number, 0)));
+}
+
+//----------------------------------------------------------------------------
+int vtkStreamingWorker::GetNumberOfSubGridsPerDimension() const
+{
+  return static_cast<int>(this->Internals->GetNumSubGridsPerDim());
+}
+
 //------------------------------------------------------------------------------
 void vtkStreamingWorker::PrintSelf(ostream& os, vtkIndent indent)
 {
@@ -23,7 +23,7 @@
 
 class vtkImageData;
 class vtkDataArray;
-class vtkPolyData;
+class vtkMultiBlockDataSet;
 
 
 //how is this going to interact with the view, do
@@ -37,34 +37,59 @@ public:
   void PrintSelf(ostream& os, vtkIndent indent);
   static vtkStreamingWorker *New();
 
-  //start the volume subdivision and contour algorithm
-  void StartContour(vtkImageData*, vtkDataArray* data, double isoValue);
+  //start the volume subdivision and contour algorithm, the surfaces of all
+  //the values are computed in the same pass over the volume. The points of
+  //the pieces have the value of their surface, in an array named after data
+  void StartContour(vtkImageData*, vtkDataArray* data,
+                    const std::vector<double>& isoValues);
 
   //start the volume subdivision and threshold algorithm
   void StartThreshold(vtkImageData*, vtkDataArray* data, double isoValue);
 
   //pass as much of the contour back to the streamer for it
-  //to render, we will keep modifying the data object to add
-  //new data as contours get finished.
-  vtkSmartPointer<vtkPolyData> GetFinishedPieces();
+  //to render, one polydata block per batch of finished subgrids. We
+  //keep adding blocks as contours get finished, the blocks themselves
+  //are never modified.
+  vtkSmartPointer<vtkMultiBlockDataSet> GetFinishedPieces();
 
   //ask the worker to stop processing the Contour or Threshold it is currently
   //processing
   void StopWork();
 
+  //tell the worker that the only change from version previousVersion of the
+  //data (its modification time) to version is in the given extent. If the
+  //worker has built its search structure from previousVersion, the next
+  //start only updates the subgrids in that extent. Otherwise any change of
+  //the data rebuilds everything
+  void SetModifiedRegion(unsigned long previousVersion,
+                         unsigned long version,
+                         const int extent[6]);
+
+  //set the view frustum planes (as given by vtkCamera::GetFrustumPlanes), the
+  //subgrids not processed yet are reordered to process the visible ones
+  //first, front to back
+  void SetViewPlanes(const double planes[24]);
+
   //ask if we any sections of the volume left to contour and
   bool IsFinished() const;
 
   //reports if we have already computed the lookup search structure
   bool AlreadyComputedSearchStructure() const;
 
+  //set the number of subgrids along each dimension the volume is divided
+  //into, 0 (the default) chooses them from the size of the volume, the size
+  //of its values and the number of cores. Changing it drops the search
+  //structure
+  void SetNumberOfSubGridsPerDimension(int number);
+  int GetNumberOfSubGridsPerDimension() const;
+
 protected:
   vtkStreamingWorker();
   ~vtkStreamingWorker();
 
 private:
   void StartAlgorithm(vtkImageData*, vtkDataArray* data,
-                      double isoValue, AlgorithmMode mode);
+                      const std::vector<double>& isoValues, AlgorithmMode mode);
 
   class WorkerInternals;
   WorkerInternals* Internals;
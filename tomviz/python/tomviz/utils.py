@@ -56,3 +56,83 @@ def set_array(dataobject, newarray):
     del oldscalars
     do.PointData.append(arr, name)
     do.PointData.SetActiveScalars(name)
+
+def fftn(array, inverse=False):
+    """Single precision FFT of a 1 to 3 dimensional array, using the tomviz
+    FFT service which caches plans and scratch buffers between calls. Returns
+    a new Fortran ordered complex64 array. The inverse is normalized as in
+    numpy.fft.ifftn."""
+    import _tomviz_fft
+    result = np.array(array, dtype=np.complex64, order='F', copy=True)
+    _tomviz_fft.fft_inplace(result, inverse)
+    if inverse:
+        result /= result.size
+    return result
+
+def ifftn(array):
+    return fftn(array, inverse=True)
+
+def fftn_inplace(array, inverse=False):
+    """Unnormalized in-place FFT of a Fortran ordered complex64 array, avoiding
+    any copy."""
+    import _tomviz_fft
+    _tomviz_fft.fft_inplace(array, inverse)
+
+def rfftn(array):
+    """Single precision real to complex FFT, using the tomviz FFT service.
+    Unlike numpy.fft.rfftn the non-redundant half is taken along the first
+    (fastest varying) axis: the result has shape (n0 // 2 + 1, n1, n2)."""
+    import _tomviz_fft
+    data = np.asfortranarray(array, dtype=np.float32)
+    shape = list(data.shape)
+    shape[0] = shape[0] // 2 + 1
+    result = np.empty(shape, dtype=np.complex64, order='F')
+    _tomviz_fft.rfftn(data, result)
+    return result
+
+def clear_fft_cache():
+    import _tomviz_fft
+    _tomviz_fft.clear_cache()
+
+class ScalarStatistics(object):
+    """Range, mean, variance and histogram of an array, computed in parallel
+    by tomviz in one pass after the range. Percentiles are estimated from the
+    histogram."""
+    def __init__(self, values):
+        self.count = values['count']
+        self.minimum = values['minimum']
+        self.maximum = values['maximum']
+        self.mean = values['mean']
+        self.variance = values['variance']
+        self.std = np.sqrt(self.variance)
+        self.histogram = np.array(values['histogram'], dtype=np.int64)
+        self.histogram_range = values['histogram_range']
+
+    def percentile(self, q):
+        """Estimate the q'th percentile (0 to 100), interpolating linearly
+        within the histogram bins."""
+        if self.minimum == self.maximum or self.histogram.sum() == 0:
+            return self.minimum
+        edges = np.linspace(self.histogram_range[0], self.histogram_range[1],
+                            len(self.histogram) + 1)
+        cumulative = np.concatenate(([0], np.cumsum(self.histogram)))
+        value = np.interp(q / 100.0 * cumulative[-1], cumulative, edges)
+        return min(max(value, self.minimum), self.maximum)
+
+def scalar_statistics(data, bins=256, use_cache=False):
+    """Statistics of the scalars of a vtkImageData, of a vtkDataArray or of a
+    numpy array, see ScalarStatistics. With use_cache, for the output of a
+    data source the statistics computed along with its histogram are returned
+    when they have as many bins, without a pass over the data. Those do not
+    see the changes an operator makes to the arrays in place, so only use the
+    cache for data that has not been modified since the data source was
+    updated."""
+    import _tomviz_statistics
+    if isinstance(data, np.ndarray):
+        data = np_s.numpy_to_vtk(data.reshape(-1, order='A'))
+    elif hasattr(data, 'GetPointData'):
+        values = _tomviz_statistics.cached(data) if use_cache else None
+        if values is not None and len(values['histogram']) == bins:
+            return ScalarStatistics(values)
+        data = data.GetPointData().GetScalars()
+    return ScalarStatistics(_tomviz_statistics.compute(data, bins))